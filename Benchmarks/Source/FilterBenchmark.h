@@ -0,0 +1,410 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../../Source/dsp/AudioMath.h"
+#include "../../Source/dsp/Filter.h"
+#include "../../Source/dsp/FixedBiquad.h"
+
+///
+/// \brief The BenchmarkSettings struct
+/// The sweep performed by FilterBenchmark, every filter type is run at every
+/// block size and channel count listed here.
+struct BenchmarkSettings
+{
+	std::vector<int> blockSizes{ 1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192 };
+	std::vector<int> channelCounts{ 1, 2, 4, 8, 16 };
+	int samplesPerRun{ 1 << 20 };	// total samples, across all channels, timed for each point
+	int designIterations{ 1 << 16 };
+	double sampleRate{ 48000.0 };
+	float frequency{ 1000.0f };
+	float Q{ 0.707f };
+	float gain{ 6.0f };
+};
+
+///
+/// \brief The FilterBenchmark class
+/// Measures ns/sample of every MultiFilter type against the equivalent
+/// juce::dsp::IIR::Filter cascade and FixedBiquad, and the cost of each calcCoefficents().
+/// The Ladder is set against juce::dsp::LadderFilter, which is not oversampled, and its
+/// cost is also given as a multiple of LP24's, the linear 4 pole low pass it stands beside.
+/// Every processed block is first refilled from a noise table so the filters
+/// never settle to silence, the cost of that copy is reported as the "copy"
+/// implementation so it can be subtracted when comparing builds.
+class FilterBenchmark
+{
+public:
+	explicit FilterBenchmark (BenchmarkSettings s) : m_settings (std::move (s))
+	{
+		Random random (0x55b0);
+		const auto maxBlock = *std::max_element (m_settings.blockSizes.begin (), m_settings.blockSizes.end ());
+		m_noise.setSize (1, maxBlock);
+		for (auto i = 0; i < maxBlock; ++i) m_noise.setSample (0, i, random.nextFloat () * 2.0f - 1.0f);
+	}
+
+	/// Runs the whole sweep, printing progress to stdout, and returns the results
+	/// in a form suitable for JSON::toString().
+	var run ()
+	{
+		ScopedNoDenormals noDenormals;
+		auto* root = new DynamicObject ();
+		var result (root);
+
+		auto* meta = new DynamicObject ();
+		meta->setProperty ("juceVersion", SystemStats::getJUCEVersion ());
+		meta->setProperty ("os", SystemStats::getOperatingSystemName ());
+		meta->setProperty ("cpu", SystemStats::getCpuModel ());
+		meta->setProperty ("buildDate", String (__DATE__) + " " + __TIME__);
+		meta->setProperty ("sampleRate", m_settings.sampleRate);
+		meta->setProperty ("frequency", m_settings.frequency);
+		meta->setProperty ("Q", m_settings.Q);
+		meta->setProperty ("gain", m_settings.gain);
+		root->setProperty ("meta", var (meta));
+
+		Array<var> process;
+		for (auto channels : m_settings.channelCounts)
+		{
+			for (auto blockSize : m_settings.blockSizes)
+			{
+				process.add (makeProcessResult ("copy", "copy", blockSize, channels, timeCopy (blockSize, channels)));
+
+				auto lp24 = 0.0;
+				for (auto type = 0; type < static_cast<int>(MultiFilter::typeStings ().size ()); ++type)
+				{
+					const auto name = MultiFilter::typeStings ().at (type);
+					const auto sspo = timeSspoProcess (type, blockSize, channels);
+					const auto tick = timeSspoTick (type, blockSize, channels);
+					const auto iir = timeJuceProcess (type, blockSize, channels);
+					const auto fixed = timeFixedProcess (type, blockSize, channels);
+					process.add (makeProcessResult (name, "sspo", blockSize, channels, sspo));
+					process.add (makeProcessResult (name, "sspo-tick", blockSize, channels, tick));
+					process.add (makeProcessResult (name, "juce", blockSize, channels, iir));
+					if (fixed > 0.0) process.add (makeProcessResult (name, "sspo-fixed", blockSize, channels, fixed));
+					if (name == "LP24") lp24 = sspo;
+
+					std::cout << String (name).paddedRight (' ', 12) << " block " << String (blockSize).paddedLeft (' ', 5)
+						<< " ch " << String (channels).paddedLeft (' ', 2)
+						<< "  sspo " << String (sspo, 3).paddedLeft (' ', 9) << " ns/sample"
+						<< "  tick " << String (tick, 3).paddedLeft (' ', 9) << " ns/sample"
+						<< "  juce " << String (iir, 3).paddedLeft (' ', 9) << " ns/sample"
+						<< "  fixed " << String (fixed, 3).paddedLeft (' ', 9) << " ns/sample";
+					if (name == "Ladder" && lp24 > 0.0) std::cout << "  " << String (sspo / lp24, 1) << "x LP24";
+					std::cout << std::endl;
+				}
+			}
+		}
+		root->setProperty ("process", process);
+
+		Array<var> design;
+		for (auto type = 0; type < static_cast<int>(MultiFilter::typeStings ().size ()); ++type)
+		{
+			const auto name = MultiFilter::typeStings ().at (type);
+			const auto ns = timeDesign (type);
+			auto* entry = new DynamicObject ();
+			entry->setProperty ("filter", String (name));
+			entry->setProperty ("nsPerCall", ns);
+			design.add (var (entry));
+
+			std::cout << String (name).paddedRight (' ', 12) << " calcCoefficents " << String (ns, 3).paddedLeft (' ', 9) << " ns/call" << std::endl;
+		}
+		{
+			const auto ns = timeBatchDesign ();
+			auto* entry = new DynamicObject ();
+			entry->setProperty ("filter", "batch");
+			entry->setProperty ("nsPerCall", ns);
+			design.add (var (entry));
+
+			std::cout << String ("batch").paddedRight (' ', 12) << " designCoefficientBatch " << String (ns, 3).paddedLeft (' ', 9) << " ns/filter" << std::endl;
+		}
+		root->setProperty ("design", design);
+
+		// stops the optimiser from discarding any of the filtered output
+		root->setProperty ("checksum", m_checksum);
+		return result;
+	}
+
+private:
+	static var makeProcessResult (const std::string& filter, const String& impl, int blockSize, int channels, double nsPerSample)
+	{
+		auto* entry = new DynamicObject ();
+		entry->setProperty ("filter", String (filter));
+		entry->setProperty ("impl", impl);
+		entry->setProperty ("blockSize", blockSize);
+		entry->setProperty ("channels", channels);
+		entry->setProperty ("nsPerSample", nsPerSample);
+		return var (entry);
+	}
+
+	int blocksPerRun (int blockSize, int channels) const
+	{
+		return jmax (1, m_settings.samplesPerRun / (blockSize * channels));
+	}
+
+	void refill (AudioBuffer<float>& buffer, int blockSize)
+	{
+		for (auto c = 0; c < buffer.getNumChannels (); ++c)
+			buffer.copyFrom (c, 0, m_noise, 0, 0, blockSize);
+	}
+
+	void accumulate (const AudioBuffer<float>& buffer, int blockSize)
+	{
+		for (auto c = 0; c < buffer.getNumChannels (); ++c)
+			m_checksum += buffer.getSample (c, blockSize - 1);
+	}
+
+	/// Times processBlock, calling process for each channel of each block,
+	/// a first untimed pass warms the caches and lets the filters settle.
+	template <typename ProcessFn>
+	double timeBlocks (int blockSize, int channels, ProcessFn&& process)
+	{
+		AudioBuffer<float> buffer (channels, blockSize);
+		const auto numBlocks = blocksPerRun (blockSize, channels);
+
+		for (auto pass = 0; pass < 2; ++pass)
+		{
+			const auto start = Time::getHighResolutionTicks ();
+			for (auto b = 0; b < numBlocks; ++b)
+			{
+				refill (buffer, blockSize);
+				for (auto c = 0; c < channels; ++c) process (c, buffer.getWritePointer (c), blockSize);
+				accumulate (buffer, blockSize);
+			}
+			const auto elapsed = Time::getHighResolutionTicks () - start;
+
+			if (pass == 1)
+			{
+				const auto samples = static_cast<double>(numBlocks) * blockSize * channels;
+				return Time::highResolutionTicksToSeconds (elapsed) * 1.0e9 / samples;
+			}
+		}
+		return 0.0;
+	}
+
+	double timeCopy (int blockSize, int channels)
+	{
+		return timeBlocks (blockSize, channels, [](int, float*, int) {});
+	}
+
+	std::vector<std::unique_ptr<MultiFilter>> makeSspoFilters (int type, int channels) const
+	{
+		std::vector<std::unique_ptr<MultiFilter>> filters;
+		for (auto c = 0; c < channels; ++c)
+		{
+			auto f = std::make_unique<MultiFilter> ();
+			f->setSampleRate (static_cast<int>(m_settings.sampleRate));
+			f->setType (MultiFilter::typeStings ().at (type));
+			f->setParameters (m_settings.frequency, m_settings.Q, m_settings.gain);
+			filters.push_back (std::move (f));
+		}
+		return filters;
+	}
+
+	double timeSspoProcess (int type, int blockSize, int channels)
+	{
+		auto filters = makeSspoFilters (type, channels);
+		return timeBlocks (blockSize, channels, [&filters](int c, float* data, int n)
+			{
+				filters[c]->processBlock (data, n);
+			});
+	}
+
+	/// processSample one sample at a time, the serial recurrence processBlock's state space kernel avoids
+	double timeSspoTick (int type, int blockSize, int channels)
+	{
+		auto filters = makeSspoFilters (type, channels);
+		return timeBlocks (blockSize, channels, [&filters](int c, float* data, int n)
+			{
+				for (auto i = 0; i < n; ++i) data[i] = filters[c]->processSample (data[i]);
+			});
+	}
+
+	template <typename Fixed, int numSections = 1>
+	double timeFixed (int blockSize, int channels)
+	{
+		std::vector<std::array<Fixed, numSections>> filters (static_cast<size_t>(channels));
+		return timeBlocks (blockSize, channels, [&filters](int c, float* data, int n)
+			{
+				for (auto& f : filters[c]) f.processBlock (data, n);
+			});
+	}
+
+	///
+	/// \brief timeFixedProcess
+	/// Each type as a FixedBiquad, the design compiled in, so only for the default
+	/// settings, 0 when they have been changed and there is nothing comparable to time
+	double timeFixedProcess (int type, int blockSize, int channels)
+	{
+		const BenchmarkSettings defaults;
+		if (m_settings.sampleRate != defaults.sampleRate || m_settings.frequency != defaults.frequency
+			|| m_settings.Q != defaults.Q || m_settings.gain != defaults.gain)
+			return 0.0;
+
+		using Q = std::ratio<707, 1000>;
+		using Gain = std::ratio<6>;
+		const auto name = MultiFilter::typeStings ().at (type);
+
+		if (name == "LP6") return timeFixed<FixedBiquad<FixedType::lp6, 1000, Q>> (blockSize, channels);
+		if (name == "LP12") return timeFixed<FixedBiquad<FixedType::lp12, 1000, Q>> (blockSize, channels);
+		if (name == "LP24") return timeFixed<FixedBiquad<FixedType::lp12, 1000, Q>, 2> (blockSize, channels);
+		if (name == "HP6") return timeFixed<FixedBiquad<FixedType::hp6, 1000, Q>> (blockSize, channels);
+		if (name == "HP12") return timeFixed<FixedBiquad<FixedType::hp12, 1000, Q>> (blockSize, channels);
+		if (name == "HP24") return timeFixed<FixedBiquad<FixedType::hp12, 1000, Q>, 2> (blockSize, channels);
+		if (name == "Low Shelf") return timeFixed<FixedBiquad<FixedType::lowShelf, 1000, Q, 48000, Gain>> (blockSize, channels);
+		if (name == "High Shelf") return timeFixed<FixedBiquad<FixedType::highShelf, 1000, Q, 48000, Gain>> (blockSize, channels);
+		if (name == "Peak") return timeFixed<FixedBiquad<FixedType::peak, 1000, Q, 48000, Gain>> (blockSize, channels);
+		if (name == "BP12") return timeFixed<FixedBiquad<FixedType::bp12, 1000, Q>> (blockSize, channels);
+		if (name == "BS12") return timeFixed<FixedBiquad<FixedType::bs12, 1000, Q>> (blockSize, channels);
+		return 0.0;
+	}
+
+	///
+	/// \brief makeJuceCoefficients
+	/// The juce::dsp::IIR design closest to each MultiFilter type, the 24dB
+	/// types are two cascaded sections as they are in FilterChain.
+	std::vector<dsp::IIR::Coefficients<float>::Ptr> makeJuceCoefficients (int type) const
+	{
+		using Coeffs = dsp::IIR::Coefficients<float>;
+		const auto sr = m_settings.sampleRate;
+		const auto f = m_settings.frequency;
+		const auto q = m_settings.Q;
+		const auto g = Decibels::decibelsToGain (m_settings.gain);
+		const auto name = MultiFilter::typeStings ().at (type);
+
+		if (name == "LP6") return { Coeffs::makeFirstOrderLowPass (sr, f) };
+		if (name == "LP12") return { Coeffs::makeLowPass (sr, f, q) };
+		if (name == "LP24") return { Coeffs::makeLowPass (sr, f, q), Coeffs::makeLowPass (sr, f, q) };
+		if (name == "HP6") return { Coeffs::makeFirstOrderHighPass (sr, f) };
+		if (name == "HP12") return { Coeffs::makeHighPass (sr, f, q) };
+		if (name == "HP24") return { Coeffs::makeHighPass (sr, f, q), Coeffs::makeHighPass (sr, f, q) };
+		if (name == "Low Shelf") return { Coeffs::makeLowShelf (sr, f, q, g) };
+		if (name == "High Shelf") return { Coeffs::makeHighShelf (sr, f, q, g) };
+		if (name == "Peak") return { Coeffs::makePeakFilter (sr, f, q, g) };
+		if (name == "BP12") return { Coeffs::makeBandPass (sr, f, q) };
+		if (name == "BS12") return { Coeffs::makeNotch (sr, f, q) };
+
+		jassertfalse; // a new MultiFilter type needs a juce equivalent adding here
+		return { Coeffs::makeAllPass (sr, f, q) };
+	}
+
+	/// juce's own ladder, its resonance and drive mapped from Q and gain as Ladder::design maps them
+	double timeJuceLadder (int blockSize, int channels)
+	{
+		const auto coeffs = Ladder::design (static_cast<float>(m_settings.sampleRate), m_settings.frequency, m_settings.Q, m_settings.gain);
+		dsp::LadderFilter<float> filter;
+		filter.prepare ({ m_settings.sampleRate, static_cast<uint32>(jmax (1, *std::max_element (m_settings.blockSizes.begin (), m_settings.blockSizes.end ()))), static_cast<uint32>(channels) });
+		filter.setMode (dsp::LadderFilter<float>::Mode::LPF24);
+		filter.setCutoffFrequencyHz (m_settings.frequency);
+		filter.setResonance (coeffs.m_r / 4.0f);
+		filter.setDrive (jmax (1.0f, coeffs.m_drive));
+
+		// juce's ladder takes every channel of a block at once, so each is run once the last channel is filled
+		std::vector<float*> channelData (static_cast<size_t>(channels));
+		return timeBlocks (blockSize, channels, [&filter, &channelData, channels](int c, float* data, int n)
+			{
+				channelData[static_cast<size_t>(c)] = data;
+				if (c + 1 < channels) return;
+				dsp::AudioBlock<float> block (channelData.data (), static_cast<size_t>(channels), static_cast<size_t>(n));
+				dsp::ProcessContextReplacing<float> context (block);
+				filter.process (context);
+			});
+	}
+
+	double timeJuceProcess (int type, int blockSize, int channels)
+	{
+		if (MultiFilter::typeStings ().at (type) == "Ladder") return timeJuceLadder (blockSize, channels);
+		const auto coeffs = makeJuceCoefficients (type);
+		std::vector<std::vector<dsp::IIR::Filter<float>>> filters (static_cast<size_t>(channels));
+		for (auto& chain : filters)
+			for (auto& c : coeffs) chain.emplace_back (c);
+
+		return timeBlocks (blockSize, channels, [&filters](int c, float* data, int n)
+			{
+				dsp::AudioBlock<float> block (&data, 1, static_cast<size_t>(n));
+				dsp::ProcessContextReplacing<float> context (block);
+				for (auto& f : filters[c]) f.process (context);
+			});
+	}
+
+	double timeDesign (int type)
+	{
+		MultiFilter filter;
+		filter.setSampleRate (static_cast<int>(m_settings.sampleRate));
+		filter.setType (MultiFilter::typeStings ().at (type));
+		filter.setParameters (m_settings.frequency, m_settings.Q, m_settings.gain);
+
+		// walk a range of cutoffs so nothing can be hoisted out of the loop
+		constexpr auto numFreqs = 64;
+		std::array<float, numFreqs> freqs;
+		for (auto i = 0; i < numFreqs; ++i) freqs[i] = 20.0f * powf (1000.0f, i / static_cast<float>(numFreqs));
+
+		const auto start = Time::getHighResolutionTicks ();
+		for (auto i = 0; i < m_settings.designIterations; ++i)
+		{
+			filter.setFrequency (freqs[i % numFreqs]);
+		}
+		const auto elapsed = Time::getHighResolutionTicks () - start;
+		m_checksum += filter.processSample (1.0f);
+
+		return Time::highResolutionTicksToSeconds (elapsed) * 1.0e9 / m_settings.designIterations;
+	}
+
+	///
+	/// \brief timeBatchDesign
+	/// designCoefficientBatch over a bank of every biquad type at a range of cutoffs, per filter,
+	/// to compare with the calcCoefficents () of one filter at a time
+	double timeBatchDesign ()
+	{
+		constexpr auto numFilters = 512;
+		MultiFilter probe;
+		std::vector<int> linearTypes;
+		for (auto type = 0; type < static_cast<int>(MultiFilter::typeStings ().size ()); ++type)
+			if (probe.isLinear (type)) linearTypes.push_back (type);
+		std::vector<int> types (numFilters);
+		std::vector<float> freqs (numFilters), Qs (numFilters, m_settings.Q), gains (numFilters, m_settings.gain);
+		std::vector<float> sampleRates (numFilters, static_cast<float>(m_settings.sampleRate));
+		for (auto i = 0; i < numFilters; ++i)
+		{
+			types[i] = linearTypes[static_cast<size_t>(i) % linearTypes.size ()];
+			freqs[i] = 20.0f * powf (1000.0f, i / static_cast<float>(numFilters));
+		}
+
+		CoefficientBank bank;
+		bank.resize (numFilters);
+		const auto numBatches = jmax (1, m_settings.designIterations / numFilters);
+		const auto start = Time::getHighResolutionTicks ();
+		for (auto b = 0; b < numBatches; ++b)
+		{
+			// moved a little each time so nothing can be hoisted out of the loop
+			freqs[b % numFilters] *= 1.0001f;
+			designCoefficientBatch (types.data (), freqs.data (), Qs.data (), gains.data (), sampleRates.data (), numFilters, bank);
+		}
+		const auto elapsed = Time::getHighResolutionTicks () - start;
+		m_checksum += bank.m_a0[numFilters / 2];
+
+		return Time::highResolutionTicksToSeconds (elapsed) * 1.0e9 / (static_cast<double>(numBatches) * numFilters);
+	}
+
+	BenchmarkSettings m_settings;
+	AudioBuffer<float> m_noise;
+	double m_checksum{ 0.0 };
+};
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "FilterBenchmark.h"
+#include "PaintBenchmark.h"
+#include <iostream>
+
+//==============================================================================
+// usage: SSPO_Benchmark [--quick] [--no-filters] [--no-paint] [--json <file>]
+//   --quick        a reduced sweep, for a fast sanity check
+//   --no-filters   skip the filter processing and design benchmarks
+//   --no-paint     skip the editor paint benchmark
+//   --json <file>  write the results as JSON, for comparing successive builds
+int main (int argc, char* argv[])
+{
+	ScopedJuceInitialiser_GUI juceInitialiser;
+
+	StringArray args;
+	for (auto i = 1; i < argc; ++i) args.add (argv[i]);
+
+	const auto jsonIndex = args.indexOf ("--json");
+	if (jsonIndex >= 0 && (jsonIndex + 1 >= args.size () || args[jsonIndex + 1].startsWith ("--")))
+	{
+		std::cerr << "usage: SSPO_Benchmark [--quick] [--no-filters] [--no-paint] [--json <file>]" << std::endl
+			<< "--json needs the file to write the results to" << std::endl;
+		return 1;
+	}
+
+	const auto quick = args.contains ("--quick");
+
+	BenchmarkSettings settings;
+	if (quick)
+	{
+		settings.blockSizes = { 1, 64, 512, 8192 };
+		settings.channelCounts = { 1, 2, 16 };
+		settings.samplesPerRun = 1 << 16;
+		settings.designIterations = 1 << 12;
+	}
+
+	var results (new DynamicObject ());
+	if (!args.contains ("--no-filters"))
+	{
+		FilterBenchmark benchmark (settings);
+		results = benchmark.run ();
+	}
+
+	if (!args.contains ("--no-paint"))
+	{
+		PaintBenchmark benchmark (quick ? 50 : 500);
+		results.getDynamicObject ()->setProperty ("paint", benchmark.run ());
+	}
+
+	if (jsonIndex >= 0)
+	{
+		const auto file = File::getCurrentWorkingDirectory ().getChildFile (args[jsonIndex + 1]);
+		if (! file.replaceWithText (JSON::toString (results)))
+		{
+			std::cerr << "could not write " << file.getFullPathName () << std::endl;
+			return 1;
+		}
+	}
+
+	return 0;
+}
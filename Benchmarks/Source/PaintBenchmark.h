@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../../Source/PluginProcessor.h"
+#include "../../Source/PluginEditor.h"
+
+///
+/// \brief The PaintBenchmark class
+/// Times repainting the plugin's own editor, attached to a processor that is
+/// never prepared or played, into an offscreen image. "warm" repaints reuse the
+/// editor's look and feel and its cached knob images, "cold" repaints hand the
+/// editor a fresh SspoLookAndFeel, with an empty cache, each time.
+class PaintBenchmark
+{
+public:
+	explicit PaintBenchmark (int iterations) : m_iterations (iterations) {}
+
+	var run ()
+	{
+		Array<var> results;
+		for (auto scale : { 1.0f, 2.0f })
+		{
+			for (auto cold : { false, true })
+			{
+				const auto us = timePaint (scale, cold);
+				auto* entry = new DynamicObject ();
+				entry->setProperty ("scale", scale);
+				entry->setProperty ("cache", cold ? "cold" : "warm");
+				entry->setProperty ("usPerPaint", us);
+				results.add (var (entry));
+
+				std::cout << "editor paint x" << scale << (cold ? " cold " : " warm ")
+					<< String (us, 2).paddedLeft (' ', 9) << " us/paint" << std::endl;
+			}
+		}
+		return results;
+	}
+
+private:
+	double timePaint (float scale, bool cold)
+	{
+		Sspo_filterAudioProcessor processor;
+		std::unique_ptr<AudioProcessorEditor> editor (processor.createEditor ());
+		std::unique_ptr<SspoLookAndFeel> lookAndFeel;
+
+		auto* cutoff = processor.parameters.getParameter ("cutoff");
+		auto* res = processor.parameters.getParameter ("res");
+		jassert (cutoff != nullptr && res != nullptr);
+
+		Image image (Image::ARGB, roundToInt (editor->getWidth () * scale), roundToInt (editor->getHeight () * scale), true);
+		Graphics g (image);
+		g.addTransform (AffineTransform::scale (scale));
+
+		int64 ticks = 0;
+		for (auto i = 0; i <= m_iterations; ++i)
+		{
+			if (cold)
+			{
+				auto fresh = std::make_unique<SspoLookAndFeel> ();
+				editor->setLookAndFeel (fresh.get ());
+				lookAndFeel = std::move (fresh);
+			}
+
+			// move the knobs, as a host automating them would, the attachments
+			// update the sliders straight away on the message thread
+			cutoff->setValueNotifyingHost ((i % 100) * 0.01f);
+			res->setValueNotifyingHost (((i + 50) % 100) * 0.01f);
+
+			const auto start = Time::getHighResolutionTicks ();
+			editor->paintEntireComponent (g, false);
+			if (i > 0) ticks += Time::getHighResolutionTicks () - start; // the first paint is warm up
+		}
+
+		editor.reset ();
+		return Time::highResolutionTicksToSeconds (ticks) * 1.0e6 / m_iterations;
+	}
+
+	const int m_iterations;
+};
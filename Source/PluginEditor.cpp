@@ -24,12 +24,16 @@
 
  //==============================================================================
 Sspo_filterAudioProcessorEditor::Sspo_filterAudioProcessorEditor (Sspo_filterAudioProcessor& p)
-	: AudioProcessorEditor (&p), processor (p), valueTreeState (p.parameters)
+	: AudioProcessorEditor (&p), processor (p), valueTreeState (p.parameters),
+	spectrumDisplay (p.getSpectrumAnalyser ()), responseCurve ([&p] { return p.getResponseSnapshot (); })
+#if SSPO_ENABLE_PROCESS_STATS
+	, processStatsOverlay (p.getProcessStats ())
+#endif
 {
 	// Make sure that before the constructor has finished, you've set the
 	// editor's size to whatever you need it to be.
 	setLookAndFeel (&sspoLookAndFeel);
-	setSize (300, 130);
+	setSize (300, 210);
 	cutoffLabel.setText ("Cutoff", dontSendNotification);
 	cutoffLabel.setJustificationType (Justification::centred);
 	addAndMakeVisible (cutoffLabel);
@@ -77,13 +81,28 @@ Sspo_filterAudioProcessorEditor::Sspo_filterAudioProcessorEditor (Sspo_filterAud
 	gitHubSocialButton.setTooltip (TRANS ("Find resources on Github"));
 	addAndMakeVisible (gitHubSocialButton);
 
+	addAndMakeVisible (spectrumDisplay);
+	addAndMakeVisible (responseCurve);
+
+#if SSPO_ENABLE_PROCESS_STATS
+	addAndMakeVisible (processStatsOverlay);
+#endif
+
 	valueTreeState.addParameterListener ("type", this);
 	parameterChanged ("type", 0);
+
+#if SSPO_USE_OPENGL_RENDERER
+	openGLContext.attachTo (*this);
+#endif
 }
 
 Sspo_filterAudioProcessorEditor::~Sspo_filterAudioProcessorEditor ()
 {
-
+#if SSPO_USE_OPENGL_RENDERER
+	openGLContext.detach ();
+#endif
+	valueTreeState.removeParameterListener ("type", this);
+	setLookAndFeel (nullptr);
 }
 
 //==============================================================================
@@ -91,9 +110,10 @@ void Sspo_filterAudioProcessorEditor::paint (Graphics& g)
 {
 	// (Our component is opaque, so we must completely fill the background with a solid colour)
 	g.fillAll (getLookAndFeel ().findColour (ResizableWindow::backgroundColourId));
+}
 
-	g.setColour (Colours::white);
-	g.setFont (15.0f);
+void Sspo_filterAudioProcessorEditor::resized ()
+{
 	cutoffSlider.setBounds (15, 0, 85, 85);
 	resSlider.setBounds (100, 0, 85, 85);
 	cutoffLabel.setBounds (15, 85, 85, 15);
@@ -102,12 +122,11 @@ void Sspo_filterAudioProcessorEditor::paint (Graphics& g)
 	gainSlider.setBounds (185, 0, 85, 85);
 	gainLabel.setBounds (185, 85, 85, 15);
 	gitHubSocialButton.setBounds (0, 98, 32, 32);
-}
-
-void Sspo_filterAudioProcessorEditor::resized ()
-{
-	// This is generally where you'll want to lay out the positions of any
-	// subcomponents in your editor..
+	spectrumDisplay.setBounds (5, 133, 290, 72);
+	responseCurve.setBounds (5, 133, 290, 72);
+#if SSPO_ENABLE_PROCESS_STATS
+	processStatsOverlay.setBounds (36, 102, 160, 26);
+#endif
 }
 
 void Sspo_filterAudioProcessorEditor::parameterChanged (const String& parameterID, float newValue)
@@ -27,6 +27,14 @@
 typedef AudioProcessorValueTreeState::SliderAttachment SliderAttachment;
 typedef AudioProcessorValueTreeState::ButtonAttachment ButtonAttachment;
 
+/** SSPO_USE_OPENGL_RENDERER
+	Renders the editor through an attached OpenGLContext instead of the
+	platform's software renderer, this also works with software Mesa.
+*/
+#ifndef SSPO_USE_OPENGL_RENDERER
+ #define SSPO_USE_OPENGL_RENDERER 0
+#endif
+
 
 
 
@@ -62,8 +70,19 @@ private:
 	std::unique_ptr<SliderAttachment> gainAttachment;
 	std::unique_ptr<AudioProcessorValueTreeState::ComboBoxAttachment> typeAttachment;
 
+	SpectrumDisplay spectrumDisplay;
+	ResponseCurve responseCurve;
+
 	SspoLookAndFeel sspoLookAndFeel;
 
+#if SSPO_USE_OPENGL_RENDERER
+	OpenGLContext openGLContext;
+#endif
+
+#if SSPO_ENABLE_PROCESS_STATS
+	ProcessStatsOverlay processStatsOverlay;
+#endif
+
 	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Sspo_filterAudioProcessorEditor)
 
 		// Inherited via Listener
@@ -21,9 +21,49 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include <thread>
 #include <vector>
 using namespace std;
 
+namespace
+{
+	// the compact state, magic, version, parameter count, then an (id, value) pair per parameter
+	constexpr int k_stateMagic = 0x4f505353; // "SSPO"
+	constexpr int k_stateVersion = 2;	// 2 adds the current program after the parameters
+	const char* const k_stateParameterIds[] = { "cutoff", "res", "type", "gain",
+		"stereoMode", "sideCutoff", "sideRes", "sideType", "sideGain",
+		"dynamic", "sidechain", "threshold", "ratio", "range", "attack", "release", "eq" };
+
+	// each band of the parametric eq has these, "band1On" to "band8Gain"
+	const char* const k_bandParameterNames[] = { "On", "Type", "Freq", "Q", "Gain" };
+
+	String bandParameterId (int band, const char* name)
+	{
+		return "band" + String (band + 1) + name;
+	}
+
+	// the stereo modes, in the order of the "stereoMode" choices
+	enum StereoMode
+	{
+		leftRight = 0,
+		midSide,	// mid from the main settings, side from the side settings
+		midOnly,
+		sideOnly
+	};
+
+	// mid/side samples are encoded into scratch in the arena, filtered and decoded back a tile
+	// at a time, tiles are no longer than this nor than the block size the host prepares for
+	constexpr int k_midSideTile = 256;
+
+	// coefficients are redesigned at most once every k_controlInterval samples
+	constexpr int k_controlInterval = 32;
+	constexpr float k_controlSmoothingMs = 20.0f;
+
+	// the tail is the time to decay by k_tailDecayDb, a pole at the unit circle reports the cap
+	constexpr double k_tailDecayDb = 120.0;
+	constexpr double k_maxTailSeconds = 30.0;
+}
+
 //==============================================================================
 Sspo_filterAudioProcessor::Sspo_filterAudioProcessor () : parameters (*this, nullptr, Identifier ("SSPO_Filter"),
 	{	})
@@ -32,6 +72,7 @@ Sspo_filterAudioProcessor::Sspo_filterAudioProcessor () : parameters (*this, nul
 #if ! JucePlugin_IsMidiEffect
 #if ! JucePlugin_IsSynth
 		.withInput ("Input", AudioChannelSet::stereo (), true)
+		.withInput ("Sidechain", AudioChannelSet::stereo (), false)
 #endif
 		.withOutput ("Output", AudioChannelSet::stereo (), true)
 #endif
@@ -40,13 +81,7 @@ Sspo_filterAudioProcessor::Sspo_filterAudioProcessor () : parameters (*this, nul
 
 {
 
-	//initilise filters
-	//check how many output channels
-	const auto channelCount = getTotalNumOutputChannels ();
-	for (auto i = 0; i < channelCount; ++i)
-	{
-		m_filters.push_back (make_unique<MultiFilter> ());
-	}
+	for (const auto& name : MultiFilter::typeStings ()) m_dynamicShapes.push_back (DynamicEq::shapeForType (name));
 
 	auto cutoffRange = NormalisableRange<float> (20.0f, 20000.0f, 0.1f);
 	cutoffRange.setSkewForCentre (440);
@@ -65,15 +100,70 @@ Sspo_filterAudioProcessor::Sspo_filterAudioProcessor () : parameters (*this, nul
 	cutoffParameter = parameters.getRawParameterValue ("cutoff");
 	typeParameter = parameters.getRawParameterValue ("type");
 	gainParameter = parameters.getRawParameterValue ("gain");
-	parameters.addParameterListener ("cutoff", this);
-	parameters.addParameterListener ("res", this);
-	parameters.addParameterListener ("gain", this);
-	parameters.addParameterListener ("type", this);
+
+	// in mid/side mode the side channel has its own settings, Mid and Side filter only that one
+	parameters.createAndAddParameter (std::make_unique<AudioParameterChoice> ("stereoMode", "Stereo Mode",
+		StringArray ({ "L/R", "M/S", "Mid", "Side" }), leftRight));
+	parameters.createAndAddParameter (std::make_unique<AudioParameterFloat> ("sideCutoff", "Side Cutoff", cutoffRange, 100.0f));
+	parameters.createAndAddParameter (std::make_unique<AudioParameterFloat> ("sideRes", "Side Resonance", resRange, 0.707f));
+	parameters.createAndAddParameter (std::make_unique<AudioParameterChoice> ("sideType", "Side Filter Type", filterTypes, 4));
+	parameters.createAndAddParameter (std::make_unique<AudioParameterFloat> ("sideGain", "Side Gain", gainRange, 0.0f));
+	stereoModeParameter = parameters.getRawParameterValue ("stereoMode");
+	sideCutoffParameter = parameters.getRawParameterValue ("sideCutoff");
+	sideResParameter = parameters.getRawParameterValue ("sideRes");
+	sideTypeParameter = parameters.getRawParameterValue ("sideType");
+	sideGainParameter = parameters.getRawParameterValue ("sideGain");
+
+	// dynamic eq, the Peak and shelf gains follow the level of the input or the sidechain
+	parameters.createAndAddParameter (std::make_unique<AudioParameterBool> ("dynamic", "Dynamic", false));
+	parameters.createAndAddParameter (std::make_unique<AudioParameterBool> ("sidechain", "Sidechain", false));
+	parameters.createAndAddParameter (std::make_unique<AudioParameterFloat> ("threshold", "Threshold", NormalisableRange<float> (-60.0f, 0.0f, 0.1f), -24.0f));
+	parameters.createAndAddParameter (std::make_unique<AudioParameterFloat> ("ratio", "Ratio", NormalisableRange<float> (1.0f, 20.0f, 0.01f, 0.5f), 4.0f));
+	parameters.createAndAddParameter (std::make_unique<AudioParameterFloat> ("range", "Range", gainRange, -12.0f));
+	parameters.createAndAddParameter (std::make_unique<AudioParameterFloat> ("attack", "Attack", NormalisableRange<float> (0.1f, 100.0f, 0.1f, 0.5f), 5.0f));
+	parameters.createAndAddParameter (std::make_unique<AudioParameterFloat> ("release", "Release", NormalisableRange<float> (5.0f, 1000.0f, 1.0f, 0.5f), 100.0f));
+	dynamicParameter = parameters.getRawParameterValue ("dynamic");
+	sidechainParameter = parameters.getRawParameterValue ("sidechain");
+	thresholdParameter = parameters.getRawParameterValue ("threshold");
+	ratioParameter = parameters.getRawParameterValue ("ratio");
+	rangeParameter = parameters.getRawParameterValue ("range");
+	attackParameter = parameters.getRawParameterValue ("attack");
+	releaseParameter = parameters.getRawParameterValue ("release");
+
+	// eq mode, up to eight bands of any type run in one cascade in place of the filter above,
+	// spread across the spectrum, shelves at the ends and peaks between
+	parameters.createAndAddParameter (std::make_unique<AudioParameterBool> ("eq", "EQ Mode", false));
+	eqParameter = parameters.getRawParameterValue ("eq");
+	const float bandFreqs[ParametricEq::k_maxBands] = { 80.0f, 200.0f, 500.0f, 1000.0f, 2000.0f, 4000.0f, 8000.0f, 12000.0f };
+	const auto peakType = filterTypes.indexOf ("Peak");
+	for (auto band = 0; band < ParametricEq::k_maxBands; ++band)
+	{
+		const auto type = band == 0 ? filterTypes.indexOf ("Low Shelf") : band == ParametricEq::k_maxBands - 1 ? filterTypes.indexOf ("High Shelf") : peakType;
+		const auto name = "Band " + String (band + 1) + " ";
+		parameters.createAndAddParameter (std::make_unique<AudioParameterBool> (bandParameterId (band, "On"), name + "On", false));
+		parameters.createAndAddParameter (std::make_unique<AudioParameterChoice> (bandParameterId (band, "Type"), name + "Type", filterTypes, type));
+		parameters.createAndAddParameter (std::make_unique<AudioParameterFloat> (bandParameterId (band, "Freq"), name + "Frequency", cutoffRange, bandFreqs[band]));
+		parameters.createAndAddParameter (std::make_unique<AudioParameterFloat> (bandParameterId (band, "Q"), name + "Q", resRange, 0.707f));
+		parameters.createAndAddParameter (std::make_unique<AudioParameterFloat> (bandParameterId (band, "Gain"), name + "Gain", gainRange, 0.0f));
+
+		auto& p = m_bandParameters[band];
+		p.on = parameters.getRawParameterValue (bandParameterId (band, "On"));
+		p.type = parameters.getRawParameterValue (bandParameterId (band, "Type"));
+		p.freq = parameters.getRawParameterValue (bandParameterId (band, "Freq"));
+		p.Q = parameters.getRawParameterValue (bandParameterId (band, "Q"));
+		p.gain = parameters.getRawParameterValue (bandParameterId (band, "Gain"));
+		for (auto parameterName : k_bandParameterNames) parameters.addParameterListener (bandParameterId (band, parameterName), this);
+	}
+
+	for (auto id : k_stateParameterIds) parameters.addParameterListener (id, this);
+
+	//initilise filters, for as many channels as there are outputs, designed from the parameters
+	buildDspState (getTotalNumOutputChannels (), k_midSideTile);
 }
 
 Sspo_filterAudioProcessor::~Sspo_filterAudioProcessor ()
 {
-
+	cancelPendingUpdate ();
 }
 
 
@@ -112,28 +202,86 @@ bool Sspo_filterAudioProcessor::isMidiEffect () const
 
 double Sspo_filterAudioProcessor::getTailLengthSeconds () const
 {
-	return 0.0;
+	return m_tailSeconds.load ();
+}
+
+void Sspo_filterAudioProcessor::handleAsyncUpdate ()
+{
+	const auto sampleRate = getSampleRate ();
+	if (sampleRate <= 0.0) return;
+
+	// whichever of the preset, the eq or the filters processBlock will run
+	auto samples = 0.0;
+	if (const auto* stages = m_presetLibrary->getBank ().getStages (m_currentPreset.load (), m_presetSampleRateIndex.load ()))
+	{
+		for (uint32_t s = 0; s < stages->numStages; ++s) samples += BiQuad::tailLengthSamples (stages->stages[s], k_tailDecayDb);
+	}
+	else if (*eqParameter >= 0.5f)
+	{
+		// try again once prepareToPlay has laid the eq out
+		const ScopedStateAccess access (*this);
+		if (!access.isValid ())
+		{
+			triggerAsyncUpdate ();
+			return;
+		}
+		samples = m_parametricEq->getTailLengthSamples (k_tailDecayDb);
+	}
+	else
+	{
+		// the main settings and, in mid/side, the side's
+		m_probe.setSampleRate (static_cast<int>(sampleRate));
+		for (size_t i = 0; i < 2; ++i)
+		{
+			const auto settings = getChannelSettings (i);
+			m_probe.setTypeIndex (settings.type, settings.cutoff, settings.res, settings.gain);
+			samples = jmax (samples, m_probe.getTailLengthSamples (k_tailDecayDb));
+		}
+	}
+
+	const auto seconds = jmin (k_maxTailSeconds, samples / sampleRate);
+	if (seconds != m_tailSeconds.exchange (seconds)) updateHostDisplay ();
 }
 
 int Sspo_filterAudioProcessor::getNumPrograms ()
 {
-	return 1;   // NB: some hosts don't cope very well if you tell them there are 0 programs,
-				// so this should be at least 1, even if you're not really implementing programs.
+	// NB: some hosts don't cope very well if you tell them there are 0 programs,
+	// so this should be at least 1, even if you're not really implementing programs.
+	return jmax (1, m_presetLibrary->getBank ().getNumPresets ());
 }
 
 int Sspo_filterAudioProcessor::getCurrentProgram ()
 {
-	return 0;
+	return jmax (0, m_currentPreset.load ());
 }
 
 void Sspo_filterAudioProcessor::setCurrentProgram (int index)
 {
-	ignoreUnused (index);
+	// processBlock picks the preset's coefficients straight out of the bank, the parameters
+	// only follow so the editor shows the preset and a change starts from it, without
+	// redesigning the filters, which are redesigned when a parameter change leaves the preset.
+	// At a sample rate the bank has no stages for the filters run the preset's parameters.
+	const auto& bank = m_presetLibrary->getBank ();
+	if (const auto* entry = bank.getEntry (index))
+	{
+		m_restoringState.store (true);
+		const std::pair<const char*, float> values[] = { { "type", static_cast<float>(entry->type) },
+			{ "cutoff", entry->cutoff }, { "res", entry->res }, { "gain", entry->gain } };
+		for (const auto& v : values)
+			if (auto* param = parameters.getParameter (v.first))
+				param->setValueNotifyingHost (param->convertTo0to1 (v.second));
+		m_restoringState.store (false);
+
+		m_currentPreset.store (index);
+		if (bank.getStages (index, m_presetSampleRateIndex.load ()) == nullptr) applyParametersUnlessPreparing ();
+		triggerAsyncUpdate ();
+	}
 }
 
 const String Sspo_filterAudioProcessor::getProgramName (int index)
 {
-	ignoreUnused (index);
+	if (auto* entry = m_presetLibrary->getBank ().getEntry (index))
+		return String::fromUTF8 (entry->name, static_cast<int>(strnlen (entry->name, presetbank::k_nameLength)));
 	return {};
 }
 
@@ -146,14 +294,54 @@ void Sspo_filterAudioProcessor::changeProgramName (int index, const String& newN
 //==============================================================================
 void Sspo_filterAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
-	ignoreUnused (samplesPerBlock);
+#if SSPO_ENABLE_PROCESS_STATS
+	m_processStats.prepare (sampleRate);
+	m_processStats.reset ();
+#endif
+
+	m_spectrumAnalyser.prepare (sampleRate);
 
-	for (auto& f : m_filters)
+	// presets only switch without design work at the rates the bank was designed for
+	m_presetSampleRateIndex.store (m_presetLibrary->getBank ().findSampleRate (static_cast<int>(sampleRate)));
+	m_activePresetStages = nullptr;
+
+	{
+		// wait for anything reaching into the state to finish, nothing else reaches in till it is reset
+		m_rebuilding.store (true);
+		while (m_reaching.load () > 0) std::this_thread::yield ();
+		const auto tile = jlimit (1, k_midSideTile, samplesPerBlock);
+		if (getTotalNumOutputChannels () != m_numChannels || tile != m_midSideTile)
+			buildDspState (getTotalNumOutputChannels (), tile);
+
+		// parameter changes are smoothed and designed on the audio thread at control rate,
+		// starting from the current parameters rather than gliding up from the defaults
+		for (auto c = 0; c < m_numChannels; ++c)
+		{
+			m_channels[c].filter.setSampleRate (static_cast<int>(sampleRate));
+		}
+		m_parametricEq->setSampleRate (static_cast<int>(sampleRate));
+		m_eqRunning = false;
+		applyParameters ();
+		for (auto c = 0; c < m_numChannels; ++c)
+		{
+			auto& channel = m_channels[c];
+			channel.filter.setControlRate (k_controlInterval, k_controlSmoothingMs);
+			channel.dynamicEq.prepare (static_cast<int>(sampleRate), k_controlInterval);
+			channel.dynamicRunning = false;
+			channel.filter.resetCounts ();
+		}
+		m_processedSamples.store (0);
+		m_rebuilding.store (false);
+	}
+
+	// the listener could not reach the state meanwhile
+	while (m_parametersPending.exchange (false))
 	{
-		f->setType (MultiFilter::typeStings ().at (static_cast<int>(*typeParameter)));
-		f->setSampleRate (static_cast<int>(sampleRate));
-		f->setParameters (*cutoffParameter, *resParameter, *gainParameter);
+		const ScopedStateAccess access (*this);
+		applyParameters ();
 	}
+
+	triggerAsyncUpdate ();
 }
 
 void Sspo_filterAudioProcessor::releaseResources ()
@@ -179,6 +367,14 @@ bool Sspo_filterAudioProcessor::isBusesLayoutSupported (const BusesLayout& layou
 #if ! JucePlugin_IsSynth
 	if (layouts.getMainOutputChannelSet () != layouts.getMainInputChannelSet ())
 		return false;
+
+	// the sidechain, if there is one, may be mono or stereo
+	if (layouts.inputBuses.size () > 1)
+	{
+		const auto sidechain = layouts.getChannelSet (true, 1);
+		if (!sidechain.isDisabled () && sidechain != AudioChannelSet::mono () && sidechain != AudioChannelSet::stereo ())
+			return false;
+	}
 #endif
 
 	return true;
@@ -189,6 +385,9 @@ bool Sspo_filterAudioProcessor::isBusesLayoutSupported (const BusesLayout& layou
 void Sspo_filterAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer& midiMessages)
 {
 	ignoreUnused (midiMessages);
+#if SSPO_ENABLE_PROCESS_STATS
+	ProcessStats::ScopedBlock blockTiming (m_processStats, buffer.getNumSamples ());
+#endif
 	ScopedNoDenormals noDenormals;
 	const auto totalNumInputChannels = getTotalNumInputChannels ();
 	const auto totalNumOutputChannels = getTotalNumOutputChannels ();
@@ -199,11 +398,132 @@ void Sspo_filterAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBu
 	for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
 		buffer.clear (i, 0, buffer.getNumSamples ());
 
-	for (auto j = 0; j < buffer.getNumChannels (); j++)
+	// the sidechain's channels follow the main bus's in buffer
+	auto mainBuffer = getBusBuffer (buffer, false, 0);
+	const auto hasSidechain = getBusCount (true) > 1 && getChannelCountOfBus (true, 1) > 0 && *sidechainParameter >= 0.5f;
+	auto sidechainBuffer = hasSidechain ? getBusBuffer (buffer, true, 1) : AudioBuffer<float> ();
+
+	m_spectrumAnalyser.push (SpectrumAnalyser::preFilter, mainBuffer);
+	m_processedSamples.store (m_processedSamples.load (std::memory_order_relaxed) + static_cast<uint64_t>(mainBuffer.getNumSamples ()), std::memory_order_relaxed);
+
+	// switching preset is only a pointer swap, the cascade starts afresh on entering a preset
+	// and the filters or the eq it stood in for on leaving one, rather than from before it
+	const auto* presetStages = m_presetLibrary->getBank ().getStages (m_currentPreset.load (), m_presetSampleRateIndex.load ());
+	if (presetStages != m_activePresetStages)
+	{
+		for (auto c = 0; c < m_numChannels; ++c)
+		{
+			auto& channel = m_channels[c];
+			if (m_activePresetStages == nullptr) channel.presetCascade.clear ();
+			if (presetStages == nullptr)
+			{
+				channel.filter.clear ();
+				channel.dynamicEq.clear ();
+			}
+		}
+		m_eqRunning = false;
+		m_activePresetStages = presetStages;
+	}
+
+	// eq mode replaces the filter, over each channel as it is, the band state starts afresh
+	// each time it takes over
+	if (presetStages == nullptr && *eqParameter >= 0.5f)
+	{
+		if (!m_eqRunning) m_parametricEq->clear ();
+		m_eqRunning = true;
+		m_parametricEq->process (AudioSpan{ mainBuffer.getArrayOfWritePointers (), mainBuffer.getNumChannels (), mainBuffer.getNumSamples () });
+		m_spectrumAnalyser.push (SpectrumAnalyser::postFilter, mainBuffer);
+		return;
+	}
+	if (m_eqRunning)
+	{
+		// the filters pick up from where they were left, start them afresh as well
+		for (auto c = 0; c < m_numChannels; ++c)
+		{
+			m_channels[c].filter.clear ();
+			m_channels[c].dynamicEq.clear ();
+		}
+		m_eqRunning = false;
+	}
+
+	// a channel whose type has a gain runs its dynamic band while dynamic is on, the band
+	// starts from silence each time it takes over from the MultiFilter
+	const auto dynamic = presetStages == nullptr && *dynamicParameter >= 0.5f;
+	for (auto j = 0; j < m_numChannels; ++j)
+	{
+		auto& state = m_channels[j];
+		const auto running = dynamic && dynamicShapeFor (getChannelSettings (static_cast<size_t>(j)).type) >= 0;
+		if (running && !state.dynamicRunning) state.dynamicEq.clear ();
+		state.dynamicRunning = running;
+	}
+
+	// data is the channel's samples from start, in the buffer or the mid/side scratch
+	auto filterChannel = [&] (int channel, float* data, int start, int numSamples)
+	{
+		if (channel >= m_numChannels) return;
+		auto& state = m_channels[channel];
+		if (presetStages != nullptr) state.presetCascade.processBlock (data, numSamples, *presetStages);
+		else if (!state.dynamicRunning) state.filter.processBlock (data, numSamples);
+		else
+		{
+			const auto* detector = hasSidechain
+				? sidechainBuffer.getReadPointer (jmin (channel, sidechainBuffer.getNumChannels () - 1), start) : data;
+			state.dynamicEq.process (data, detector, numSamples);
+		}
+	};
+
+	// the filters hold state from the other encoding, start them afresh
+	const auto stereoMode = mainBuffer.getNumChannels () >= 2 ? static_cast<int>(*stereoModeParameter) : leftRight;
+	if (stereoMode != m_activeStereoMode)
+	{
+		for (auto c = 0; c < m_numChannels; ++c)
+		{
+			m_channels[c].filter.clear ();
+			m_channels[c].presetCascade.clear ();
+			m_channels[c].dynamicEq.clear ();
+		}
+		m_activeStereoMode = stereoMode;
+	}
+
+	if (stereoMode == leftRight)
+	{
+		for (auto j = 0; j < mainBuffer.getNumChannels (); j++)
+		{
+			filterChannel (j, mainBuffer.getWritePointer (j), 0, mainBuffer.getNumSamples ());
+		}
+	}
+	else
 	{
-		auto channelData = buffer.getWritePointer (j);
-		m_filters.at (j)->processBlock (channelData, buffer.getNumSamples ());
+		// encode each tile into the scratch next to the filters' state, filter it there and
+		// decode it back while it is still in cache, mid is filtered by the left channel's
+		// filter and side by the right's
+		auto* left = mainBuffer.getWritePointer (0);
+		auto* right = mainBuffer.getWritePointer (1);
+		auto* mid = m_midSideScratch;
+		auto* side = m_midSideScratch + m_midSideTile;
+		const auto filterMid = stereoMode != sideOnly;
+		const auto filterSide = stereoMode != midOnly;
+		for (auto start = 0; start < mainBuffer.getNumSamples (); start += m_midSideTile)
+		{
+			const auto n = jmin (m_midSideTile, mainBuffer.getNumSamples () - start);
+			auto* l = left + start;
+			auto* r = right + start;
+			for (auto i = 0; i < n; ++i)
+			{
+				mid[i] = 0.5f * (l[i] + r[i]);
+				side[i] = 0.5f * (l[i] - r[i]);
+			}
+			if (filterMid) filterChannel (0, mid, start, n);
+			if (filterSide) filterChannel (1, side, start, n);
+			for (auto i = 0; i < n; ++i)
+			{
+				l[i] = mid[i] + side[i];
+				r[i] = mid[i] - side[i];
+			}
+		}
 	}
+
+	m_spectrumAnalyser.push (SpectrumAnalyser::postFilter, mainBuffer);
 }
 
 //==============================================================================
@@ -220,41 +540,264 @@ AudioProcessorEditor* Sspo_filterAudioProcessor::createEditor ()
 //==============================================================================
 void Sspo_filterAudioProcessor::getStateInformation (MemoryBlock& destData)
 {
-	auto state = parameters.copyState ();
-	std::unique_ptr<XmlElement> xml (state.createXml ());
-	copyXmlToBinary (*xml, destData);
+	destData.reset ();
+	MemoryOutputStream stream (destData, false);
+	stream.writeInt (k_stateMagic);
+	stream.writeByte (static_cast<char>(k_stateVersion));
+	StringArray ids (k_stateParameterIds, numElementsInArray (k_stateParameterIds));
+	for (auto band = 0; band < ParametricEq::k_maxBands; ++band)
+		for (auto name : k_bandParameterNames) ids.add (bandParameterId (band, name));
+
+	stream.writeByte (static_cast<char>(ids.size ()));
+	for (const auto& id : ids)
+	{
+		stream.writeString (id);
+		stream.writeFloat (*parameters.getRawParameterValue (id));
+	}
+	stream.writeInt (m_currentPreset.load ());
 }
 
 void Sspo_filterAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
+	MemoryInputStream stream (data, static_cast<size_t>(jmax (0, sizeInBytes)), false);
+	if (sizeInBytes >= 6 && stream.readInt () == k_stateMagic)
+	{
+		// a state from a newer build may not mean the same thing
+		const auto version = stream.readByte ();
+		if (version > k_stateVersion) return;
+
+		const auto count = static_cast<uint8>(stream.readByte ());
+		m_restoringState.store (true);
+		for (auto i = 0; i < count && !stream.isExhausted (); ++i)
+		{
+			const auto id = stream.readString ();
+			const auto value = stream.readFloat ();
+			if (auto* param = parameters.getParameter (id))
+				param->setValueNotifyingHost (param->convertTo0to1 (value));
+		}
+		m_restoringState.store (false);
+		applyParametersUnlessPreparing ();
+
+		// the parameters saved with a program are its own, so it carries on from them
+		const auto program = version >= 2 && !stream.isExhausted () ? stream.readInt () : -1;
+		m_currentPreset.store (m_presetLibrary->getBank ().getEntry (program) != nullptr ? program : -1);
+		triggerAsyncUpdate ();
+		return;
+	}
+
+	// states saved before the compact format were xml
 	std::unique_ptr<XmlElement> xmlState (getXmlFromBinary (data, sizeInBytes));
 	if (xmlState.get () != nullptr)
 		if (xmlState->hasTagName (parameters.state.getType ()))
+		{
+			m_restoringState.store (true);
 			parameters.replaceState (ValueTree::fromXml (*xmlState));
+			m_restoringState.store (false);
+			applyParametersUnlessPreparing ();
+		}
 }
 
 bool Sspo_filterAudioProcessor::getFilterUseQ (int index)
 {
-	return m_filters.at (0)->getUseQ (index);
+	return m_probe.getUseQ (index);
 }
 
 bool Sspo_filterAudioProcessor::getFilterUseGain (int index)
 {
-	return m_filters.at (0)->getUseGain (index);
+	return m_probe.getUseGain (index);
 }
 
-void Sspo_filterAudioProcessor::parameterChanged (const String& parameterID, float newValue)
+double Sspo_filterAudioProcessor::getCoefficientRedesignsPerSecond () const
+{
+	const ScopedStateAccess access (*this);
+	if (!access.isValid ()) return m_redesignWindow.rate;
+
+	uint64_t redesigns = 0;
+	for (auto c = 0; c < m_numChannels; ++c) { redesigns += m_channels[c].filter.getRedesignCount (); }
+	const auto samples = m_processedSamples.load ();
+
+	// prepareToPlay zeroed the counts, start a new window
+	auto& window = m_redesignWindow;
+	if (samples < window.samples || redesigns < window.redesigns)
+	{
+		window = { redesigns, samples, 0.0 };
+		return window.rate;
+	}
+
+	const auto sampleRate = getSampleRate ();
+	const auto elapsed = samples - window.samples;
+	if (sampleRate > 0.0 && elapsed >= static_cast<uint64_t>(0.5 * sampleRate))
+		window = { redesigns, samples, (redesigns - window.redesigns) * sampleRate / elapsed };
+	return window.rate;
+}
+
+ResponseCurveEngine::Snapshot Sspo_filterAudioProcessor::getResponseSnapshot () const
 {
-	if (parameterID.compare ("type") == 0)
+	ResponseCurveEngine::Snapshot snapshot;
+	snapshot.sampleRate = getSampleRate () > 0.0 ? getSampleRate () : 44100.0;
+
+	// whichever of the preset, the eq or the filters processBlock will run, the eq the same
+	// bands over each channel as it is
+	const auto& bank = m_presetLibrary->getBank ();
+	const auto preset = m_currentPreset.load ();
+	const auto* presetEntry = bank.getStages (preset, m_presetSampleRateIndex.load ()) != nullptr ? bank.getEntry (preset) : nullptr;
+	if (presetEntry == nullptr && *eqParameter >= 0.5f)
 	{
-		for (auto& f : m_filters)
+		for (const auto& p : m_bandParameters)
+			if (*p.on >= 0.5f) snapshot.first.push_back ({ static_cast<int>(*p.type), *p.freq, *p.Q, *p.gain });
+		snapshot.second = snapshot.first;
+		return snapshot;
+	}
+
+	// the preset's stages were designed from its entry, otherwise each channel's settings,
+	// with the gain the dynamic band has reached in place of the parameter
+	auto bandFor = [&] (int channel) -> ResponseCurveEngine::Band
+	{
+		if (presetEntry != nullptr) return { presetEntry->type, presetEntry->cutoff, presetEntry->res, presetEntry->gain };
+
+		const auto settings = getChannelSettings (static_cast<size_t>(channel));
+		auto gain = settings.gain;
+		if (*dynamicParameter >= 0.5f && dynamicShapeFor (settings.type) >= 0)
 		{
-			f->setType (MultiFilter::typeStings ().at (static_cast<int>(newValue)));
-			f->clear ();
+			const ScopedStateAccess access (*this);
+			if (access.isValid () && channel < m_numChannels) gain = m_channels[channel].dynamicEq.getCurrentGain ();
 		}
+		return { settings.type, settings.cutoff, settings.res, gain };
+	};
+
+	const auto stereoMode = getTotalNumOutputChannels () >= 2 ? static_cast<int>(*stereoModeParameter) : leftRight;
+	if (stereoMode != sideOnly) snapshot.first.push_back (bandFor (0));
+	if (stereoMode != midOnly) snapshot.second.push_back (bandFor (getTotalNumOutputChannels () >= 2 ? 1 : 0));
+	return snapshot;
+}
+
+Sspo_filterAudioProcessor::ChannelSettings Sspo_filterAudioProcessor::getChannelSettings (size_t channel) const noexcept
+{
+	// in mid/side mode the second filter runs the side channel
+	if (channel == 1 && static_cast<int>(*stereoModeParameter) == midSide)
+		return { static_cast<int>(*sideTypeParameter), *sideCutoffParameter, *sideResParameter, *sideGainParameter };
+	return { static_cast<int>(*typeParameter), *cutoffParameter, *resParameter, *gainParameter };
+}
+
+Sspo_filterAudioProcessor::ScopedStateAccess::ScopedStateAccess (const Sspo_filterAudioProcessor& p) noexcept
+	: m_processor (p)
+{
+	// the order matters, prepareToPlay sets m_rebuilding then waits for m_reaching to fall
+	m_processor.m_reaching.fetch_add (1);
+	m_valid = !m_processor.m_rebuilding.load ();
+	if (!m_valid) m_processor.m_reaching.fetch_sub (1);
+}
+
+Sspo_filterAudioProcessor::ScopedStateAccess::~ScopedStateAccess ()
+{
+	if (m_valid) m_processor.m_reaching.fetch_sub (1);
+}
+
+void Sspo_filterAudioProcessor::buildDspState (int numChannels, int midSideTile)
+{
+	m_channels = nullptr;
+	m_parametricEq = nullptr;
+	m_midSideScratch = nullptr;
+	m_numChannels = jmax (0, numChannels);
+	m_midSideTile = jlimit (1, k_midSideTile, midSideTile);
+
+	// the channels first, as processBlock runs them, the mid/side scratch, then the eq and its state
+	const auto scratchSize = static_cast<size_t>(2 * m_midSideTile);
+	m_arena.reserve (DspArena::footprint<ChannelState> (static_cast<size_t>(m_numChannels))
+		+ DspArena::footprint<float> (scratchSize)
+		+ DspArena::footprint<ParametricEq> () + ParametricEq::stateFootprint (m_numChannels));
+	for (auto c = 0; c < m_numChannels; ++c)
+	{
+		auto* channel = m_arena.create<ChannelState> ();
+		if (c == 0) m_channels = channel;
 	}
+	m_midSideScratch = m_arena.allocateArray<float> (scratchSize);
+	m_parametricEq = m_arena.create<ParametricEq> ();
+	m_parametricEq->prepare (static_cast<int>(jmax (44100.0, getSampleRate ())), m_numChannels, m_arena);
+	jassert (m_arena.getUsed () == m_arena.getCapacity ());
+
+	applyParameters ();
+}
 
-	for (auto& f : m_filters) { f->setParameters (*cutoffParameter, *resParameter, *gainParameter); }
+void Sspo_filterAudioProcessor::applyParameters ()
+{
+	for (auto c = 0; c < m_numChannels; ++c)
+	{
+		auto& channel = m_channels[c];
+		const auto settings = getChannelSettings (static_cast<size_t>(c));
+		channel.filter.setTypeIndex (settings.type, settings.cutoff, settings.res, settings.gain);
+
+		const auto shape = dynamicShapeFor (settings.type);
+		if (shape >= 0) channel.dynamicEq.setShape (static_cast<DynamicEq::Shape>(shape));
+		channel.dynamicEq.setParameters (settings.cutoff, settings.res, settings.gain);
+		channel.dynamicEq.setDynamics (*thresholdParameter, *ratioParameter, *rangeParameter, *attackParameter, *releaseParameter);
+	}
+	for (auto band = 0; band < ParametricEq::k_maxBands; ++band) applyBand (band);
+}
+
+int Sspo_filterAudioProcessor::dynamicShapeFor (int type) const noexcept
+{
+	jassert (isPositiveAndBelow (type, static_cast<int>(m_dynamicShapes.size ())));
+	return m_dynamicShapes[static_cast<size_t>(type)];
+}
+
+void Sspo_filterAudioProcessor::applyParametersUnlessPreparing ()
+{
+	// prepareToPlay applies them itself once it lets go of the state
+	m_parametersPending.store (true);
+	const ScopedStateAccess access (*this);
+	if (access.isValid ()) applyParameters ();
+	triggerAsyncUpdate ();
+}
+
+void Sspo_filterAudioProcessor::applyBand (int band)
+{
+	const auto& p = m_bandParameters.at (band);
+	m_parametricEq->setBand (band, { *p.on >= 0.5f, static_cast<int>(*p.type), *p.freq, *p.Q, *p.gain });
+}
+
+void Sspo_filterAudioProcessor::parameterChanged (const String& parameterID, float newValue)
+{
+	ignoreUnused (newValue);
+	if (m_restoringState.load ()) return;
+
+	// touching a parameter leaves the preset for the parameters, the filters were not
+	// redesigned for the preset's, so every one is applied
+	const auto leftPreset = m_currentPreset.exchange (-1) >= 0;
+	triggerAsyncUpdate ();
+
+	// prepareToPlay may be laying the state out, it applies every parameter once it is done
+	m_parametersPending.store (true);
+	const ScopedStateAccess access (*this);
+	if (!access.isValid ()) return;
+	if (leftPreset)
+	{
+		applyParameters ();
+		return;
+	}
+
+	// "band3Freq" is band 2, processBlock reads "eq" itself
+	if (parameterID.startsWith ("band"))
+	{
+		applyBand (parameterID.substring (4, 5).getIntValue () - 1);
+		return;
+	}
+	if (parameterID.compare ("eq") == 0) return;
+
+	if (parameterID.compare ("type") == 0 || parameterID.startsWith ("side") || parameterID.compare ("stereoMode") == 0)
+	{
+		applyParameters ();
+		return;
+	}
+
+	for (auto c = 0; c < m_numChannels; ++c)
+	{
+		auto& channel = m_channels[c];
+		const auto settings = getChannelSettings (static_cast<size_t>(c));
+		channel.filter.setParameters (settings.cutoff, settings.res, settings.gain);
+		channel.dynamicEq.setParameters (settings.cutoff, settings.res, settings.gain);
+		channel.dynamicEq.setDynamics (*thresholdParameter, *ratioParameter, *rangeParameter, *attackParameter, *releaseParameter);
+	}
 }
 
 //==============================================================================
@@ -23,6 +23,8 @@
 
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "curlymorphic_sspo.h"
+#include "PresetLibrary.h"
+#include <array>
 #include <vector>
 #include <memory>
 using namespace std;
@@ -30,7 +32,7 @@ using namespace std;
 //==============================================================================
 /**
 */
-class Sspo_filterAudioProcessor : public AudioProcessor, public AudioProcessorValueTreeState::Listener
+class Sspo_filterAudioProcessor : public AudioProcessor, public AudioProcessorValueTreeState::Listener, private AsyncUpdater
 {
 public:
 	//==============================================================================
@@ -75,6 +77,28 @@ public:
 	bool getFilterUseQ (int index);
 	bool getFilterUseGain (int index);
 
+	SpectrumAnalyser& getSpectrumAnalyser () noexcept { return m_spectrumAnalyser; }
+
+	/// The filters processBlock runs on each channel, whichever of the preset, the eq or the
+	/// filters it is running and in whichever stereo mode, the dynamic band at the gain it
+	/// has reached, for the response curve, from the message thread
+	ResponseCurveEngine::Snapshot getResponseSnapshot () const;
+
+	/// Coefficient redesigns per second of audio, summed over the channels, at most
+	/// channels * sampleRate / 32 while the parameters move. The rate over the audio
+	/// processed between calls, once at least half a second of it, from one thread at a
+	/// time, such as an editor's timer, the last rate until then.
+	double getCoefficientRedesignsPerSecond () const;
+
+#if SSPO_ENABLE_PROCESS_STATS
+	/// Timing of processBlock, snapshots may be taken from any thread
+	ProcessStats& getProcessStats () noexcept { return m_processStats; }
+	ProcessStats::Snapshot getProcessStatsSnapshot () const noexcept { return m_processStats.getSnapshot (); }
+	/// the fraction of the block deadline processBlock may use before it counts as an overrun
+	void setProcessBudget (float fractionOfDeadline) noexcept { m_processStats.setBudget (fractionOfDeadline); }
+	void resetProcessStats () noexcept { m_processStats.reset (); }
+#endif
+
 
 private:
 	//==============================================================================
@@ -84,10 +108,142 @@ private:
 	std::atomic<float>* cutoffParameter = nullptr;
 	std::atomic<float>* typeParameter = nullptr;
 	std::atomic<float>* gainParameter = nullptr;
-
-
-	std::vector<std::unique_ptr<MultiFilter>> m_filters;
-
+	std::atomic<float>* stereoModeParameter = nullptr;
+	std::atomic<float>* sideCutoffParameter = nullptr;
+	std::atomic<float>* sideResParameter = nullptr;
+	std::atomic<float>* sideTypeParameter = nullptr;
+	std::atomic<float>* sideGainParameter = nullptr;
+
+	std::atomic<float>* dynamicParameter = nullptr;
+	std::atomic<float>* sidechainParameter = nullptr;
+	std::atomic<float>* thresholdParameter = nullptr;
+	std::atomic<float>* ratioParameter = nullptr;
+	std::atomic<float>* rangeParameter = nullptr;
+	std::atomic<float>* attackParameter = nullptr;
+	std::atomic<float>* releaseParameter = nullptr;
+
+	std::atomic<float>* eqParameter = nullptr;
+
+	/// the parameters of one band of the parametric eq
+	struct BandParameters
+	{
+		std::atomic<float>* on = nullptr;
+		std::atomic<float>* type = nullptr;
+		std::atomic<float>* freq = nullptr;
+		std::atomic<float>* Q = nullptr;
+		std::atomic<float>* gain = nullptr;
+	};
+	std::array<BandParameters, ParametricEq::k_maxBands> m_bandParameters;
+
+	/// Designs one band of the parametric eq from its parameters
+	void applyBand (int band);
+
+	// the stereo mode the filter state belongs to, audio thread only
+	int m_activeStereoMode{ 0 };
+
+	/// the type and parameters a channel's filter runs with
+	struct ChannelSettings
+	{
+		int type;
+		float cutoff, res, gain;
+	};
+	ChannelSettings getChannelSettings (size_t channel) const noexcept;
+
+	// set while a state is being restored, parameter changes are then applied once at the end
+	std::atomic<bool> m_restoringState{ false };
+
+	// the tail reported to the host, worked out on the message thread from the coefficients
+	// the current parameters design, the probe, the message thread's own, designs them off
+	// to one side and says which controls each type uses
+	std::atomic<double> m_tailSeconds{ 0.0 };
+	MultiFilter m_probe;
+	void handleAsyncUpdate () override;
+
+	/// Sets every filter to the current type and parameters, designing each once
+	void applyParameters ();
+
+	///
+	/// \brief The ChannelState struct
+	/// The DSP state of one channel, one after another in the arena, each on cache lines
+	/// of its own. The MultiFilter runs the channel, or the dynamic band in its place for
+	/// gain types while dynamic is on, or the preset cascade while a preset is selected.
+	struct ChannelState
+	{
+		MultiFilter filter;
+		DynamicEq dynamicEq;
+		PresetCascade presetCascade;
+		bool dynamicRunning{ false };	// the audio thread's record of which ran last block
+	};
+
+	/// applyParameters from outside prepareToPlay, which applies them itself if it holds the state
+	void applyParametersUnlessPreparing ();
+
+	/// Lays out numChannels ChannelStates, the mid/side scratch for tiles of midSideTile
+	/// samples and the parametric eq in the arena, from the constructor or from
+	/// prepareToPlay with nothing reaching into the state
+	void buildDspState (int numChannels, int midSideTile);
+
+	///
+	/// \brief The ScopedStateAccess class
+	/// Reaches into the DSP state from outside the audio thread unless prepareToPlay is
+	/// laying it out, neither ever waits for the other, only prepareToPlay for it
+	class ScopedStateAccess
+	{
+	public:
+		explicit ScopedStateAccess (const Sspo_filterAudioProcessor& p) noexcept;
+		~ScopedStateAccess ();
+		bool isValid () const noexcept { return m_valid; }
+
+	private:
+		const Sspo_filterAudioProcessor& m_processor;
+		bool m_valid;
+	};
+
+	// all the per channel DSP state, laid out again by prepareToPlay when the channel count
+	// changes, while m_rebuilding is set and once nothing is m_reaching into it, parameter
+	// changes that could not reach it meanwhile are marked pending and applied afterwards
+	DspArena m_arena;
+	ChannelState* m_channels{ nullptr };
+	int m_numChannels{ 0 };
+	float* m_midSideScratch{ nullptr };	// a tile of mid then a tile of side
+	int m_midSideTile{ 0 };
+	std::atomic<bool> m_rebuilding{ false };
+	mutable std::atomic<int> m_reaching{ 0 };
+	std::atomic<bool> m_parametersPending{ false };
+
+	std::vector<int> m_dynamicShapes;	// the DynamicEq::Shape of each type index, -1 for none
+
+	/// m_dynamicShapes at type, which comes from the type parameter's range, never throws
+	int dynamicShapeFor (int type) const noexcept;
+
+	// eq mode runs every band, over every channel, in place of the MultiFilters,
+	// m_eqRunning is the audio thread's record of whether it did last block
+	ParametricEq* m_parametricEq{ nullptr };
+	bool m_eqRunning{ false };
+
+	// the programs are the presets in the shared bank, a selected preset runs its
+	// precomputed coefficients until a parameter is changed, -1 for none
+	SharedResourcePointer<PresetLibrary> m_presetLibrary;
+	std::atomic<int> m_currentPreset{ -1 };
+	std::atomic<int> m_presetSampleRateIndex{ -1 };	// written by prepareToPlay, read on every thread
+	const presetbank::PresetStages* m_activePresetStages{ nullptr };
+
+	// the samples processBlock has run since prepareToPlay, which zeroes them and the
+	// filters' redesign counts, and the counts the redesign rate was last worked out from
+	std::atomic<uint64_t> m_processedSamples{ 0 };
+	struct RedesignWindow
+	{
+		uint64_t redesigns{ 0 };
+		uint64_t samples{ 0 };
+		double rate{ 0.0 };
+	};
+	mutable RedesignWindow m_redesignWindow;
+
+	SpectrumAnalyser m_spectrumAnalyser;
+
+#if SSPO_ENABLE_PROCESS_STATS
+	ProcessStats m_processStats;
+#endif
 
 	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Sspo_filterAudioProcessor)
 
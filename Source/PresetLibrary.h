@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "dsp/PresetBank.h"
+
+///
+/// \brief The PresetLibrary class
+/// The preset bank, memory mapped read only from the user's application data
+/// folder. Hold it with a SharedResourcePointer so every instance in the process
+/// shares the one mapping. A missing or invalid bank leaves the library empty.
+class PresetLibrary
+{
+public:
+	PresetLibrary ()
+	{
+		const auto file = getDefaultFile ();
+		if (file.existsAsFile ())
+		{
+			m_file = std::make_unique<MemoryMappedFile> (file, MemoryMappedFile::readOnly);
+			if (!m_bank.open (m_file->getData (), m_file->getSize ())) m_file.reset ();
+		}
+	}
+
+	static File getDefaultFile ()
+	{
+		return File::getSpecialLocation (File::userApplicationDataDirectory)
+			.getChildFile ("SSPO_Filter")
+			.getChildFile ("Presets.sspobank");
+	}
+
+	const PresetBankView& getBank () const noexcept { return m_bank; }
+
+private:
+	std::unique_ptr<MemoryMappedFile> m_file;
+	PresetBankView m_bank;
+
+	JUCE_DECLARE_NON_COPYABLE (PresetLibrary)
+};
@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include "sspo_filter.h"
+#include "../dsp/Filter.h"
+#include "../dsp/ParallelIir.h"
+#include "../dsp/PresetBank.h"
+
+#include <memory>
+#include <new>
+#include <string>
+#include <system_error>
+#include <vector>
+
+struct sspo_filter
+{
+	std::vector<std::unique_ptr<MultiFilter>> channels;
+	float frequency{ 1000.0f };
+	float q{ 0.707f };
+	float gain{ 0.0f };
+
+	void applyParameters ()
+	{
+		for (auto& f : channels) { f->setParameters (frequency, q, gain); }
+	}
+};
+
+namespace
+{
+	struct TypeTraits
+	{
+		std::string name;
+		bool usesQ, usesGain;
+		bool linear;	// only linear types have coefficients to store, the Ladder does not
+	};
+
+	///
+	/// \brief typeTraits
+	/// Each type's name and what it uses, probed from a MultiFilter once, nullptr if there
+	/// was no memory to probe it, when the next call tries again
+	const std::vector<TypeTraits>* typeTraits () noexcept
+	{
+		try
+		{
+			static const auto traits = []
+			{
+				MultiFilter probe;
+				std::vector<TypeTraits> t;
+				const auto names = MultiFilter::typeStings ();
+				for (auto i = 0; i < static_cast<int> (names.size ()); ++i)
+					t.push_back ({ names[i], probe.getUseQ (i), probe.getUseGain (i), probe.isLinear (i) });
+				return t;
+			} ();
+			return &traits;
+		}
+		catch (const std::bad_alloc&)
+		{
+			return nullptr;
+		}
+	}
+
+	/// the traits of a type, nullptr if it is out of range
+	const TypeTraits* traitsOf (int typeIndex) noexcept
+	{
+		const auto* traits = typeTraits ();
+		if (traits == nullptr || typeIndex < 0 || typeIndex >= static_cast<int>(traits->size ())) return nullptr;
+		return &(*traits)[typeIndex];
+	}
+
+	bool isValidType (int typeIndex)
+	{
+		return traitsOf (typeIndex) != nullptr;
+	}
+
+	bool isLinearType (int typeIndex)
+	{
+		const auto* traits = traitsOf (typeIndex);
+		return traits != nullptr && traits->linear;
+	}
+
+	/// every one of num_channels has a buffer
+	bool hasBuffers (float* const* channels, int numChannels)
+	{
+		for (auto c = 0; c < numChannels; ++c)
+			if (channels[c] == nullptr) return false;
+		return true;
+	}
+}
+
+int sspo_filter_type_count (void)
+{
+	const auto* traits = typeTraits ();
+	return traits != nullptr ? static_cast<int>(traits->size ()) : 0;
+}
+
+const char* sspo_filter_type_name (int type_index)
+{
+	const auto* traits = traitsOf (type_index);
+	return traits != nullptr ? traits->name.c_str () : nullptr;
+}
+
+int sspo_filter_type_uses_q (int type_index)
+{
+	const auto* traits = traitsOf (type_index);
+	return traits != nullptr && traits->usesQ ? 1 : 0;
+}
+
+int sspo_filter_type_uses_gain (int type_index)
+{
+	const auto* traits = traitsOf (type_index);
+	return traits != nullptr && traits->usesGain ? 1 : 0;
+}
+
+sspo_filter* sspo_filter_create (int num_channels, int sample_rate)
+{
+	if (num_channels <= 0 || sample_rate <= 0) return nullptr;
+
+	try
+	{
+		auto filter = std::make_unique<sspo_filter> ();
+		for (auto i = 0; i < num_channels; ++i)
+		{
+			auto f = std::make_unique<MultiFilter> ();
+			f->setSampleRate (sample_rate);
+			f->setTypeIndex (0, filter->frequency, filter->q, filter->gain);
+			filter->channels.push_back (std::move (f));
+		}
+		return filter.release ();
+	}
+	catch (const std::bad_alloc&)
+	{
+		return nullptr;
+	}
+}
+
+void sspo_filter_destroy (sspo_filter* filter)
+{
+	delete filter;
+}
+
+sspo_result sspo_filter_set_type (sspo_filter* filter, int type_index)
+{
+	if (filter == nullptr || !isValidType (type_index)) return SSPO_ERROR_INVALID_ARGUMENT;
+
+	try
+	{
+		for (auto& f : filter->channels) { f->setTypeIndex (type_index, filter->frequency, filter->q, filter->gain); }
+	}
+	catch (const std::bad_alloc&)
+	{
+		return SSPO_ERROR_OUT_OF_MEMORY;
+	}
+	return SSPO_OK;
+}
+
+sspo_result sspo_filter_set_type_name (sspo_filter* filter, const char* type_name)
+{
+	if (filter == nullptr || type_name == nullptr) return SSPO_ERROR_INVALID_ARGUMENT;
+
+	const auto* traits = typeTraits ();
+	if (traits == nullptr) return SSPO_ERROR_OUT_OF_MEMORY;
+	for (auto i = 0; i < static_cast<int>(traits->size ()); ++i)
+	{
+		if ((*traits)[i].name.compare (type_name) == 0) return sspo_filter_set_type (filter, i);
+	}
+	return SSPO_ERROR_INVALID_ARGUMENT;
+}
+
+sspo_result sspo_filter_set_sample_rate (sspo_filter* filter, int sample_rate)
+{
+	if (filter == nullptr || sample_rate <= 0) return SSPO_ERROR_INVALID_ARGUMENT;
+
+	try
+	{
+		for (auto& f : filter->channels) { f->setSampleRate (sample_rate); }
+		filter->applyParameters ();
+	}
+	catch (const std::bad_alloc&)
+	{
+		return SSPO_ERROR_OUT_OF_MEMORY;
+	}
+	return SSPO_OK;
+}
+
+sspo_result sspo_filter_set_params (sspo_filter* filter, float frequency, float q, float gain_db)
+{
+	if (filter == nullptr || !std::isfinite (frequency) || !std::isfinite (q) || !std::isfinite (gain_db))
+		return SSPO_ERROR_INVALID_ARGUMENT;
+
+	filter->frequency = frequency;
+	filter->q = q;
+	filter->gain = gain_db;
+
+	try
+	{
+		filter->applyParameters ();
+	}
+	catch (const std::bad_alloc&)
+	{
+		return SSPO_ERROR_OUT_OF_MEMORY;
+	}
+	return SSPO_OK;
+}
+
+void sspo_filter_reset (sspo_filter* filter)
+{
+	if (filter == nullptr) return;
+	for (auto& f : filter->channels) { f->clear (); }
+}
+
+sspo_result sspo_filter_process (sspo_filter* filter, float* const* channels, int num_channels, int num_samples)
+{
+	if (filter == nullptr || channels == nullptr || num_channels < 0 || num_samples < 0
+		|| num_channels > static_cast<int>(filter->channels.size ()) || !hasBuffers (channels, num_channels))
+		return SSPO_ERROR_INVALID_ARGUMENT;
+
+	for (auto c = 0; c < num_channels; ++c)
+	{
+		filter->channels[c]->processBlock (channels[c], num_samples);
+	}
+	return SSPO_OK;
+}
+
+sspo_result sspo_filter_process_offline (sspo_filter* filter, float* const* channels, int num_channels,
+	int64_t num_samples, int num_threads)
+{
+	if (filter == nullptr || channels == nullptr || num_channels < 0 || num_samples < 0 || num_threads < 0
+		|| num_channels > static_cast<int>(filter->channels.size ()) || !hasBuffers (channels, num_channels))
+		return SSPO_ERROR_INVALID_ARGUMENT;
+
+	try
+	{
+		ParallelIirRenderer renderer (num_threads);
+		for (auto c = 0; c < num_channels; ++c)
+		{
+			renderer.process (*filter->channels[c], channels[c], num_samples);
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		return SSPO_ERROR_OUT_OF_MEMORY;
+	}
+	catch (const std::system_error&)
+	{
+		return SSPO_ERROR_OUT_OF_MEMORY;
+	}
+	return SSPO_OK;
+}
+
+sspo_result sspo_preset_bank_write (const char* path, const sspo_preset* presets, int num_presets,
+	const int* sample_rates, int num_sample_rates)
+{
+	if (path == nullptr || presets == nullptr || num_presets <= 0 || sample_rates == nullptr || num_sample_rates <= 0)
+		return SSPO_ERROR_INVALID_ARGUMENT;
+
+	try
+	{
+		PresetBankWriter writer;
+		for (auto i = 0; i < num_sample_rates; ++i)
+		{
+			if (sample_rates[i] <= 0) return SSPO_ERROR_INVALID_ARGUMENT;
+			writer.addSampleRate (sample_rates[i]);
+		}
+		for (auto i = 0; i < num_presets; ++i)
+		{
+			const auto& p = presets[i];
+			if (!isLinearType (p.type_index)) return SSPO_ERROR_INVALID_ARGUMENT;
+			writer.addPreset ({ p.name != nullptr ? p.name : "", p.type_index, p.frequency, p.q, p.gain_db });
+		}
+		return writer.write (path) ? SSPO_OK : SSPO_ERROR_INVALID_ARGUMENT;
+	}
+	catch (const std::bad_alloc&)
+	{
+		return SSPO_ERROR_OUT_OF_MEMORY;
+	}
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+/*
+ * Plain C interface to the dsp filters, for embedding them without JUCE.
+ *
+ * A sspo_filter holds one MultiFilter per channel, all sharing the same type
+ * and parameters. Audio is processed in place, in planar (non interleaved)
+ * blocks. None of these functions are safe to call concurrently on the same
+ * sspo_filter, setting parameters while another thread processes is not
+ * supported, apply changes between calls to sspo_filter_process instead.
+ */
+
+#ifndef SSPO_FILTER_H
+#define SSPO_FILTER_H
+
+#include <stdint.h>
+
+#if defined(_WIN32) && defined(SSPO_FILTER_SHARED)
+ #if defined(SSPO_FILTER_BUILDING)
+  #define SSPO_API __declspec(dllexport)
+ #else
+  #define SSPO_API __declspec(dllimport)
+ #endif
+#elif defined(SSPO_FILTER_BUILDING)
+ #define SSPO_API __attribute__ ((visibility ("default")))
+#else
+ #define SSPO_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct sspo_filter sspo_filter;
+
+typedef enum sspo_result
+{
+	SSPO_OK = 0,
+	SSPO_ERROR_INVALID_ARGUMENT = -1,
+	SSPO_ERROR_OUT_OF_MEMORY = -2,
+	SSPO_ERROR_DISCONNECTED = -3	/* sspo_filter_client.h, the daemon could not be reached or has gone */
+} sspo_result;
+
+/* the number of filter types, type indices run from 0 to this - 1, 0 if out of memory */
+SSPO_API int sspo_filter_type_count (void);
+
+/* the display name of a type ("LP12", "Peak", ...), NULL if out of range */
+SSPO_API const char* sspo_filter_type_name (int type_index);
+
+/* non zero if the type responds to Q / gain */
+SSPO_API int sspo_filter_type_uses_q (int type_index);
+SSPO_API int sspo_filter_type_uses_gain (int type_index);
+
+/* returns NULL on failure, the filter starts as type 0 at 1kHz, Q 0.707, 0dB */
+SSPO_API sspo_filter* sspo_filter_create (int num_channels, int sample_rate);
+SSPO_API void sspo_filter_destroy (sspo_filter* filter);
+
+SSPO_API sspo_result sspo_filter_set_type (sspo_filter* filter, int type_index);
+SSPO_API sspo_result sspo_filter_set_type_name (sspo_filter* filter, const char* type_name);
+SSPO_API sspo_result sspo_filter_set_sample_rate (sspo_filter* filter, int sample_rate);
+
+/* frequency in Hz (clamped to 20Hz - 20kHz), Q (clamped to 0.1 - 20), gain in dB */
+SSPO_API sspo_result sspo_filter_set_params (sspo_filter* filter, float frequency, float q, float gain_db);
+
+/* clears the filter state of every channel, the parameters are kept */
+SSPO_API void sspo_filter_reset (sspo_filter* filter);
+
+/*
+ * Filters num_samples of each of num_channels planar buffers in place.
+ * num_channels must not exceed the count the filter was created with, and
+ * none of the buffers may be NULL, nothing is processed otherwise.
+ */
+SSPO_API sspo_result sspo_filter_process (sspo_filter* filter, float* const* channels, int num_channels, int num_samples);
+
+/*
+ * As sspo_filter_process, for offline rendering of long buffers. Each channel is
+ * split across num_threads threads (0 for every core). Both are within float
+ * rounding of the exact result but round differently, at low cutoffs with high Q
+ * they can differ by as much as -40 dB. The filter state carries on across calls
+ * to either. Nonlinear types, the Ladder, are processed on the calling
+ * thread alone, exactly as sspo_filter_process.
+ */
+SSPO_API sspo_result sspo_filter_process_offline (sspo_filter* filter, float* const* channels, int num_channels,
+	int64_t num_samples, int num_threads);
+
+/*
+ * Preset banks hold presets with their coefficients designed for each of a set
+ * of sample rates, the plugin memory maps one as its programs. Only linear types
+ * can be stored as coefficients, a preset of a nonlinear type, the Ladder, is
+ * SSPO_ERROR_INVALID_ARGUMENT.
+ */
+typedef struct sspo_preset
+{
+	const char* name;	/* up to 31 bytes are kept */
+	int type_index;
+	float frequency;
+	float q;
+	float gain_db;
+} sspo_preset;
+
+SSPO_API sspo_result sspo_preset_bank_write (const char* path, const sspo_preset* presets, int num_presets,
+	const int* sample_rates, int num_sample_rates);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SSPO_FILTER_H */
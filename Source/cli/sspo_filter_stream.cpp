@@ -0,0 +1,557 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+// sspo_filter_stream, a MultiFilter per channel for shell pipelines,
+//   sox in.flac -t wav - | sspo_filter_stream --type HP12 --freq 80 | lame - out.mp3
+// Reads WAV, or raw with --raw, interleaved PCM from stdin and writes the same format to
+// stdout. Whatever whole frames have arrived, up to --block of them, are filtered and
+// written straight away, so the added latency is at most one block and memory stays
+// constant however long the stream. Parameters can be changed while running by writing
+// lines to the --control fifo, any of
+//   type <name or index>   freq <hz>   q <q>   gain <db>   reset
+// several to a line, "freq 500 q 2", and they glide to the new values at control rate.
+// Samples are little endian, as on the hosts it runs on.
+//
+// usage: sspo_filter_stream [--raw --rate <hz> --channels <n> --format s16|s24|s32|f32]
+//                           [--block <frames>] [--type <name or index>] [--freq <hz>]
+//                           [--q <q>] [--gain <db>] [--control <fifo>]
+
+#include "dsp/Filter.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+	constexpr int k_controlRate = 32;
+	constexpr int k_maxChannels = 64;
+	constexpr int k_maxBlock = 1 << 16;
+
+	// the data length of a stream that runs until stdin ends
+	constexpr uint64_t k_untilEnd = UINT64_MAX;
+
+	enum class SampleFormat { s16, s24, s32, f32 };
+
+	struct StreamFormat
+	{
+		SampleFormat format{ SampleFormat::s16 };
+		int channels{ 2 };
+		int sampleRate{ 44100 };
+		uint64_t dataBytes{ k_untilEnd };
+
+		int bytesPerSample () const noexcept
+		{
+			return format == SampleFormat::s16 ? 2 : (format == SampleFormat::s24 ? 3 : 4);
+		}
+		int bytesPerFrame () const noexcept { return bytesPerSample () * channels; }
+	};
+
+	struct Parameters
+	{
+		int type{ 1 };
+		float frequency{ 1000.0f };
+		float q{ 0.707f };
+		float gain{ 0.0f };
+	};
+
+	bool parseFormat (const std::string& name, SampleFormat& format)
+	{
+		if (name == "s16") format = SampleFormat::s16;
+		else if (name == "s24") format = SampleFormat::s24;
+		else if (name == "s32") format = SampleFormat::s32;
+		else if (name == "f32") format = SampleFormat::f32;
+		else return false;
+		return true;
+	}
+
+	/// a type by name, "LP12", or by index
+	bool parseType (const std::string& name, int& type)
+	{
+		const auto types = MultiFilter::typeStings ();
+		for (auto i = 0; i < static_cast<int> (types.size ()); ++i)
+		{
+			if (types[i] == name)
+			{
+				type = i;
+				return true;
+			}
+		}
+		char* end = nullptr;
+		const auto index = std::strtol (name.c_str (), &end, 10);
+		if (end == name.c_str () || *end != 0 || index < 0 || index >= static_cast<long> (types.size ())) return false;
+		type = static_cast<int> (index);
+		return true;
+	}
+
+	/// reads exactly size bytes, false at the end of the stream
+	bool readFully (int fd, void* data, size_t size)
+	{
+		auto* bytes = static_cast<char*> (data);
+		while (size > 0)
+		{
+			const auto n = read (fd, bytes, size);
+			if (n < 0 && errno == EINTR) continue;
+			if (n <= 0) return false;
+			bytes += n;
+			size -= static_cast<size_t> (n);
+		}
+		return true;
+	}
+
+	bool writeFully (int fd, const void* data, size_t size)
+	{
+		const auto* bytes = static_cast<const char*> (data);
+		while (size > 0)
+		{
+			const auto n = write (fd, bytes, size);
+			if (n < 0 && errno == EINTR) continue;
+			if (n == 0) errno = EIO;	// nothing written yet no error, reported as one
+			if (n <= 0) return false;
+			bytes += n;
+			size -= static_cast<size_t> (n);
+		}
+		return true;
+	}
+
+	/// a reader that has gone away ends the stream as it would in a pipeline, any other
+	/// failed write is reported, false then
+	bool outputClosed ()
+	{
+		if (errno == EPIPE) return true;
+		std::fprintf (stderr, "sspo_filter_stream: writing stdout: %s\n", std::strerror (errno));
+		return false;
+	}
+
+	uint16_t readU16 (const unsigned char* p) { return static_cast<uint16_t> (p[0] | p[1] << 8); }
+	uint32_t readU32 (const unsigned char* p) { return p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t> (p[3]) << 24; }
+	void writeU16 (unsigned char* p, uint32_t v) { p[0] = v & 0xff; p[1] = (v >> 8) & 0xff; }
+	void writeU32 (unsigned char* p, uint32_t v) { writeU16 (p, v & 0xffff); writeU16 (p + 2, v >> 16); }
+
+	/// reads and drops size bytes, false at the end of the stream
+	bool skip (int fd, uint64_t size)
+	{
+		unsigned char buffer[4096];
+		while (size > 0)
+		{
+			const auto n = static_cast<size_t> (std::min<uint64_t> (size, sizeof (buffer)));
+			if (!readFully (fd, buffer, n)) return false;
+			size -= n;
+		}
+		return true;
+	}
+
+	///
+	/// \brief readWavHeader
+	/// Reads up to the start of the data chunk, whose length the stream stops at, unless
+	/// it is 0 or 0xffffffff, as streaming writers leave it, when the data runs to the end
+	/// of the stream. Only the fields of a fmt chunk are kept, the rest of it and every other
+	/// chunk are skipped a buffer at a time, whatever size they claim.
+	bool readWavHeader (int fd, StreamFormat& format, std::string& error)
+	{
+		unsigned char riff[12];
+		if (!readFully (fd, riff, sizeof (riff)) || std::memcmp (riff, "RIFF", 4) != 0 || std::memcmp (riff + 8, "WAVE", 4) != 0)
+		{
+			error = "stdin is not a WAV stream, use --raw for raw PCM";
+			return false;
+		}
+
+		auto haveFormat = false;
+		while (true)
+		{
+			unsigned char chunk[8];
+			if (!readFully (fd, chunk, sizeof (chunk)))
+			{
+				error = "no data chunk";
+				return false;
+			}
+			const auto size = readU32 (chunk + 4);
+			if (std::memcmp (chunk, "data", 4) == 0)
+			{
+				format.dataBytes = size == 0 || size == 0xffffffff ? k_untilEnd : size;
+				break;
+			}
+
+			// as much of a fmt chunk as WAVE_FORMAT_EXTENSIBLE uses, chunks are padded to an even length
+			unsigned char body[40];
+			const auto isFormat = std::memcmp (chunk, "fmt ", 4) == 0 && size >= 16;
+			const auto kept = isFormat ? std::min<uint32_t> (size, sizeof (body)) : 0;
+			if (!readFully (fd, body, kept) || !skip (fd, static_cast<uint64_t> (size) - kept + (size & 1)))
+			{
+				error = "truncated header";
+				return false;
+			}
+			if (!isFormat) continue;
+
+			auto tag = readU16 (body);
+			// WAVE_FORMAT_EXTENSIBLE, the real tag leads the sub format guid
+			if (tag == 0xfffe && size >= 40) tag = readU16 (body + 24);
+			format.channels = readU16 (body + 2);
+			format.sampleRate = static_cast<int> (readU32 (body + 4));
+			const auto bits = readU16 (body + 14);
+
+			if (tag == 1 && bits == 16) format.format = SampleFormat::s16;
+			else if (tag == 1 && bits == 24) format.format = SampleFormat::s24;
+			else if (tag == 1 && bits == 32) format.format = SampleFormat::s32;
+			else if (tag == 3 && bits == 32) format.format = SampleFormat::f32;
+			else
+			{
+				error = "unsupported WAV format, 16, 24 or 32 bit PCM or 32 bit float only";
+				return false;
+			}
+			haveFormat = true;
+		}
+		if (!haveFormat) error = "no fmt chunk before the data";
+		return haveFormat;
+	}
+
+	/// a plain header with the lengths left at their maximum, as they are not known up front
+	bool writeWavHeader (int fd, const StreamFormat& format)
+	{
+		unsigned char header[44];
+		std::memcpy (header, "RIFF", 4);
+		writeU32 (header + 4, 0xffffffff);
+		std::memcpy (header + 8, "WAVEfmt ", 8);
+		writeU32 (header + 16, 16);
+		writeU16 (header + 20, format.format == SampleFormat::f32 ? 3 : 1);
+		writeU16 (header + 22, static_cast<uint32_t> (format.channels));
+		writeU32 (header + 24, static_cast<uint32_t> (format.sampleRate));
+		writeU32 (header + 28, static_cast<uint32_t> (format.sampleRate * format.bytesPerFrame ()));
+		writeU16 (header + 32, static_cast<uint32_t> (format.bytesPerFrame ()));
+		writeU16 (header + 34, static_cast<uint32_t> (format.bytesPerSample () * 8));
+		std::memcpy (header + 36, "data", 4);
+		writeU32 (header + 40, 0xffffffff);
+		return writeFully (fd, header, sizeof (header));
+	}
+
+	template <typename Int>
+	Int toInt (float sample, float scale) noexcept
+	{
+		const auto scaled = std::nearbyint (sample * scale);
+		return static_cast<Int> (std::min (scale - 1.0f, std::max (-scale, scaled)));
+	}
+
+	///
+	/// \brief The Stream class
+	/// The filters and every buffer, sized once for the format and block size
+	class Stream
+	{
+	public:
+		Stream (const StreamFormat& format, int blockSize, const Parameters& parameters)
+			: m_format (format), m_blockSize (blockSize), m_parameters (parameters),
+			m_bytes (static_cast<size_t> (blockSize) * format.bytesPerFrame ()),
+			m_planar (static_cast<size_t> (format.channels), std::vector<float> (static_cast<size_t> (blockSize)))
+		{
+			for (auto c = 0; c < format.channels; ++c)
+			{
+				m_filters.push_back (std::make_unique<MultiFilter> ());
+				m_filters.back ()->setSampleRate (format.sampleRate);
+				m_filters.back ()->setTypeIndex (parameters.type, parameters.frequency, parameters.q, parameters.gain);
+				m_filters.back ()->setControlRate (k_controlRate);
+			}
+		}
+
+		/// runs until the end of the data or of stdin, or until stdout is closed, false on
+		/// an error reading stdin or writing stdout, which is reported on stderr
+		bool run (int controlFd)
+		{
+			size_t have = 0;
+			auto remaining = m_format.dataBytes;
+			while (remaining > 0)
+			{
+				const auto wanted = static_cast<size_t> (std::min<uint64_t> (remaining, m_bytes.size () - have));
+				const auto n = read (STDIN_FILENO, m_bytes.data () + have, wanted);
+				if (n < 0 && errno == EINTR) continue;
+				if (n < 0)
+				{
+					std::fprintf (stderr, "sspo_filter_stream: reading stdin: %s\n", std::strerror (errno));
+					return false;
+				}
+				if (n == 0) break;
+				have += static_cast<size_t> (n);
+				if (remaining != k_untilEnd) remaining -= static_cast<uint64_t> (n);
+
+				if (controlFd >= 0) pollControl (controlFd);
+
+				// whatever whole frames have arrived, the partial one waits for the next read
+				const auto frames = static_cast<int> (have / m_format.bytesPerFrame ());
+				if (frames == 0) continue;
+				const auto used = static_cast<size_t> (frames) * m_format.bytesPerFrame ();
+				process (frames);
+				if (!writeFully (STDOUT_FILENO, m_bytes.data (), used)) return outputClosed ();
+				std::memmove (m_bytes.data (), m_bytes.data () + used, have - used);
+				have -= used;
+			}
+			return true;
+		}
+
+	private:
+		void process (int frames)
+		{
+			deinterleave (frames);
+			for (auto c = 0; c < m_format.channels; ++c) m_filters[c]->processBlock (m_planar[c].data (), frames);
+			interleave (frames);
+		}
+
+		void deinterleave (int frames)
+		{
+			const auto channels = m_format.channels;
+			const auto* bytes = m_bytes.data ();
+			for (auto c = 0; c < channels; ++c)
+			{
+				auto* out = m_planar[c].data ();
+				switch (m_format.format)
+				{
+				case SampleFormat::s16:
+					for (auto i = 0; i < frames; ++i)
+					{
+						int16_t s;
+						std::memcpy (&s, bytes + (i * channels + c) * 2, 2);
+						out[i] = s * (1.0f / 32768.0f);
+					}
+					break;
+				case SampleFormat::s24:
+					for (auto i = 0; i < frames; ++i)
+					{
+						const auto* p = bytes + (i * channels + c) * 3;
+						// into the top of an int32 then down, to sign extend
+						const auto s = static_cast<int32_t> (static_cast<uint32_t> (p[0]) << 8 | static_cast<uint32_t> (p[1]) << 16 | static_cast<uint32_t> (p[2]) << 24) >> 8;
+						out[i] = s * (1.0f / 8388608.0f);
+					}
+					break;
+				case SampleFormat::s32:
+					for (auto i = 0; i < frames; ++i)
+					{
+						int32_t s;
+						std::memcpy (&s, bytes + (i * channels + c) * 4, 4);
+						out[i] = static_cast<float> (s * (1.0 / 2147483648.0));
+					}
+					break;
+				case SampleFormat::f32:
+					for (auto i = 0; i < frames; ++i) std::memcpy (out + i, bytes + (i * channels + c) * 4, 4);
+					break;
+				}
+			}
+		}
+
+		void interleave (int frames)
+		{
+			const auto channels = m_format.channels;
+			auto* bytes = m_bytes.data ();
+			for (auto c = 0; c < channels; ++c)
+			{
+				const auto* in = m_planar[c].data ();
+				switch (m_format.format)
+				{
+				case SampleFormat::s16:
+					for (auto i = 0; i < frames; ++i)
+					{
+						const auto s = toInt<int16_t> (in[i], 32768.0f);
+						std::memcpy (bytes + (i * channels + c) * 2, &s, 2);
+					}
+					break;
+				case SampleFormat::s24:
+					for (auto i = 0; i < frames; ++i)
+					{
+						const auto s = static_cast<uint32_t> (toInt<int32_t> (in[i], 8388608.0f));
+						auto* p = bytes + (i * channels + c) * 3;
+						p[0] = s & 0xff;
+						p[1] = (s >> 8) & 0xff;
+						p[2] = (s >> 16) & 0xff;
+					}
+					break;
+				case SampleFormat::s32:
+					for (auto i = 0; i < frames; ++i)
+					{
+						// in double, as full scale is not exactly a float below 2^31
+						const auto scaled = std::nearbyint (static_cast<double> (in[i]) * 2147483648.0);
+						const auto s = static_cast<int32_t> (std::min (2147483647.0, std::max (-2147483648.0, scaled)));
+						std::memcpy (bytes + (i * channels + c) * 4, &s, 4);
+					}
+					break;
+				case SampleFormat::f32:
+					for (auto i = 0; i < frames; ++i) std::memcpy (bytes + (i * channels + c) * 4, in + i, 4);
+					break;
+				}
+			}
+		}
+
+		/// applies any whole lines written to the control fifo since the last block
+		void pollControl (int fd)
+		{
+			char buffer[256];
+			while (true)
+			{
+				const auto n = read (fd, buffer, sizeof (buffer));
+				if (n <= 0) break;
+				for (auto i = 0; i < n; ++i)
+				{
+					if (buffer[i] != '\n')
+					{
+						// an over long line is dropped rather than grown without bound
+						if (m_controlLine.size () < sizeof (buffer)) m_controlLine.push_back (buffer[i]);
+						continue;
+					}
+					applyControl (m_controlLine);
+					m_controlLine.clear ();
+				}
+			}
+		}
+
+		void applyControl (const std::string& line)
+		{
+			std::istringstream words (line);
+			std::string key, value;
+			auto parameters = m_parameters;
+			auto reset = false;
+			while (words >> key)
+			{
+				if (key == "reset")
+				{
+					reset = true;
+					continue;
+				}
+				if (!(words >> value))
+				{
+					std::fprintf (stderr, "sspo_filter_stream: %s needs a value\n", key.c_str ());
+					return;
+				}
+				if (key == "type" && parseType (value, parameters.type)) continue;
+				else if (key == "freq") parameters.frequency = std::min (std::max (std::strtof (value.c_str (), nullptr), 20.0f), 20000.0f);
+				else if (key == "q") parameters.q = std::min (std::max (std::strtof (value.c_str (), nullptr), 0.1f), 20.0f);
+				else if (key == "gain") parameters.gain = std::strtof (value.c_str (), nullptr);
+				else
+				{
+					std::fprintf (stderr, "sspo_filter_stream: ignoring \"%s\"\n", line.c_str ());
+					return;
+				}
+			}
+
+			m_parameters = parameters;
+			for (auto& f : m_filters)
+			{
+				f->setTypeIndex (parameters.type, parameters.frequency, parameters.q, parameters.gain);
+				if (reset) f->clear ();
+			}
+		}
+
+		StreamFormat m_format;
+		int m_blockSize;
+		Parameters m_parameters;
+		std::vector<unsigned char> m_bytes;
+		std::vector<std::vector<float>> m_planar;
+		std::vector<std::unique_ptr<MultiFilter>> m_filters;
+		std::string m_controlLine;
+	};
+
+	void usage ()
+	{
+		std::fprintf (stderr,
+			"usage: sspo_filter_stream [--raw --rate <hz> --channels <n> --format s16|s24|s32|f32]\n"
+			"                          [--block <frames>] [--type <name or index>] [--freq <hz>]\n"
+			"                          [--q <q>] [--gain <db>] [--control <fifo>]\n");
+	}
+}
+
+int main (int argc, char* argv[])
+{
+	StreamFormat format;
+	Parameters parameters;
+	auto raw = false;
+	auto blockSize = 256;
+	std::string controlPath;
+
+	for (auto i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		const auto hasValue = i + 1 < argc;
+		auto ok = true;
+		if (arg == "--raw") raw = true;
+		else if (arg == "--rate" && hasValue) format.sampleRate = std::atoi (argv[++i]);
+		else if (arg == "--channels" && hasValue) format.channels = std::atoi (argv[++i]);
+		else if (arg == "--format" && hasValue) ok = parseFormat (argv[++i], format.format);
+		else if (arg == "--block" && hasValue) blockSize = std::atoi (argv[++i]);
+		else if (arg == "--type" && hasValue) ok = parseType (argv[++i], parameters.type);
+		else if (arg == "--freq" && hasValue) parameters.frequency = std::strtof (argv[++i], nullptr);
+		else if (arg == "--q" && hasValue) parameters.q = std::strtof (argv[++i], nullptr);
+		else if (arg == "--gain" && hasValue) parameters.gain = std::strtof (argv[++i], nullptr);
+		else if (arg == "--control" && hasValue) controlPath = argv[++i];
+		else ok = false;
+
+		if (!ok)
+		{
+			usage ();
+			return 2;
+		}
+	}
+	parameters.frequency = std::min (std::max (parameters.frequency, 20.0f), 20000.0f);
+	parameters.q = std::min (std::max (parameters.q, 0.1f), 20.0f);
+
+	if (!raw)
+	{
+		std::string error;
+		if (!readWavHeader (STDIN_FILENO, format, error))
+		{
+			std::fprintf (stderr, "sspo_filter_stream: %s\n", error.c_str ());
+			return 1;
+		}
+	}
+	if (format.channels <= 0 || format.channels > k_maxChannels || format.sampleRate <= 0 || blockSize <= 0 || blockSize > k_maxBlock)
+	{
+		usage ();
+		return 2;
+	}
+
+	// non blocking, so a fifo with no writer neither holds up opening nor any block
+	auto controlFd = -1;
+	if (!controlPath.empty ())
+	{
+		controlFd = open (controlPath.c_str (), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+		if (controlFd < 0)
+		{
+			std::fprintf (stderr, "sspo_filter_stream: could not open %s: %s\n", controlPath.c_str (), std::strerror (errno));
+			return 1;
+		}
+	}
+
+	// a closed stdout ends the stream through a failed write, not a signal
+	signal (SIGPIPE, SIG_IGN);
+
+	if (!raw && !writeWavHeader (STDOUT_FILENO, format)) return outputClosed () ? 0 : 1;
+
+	Stream stream (format, blockSize, parameters);
+	const auto ok = stream.run (controlFd);
+	if (controlFd >= 0) close (controlFd);
+	return ok ? 0 : 1;
+}
@@ -49,7 +49,23 @@
 
 #include "dsp/AudioMath.h"
 #include "dsp/AudioProcess.h"
+#include "dsp/DspArena.h"
+#include "dsp/DynamicEq.h"
+#include "dsp/EnvelopeFollower.h"
+#include "dsp/FastTanh.h"
 #include "dsp/Filter.h"
-#include "gui/SspoLookandFeel.h"
+#include "dsp/FixedBiquad.h"
+#include "dsp/FixedPointBiquad.h"
+#include "dsp/FrequencyResponse.h"
+#include "dsp/Oversampling.h"
+#include "dsp/ParallelIir.h"
+#include "dsp/ParametricEq.h"
+#include "dsp/PresetBank.h"
+#include "dsp/ProcessStats.h"
+#include "dsp/TripleBuffer.h"
+#include "gui/SspoLookAndFeel.h"
+#include "gui/ProcessStatsOverlay.h"
+#include "gui/ResponseCurve.h"
+#include "gui/SpectrumAnalyser.h"
 
 
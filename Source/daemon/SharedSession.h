@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+///
+/// What sspo_filterd and its clients share. A client connects to the daemon's unix socket
+/// and sends a ConnectRequest, the daemon creates a session, a memfd holding a Header and a
+/// ring of block slots, and passes the fd back with the ConnectReply. From then on audio
+/// never passes through the socket, the client writes a block straight into a slot's planar
+/// channels, bumps Header::submitted, and the daemon filters it in place and bumps
+/// Header::completed. Each side waits on the other's counter with a futex, only making
+/// the system call when the other side has said it is asleep. The socket stays open for the
+/// life of the session, the daemon ends the session when it closes.
+namespace sharedSession
+{
+	constexpr uint32_t k_magic = 0x53504f44;	// "SPOD"
+	constexpr uint32_t k_version = 1;
+
+	constexpr int k_maxChannels = 64;
+	constexpr int k_maxBlockSize = 8192;
+	constexpr int k_maxSlots = 64;
+	constexpr size_t k_cacheLine = 64;
+
+	/// polls of the other side's counter before sleeping on it
+	constexpr int k_spinIterations = 2000;
+
+	/// how long a futex wait sleeps before checking the other side is still there
+	constexpr long k_waitTimeoutNs = 100000000;
+
+	struct ConnectRequest
+	{
+		uint32_t magic;
+		uint32_t version;
+		int32_t numChannels;
+		int32_t sampleRate;
+		int32_t maxBlockSize;
+		int32_t numSlots;
+	};
+
+	struct ConnectReply
+	{
+		int32_t result;	// an sspo_result
+		uint32_t mappingSize;
+	};
+
+	/// the shape of the mapping, each side keeps its own copy from the validated ConnectRequest
+	/// and never reads it back from the Header, which the other process can write
+	struct Geometry
+	{
+		int numChannels;
+		int maxBlockSize;
+		int numSlots;
+	};
+
+	static_assert (sizeof (std::atomic<uint32_t>) == sizeof (uint32_t) && std::atomic<uint32_t>::is_always_lock_free,
+		"the counters are futex words and are shared between processes");
+
+	///
+	/// \brief The Header struct
+	/// At the start of the mapping, the counters each on their own cache line as the two
+	/// processes write them from different cores. The counters count blocks, wrapping, so
+	/// they are only ever compared by their difference.
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+
+		/// a copy of the request for inspection only, neither side trusts it, see Geometry
+		int32_t numChannels;
+		int32_t sampleRate;
+		int32_t maxBlockSize;
+		int32_t numSlots;
+
+		/// written by the client under a sequence lock, odd while it is part way through
+		alignas (k_cacheLine) std::atomic<uint32_t> paramsSequence;
+		std::atomic<int32_t> type;
+		std::atomic<float> frequency;
+		std::atomic<float> q;
+		std::atomic<float> gain;
+
+		alignas (k_cacheLine) std::atomic<uint32_t> submitted;
+		std::atomic<uint32_t> daemonWaiting;
+
+		alignas (k_cacheLine) std::atomic<uint32_t> completed;
+		std::atomic<uint32_t> clientWaiting;
+
+		alignas (k_cacheLine) std::atomic<uint32_t> shutdown;
+	};
+
+	/// each slot, followed by numChannels planar blocks of maxBlockSize floats
+	struct alignas (k_cacheLine) SlotHeader
+	{
+		int32_t numSamples;
+	};
+
+	inline size_t roundToCacheLine (size_t bytes)
+	{
+		return (bytes + k_cacheLine - 1) / k_cacheLine * k_cacheLine;
+	}
+
+	inline size_t channelStride (int maxBlockSize)
+	{
+		return roundToCacheLine (static_cast<size_t> (maxBlockSize) * sizeof (float));
+	}
+
+	inline size_t slotStride (int numChannels, int maxBlockSize)
+	{
+		return sizeof (SlotHeader) + static_cast<size_t> (numChannels) * channelStride (maxBlockSize);
+	}
+
+	inline size_t mappingSize (int numChannels, int maxBlockSize, int numSlots)
+	{
+		return roundToCacheLine (sizeof (Header)) + static_cast<size_t> (numSlots) * slotStride (numChannels, maxBlockSize);
+	}
+
+	inline bool isValid (const ConnectRequest& r)
+	{
+		return r.magic == k_magic && r.version == k_version
+			&& r.numChannels > 0 && r.numChannels <= k_maxChannels
+			&& r.maxBlockSize > 0 && r.maxBlockSize <= k_maxBlockSize
+			&& r.numSlots > 0 && r.numSlots <= k_maxSlots
+			&& r.sampleRate > 0;
+	}
+
+	inline Geometry geometry (const ConnectRequest& r)
+	{
+		return { r.numChannels, r.maxBlockSize, r.numSlots };
+	}
+
+	inline size_t mappingSize (const Geometry& g)
+	{
+		return mappingSize (g.numChannels, g.maxBlockSize, g.numSlots);
+	}
+
+	inline SlotHeader* slot (void* mapping, const Geometry& g, uint32_t index)
+	{
+		auto* base = static_cast<char*> (mapping) + roundToCacheLine (sizeof (Header));
+		return reinterpret_cast<SlotHeader*> (base + (index % static_cast<uint32_t> (g.numSlots)) * slotStride (g.numChannels, g.maxBlockSize));
+	}
+
+	inline float* channel (SlotHeader* s, const Geometry& g, int c)
+	{
+		return reinterpret_cast<float*> (reinterpret_cast<char*> (s) + sizeof (SlotHeader) + c * channelStride (g.maxBlockSize));
+	}
+
+	/// $XDG_RUNTIME_DIR/sspo_filterd.sock, or in /tmp without one
+	inline std::string defaultSocketPath ()
+	{
+		const auto* runtime = std::getenv ("XDG_RUNTIME_DIR");
+		return std::string (runtime != nullptr && *runtime != 0 ? runtime : "/tmp") + "/sspo_filterd.sock";
+	}
+
+	inline uint32_t* futexWord (std::atomic<uint32_t>& word)
+	{
+		return reinterpret_cast<uint32_t*> (&word);
+	}
+
+	/// shared futexes, not FUTEX_PRIVATE_FLAG, as the word is in another process' mapping too
+	inline void futexWait (std::atomic<uint32_t>& word, uint32_t expected)
+	{
+		timespec timeout{ 0, k_waitTimeoutNs };
+		syscall (SYS_futex, futexWord (word), FUTEX_WAIT, expected, &timeout, nullptr, 0);
+	}
+
+	inline void futexWake (std::atomic<uint32_t>& word)
+	{
+		syscall (SYS_futex, futexWord (word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+	}
+
+	///
+	/// \brief publish
+	/// Stores a new count and wakes the other side only if it has said it is asleep.
+	/// Both this and waitWhile are sequentially consistent, so either the waiter sees the new
+	/// count before sleeping or the publisher sees the waiting flag.
+	inline void publish (std::atomic<uint32_t>& counter, uint32_t value, std::atomic<uint32_t>& otherWaiting)
+	{
+		counter.store (value);
+		if (otherWaiting.load () != 0) futexWake (counter);
+	}
+
+	///
+	/// \brief waitWhile
+	/// Waits for counter to move on from value, spinning briefly then sleeping on the futex.
+	/// Returns false, without the counter having moved, when stillThere() says the other
+	/// side has gone, which is checked every time a sleep times out.
+	template <typename StillThere>
+	bool waitWhile (std::atomic<uint32_t>& counter, uint32_t value, std::atomic<uint32_t>& waiting, StillThere&& stillThere)
+	{
+		for (auto i = 0; i < k_spinIterations; ++i)
+			if (counter.load (std::memory_order_acquire) != value) return true;
+
+		while (true)
+		{
+			waiting.store (1);
+			if (counter.load () != value)
+			{
+				waiting.store (0);
+				return true;
+			}
+			futexWait (counter, value);
+			waiting.store (0);
+			if (counter.load (std::memory_order_acquire) != value) return true;
+			if (!stillThere ()) return false;
+		}
+	}
+}
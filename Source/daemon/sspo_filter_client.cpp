@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+
+#include "sspo_filter_client.h"
+#include "SharedSession.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+struct sspo_client
+{
+	int socket{ -1 };
+	void* mapping{ MAP_FAILED };
+	size_t size{ 0 };
+	sharedSession::Header* header{ nullptr };
+	sharedSession::Geometry geometry{};
+
+	/// the planar channel pointers of each slot
+	std::vector<std::vector<float*>> slots;
+
+	/// blocks submitted and released, so submitted - released are in flight
+	uint32_t submitted{ 0 };
+	uint32_t released{ 0 };
+	bool waited{ false };
+
+	/// set once a wait finds the daemon gone, after which nothing more is sent
+	bool disconnected{ false };
+
+	~sspo_client ()
+	{
+		if (mapping != MAP_FAILED) munmap (mapping, size);
+		if (socket >= 0) close (socket);
+	}
+
+	/// the daemon sends nothing after the reply, so anything readable is it closing
+	bool daemonStillThere () const
+	{
+		pollfd state{ socket, POLLIN | POLLRDHUP, 0 };
+		return poll (&state, 1, 0) == 0;
+	}
+};
+
+namespace
+{
+	/// the reply, and the memfd passed with it, -1 if there was none
+	bool receiveReply (int socket, sharedSession::ConnectReply& reply, int& fd)
+	{
+		iovec data{ &reply, sizeof (reply) };
+		msghdr message{};
+		message.msg_iov = &data;
+		message.msg_iovlen = 1;
+		alignas (cmsghdr) char control[CMSG_SPACE (sizeof (int))];
+		message.msg_control = control;
+		message.msg_controllen = sizeof (control);
+
+		fd = -1;
+		if (recvmsg (socket, &message, MSG_WAITALL | MSG_CMSG_CLOEXEC) != static_cast<ssize_t> (sizeof (reply))) return false;
+		for (auto* header = CMSG_FIRSTHDR (&message); header != nullptr; header = CMSG_NXTHDR (&message, header))
+			if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS)
+				std::memcpy (&fd, CMSG_DATA (header), sizeof (int));
+		return true;
+	}
+}
+
+sspo_client* sspo_client_connect (const char* socket_path, int num_channels, int sample_rate, int max_block_size, int num_slots)
+{
+	const sharedSession::ConnectRequest request{ sharedSession::k_magic, sharedSession::k_version,
+		num_channels, sample_rate, max_block_size, num_slots };
+	if (!sharedSession::isValid (request)) return nullptr;
+
+	const auto path = socket_path != nullptr ? std::string (socket_path) : sharedSession::defaultSocketPath ();
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if (path.size () >= sizeof (address.sun_path)) return nullptr;
+	std::strcpy (address.sun_path, path.c_str ());
+
+	std::unique_ptr<sspo_client> client;
+	try
+	{
+		client = std::make_unique<sspo_client> ();
+	}
+	catch (const std::bad_alloc&)
+	{
+		return nullptr;
+	}
+
+	client->socket = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (client->socket < 0 || connect (client->socket, reinterpret_cast<sockaddr*> (&address), sizeof (address)) != 0)
+		return nullptr;
+	if (send (client->socket, &request, sizeof (request), MSG_NOSIGNAL) != static_cast<ssize_t> (sizeof (request)))
+		return nullptr;
+
+	sharedSession::ConnectReply reply{};
+	int memfd = -1;
+	if (!receiveReply (client->socket, reply, memfd) || reply.result != SSPO_OK || memfd < 0)
+	{
+		if (memfd >= 0) close (memfd);
+		return nullptr;
+	}
+
+	client->size = reply.mappingSize;
+	client->mapping = mmap (nullptr, client->size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+	close (memfd);
+	if (client->mapping == MAP_FAILED
+		|| client->size != sharedSession::mappingSize (sharedSession::geometry (request)))
+		return nullptr;
+
+	auto& h = *static_cast<sharedSession::Header*> (client->mapping);
+	if (h.magic != sharedSession::k_magic || h.version != sharedSession::k_version) return nullptr;
+	client->header = &h;
+	client->geometry = sharedSession::geometry (request);
+
+	try
+	{
+		client->slots.resize (static_cast<size_t> (num_slots));
+		for (auto i = 0; i < num_slots; ++i)
+		{
+			auto* s = sharedSession::slot (client->mapping, client->geometry, static_cast<uint32_t> (i));
+			for (auto c = 0; c < num_channels; ++c) client->slots[i].push_back (sharedSession::channel (s, client->geometry, c));
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		return nullptr;
+	}
+	return client.release ();
+}
+
+void sspo_client_disconnect (sspo_client* client)
+{
+	delete client;
+}
+
+sspo_result sspo_client_set_params (sspo_client* client, int type_index, float frequency, float q, float gain_db)
+{
+	if (client == nullptr || type_index < 0 || type_index >= sspo_filter_type_count ()) return SSPO_ERROR_INVALID_ARGUMENT;
+
+	// a sequence lock, the daemon skips the parameters while the count is odd or changes under it
+	auto& h = *client->header;
+	const auto sequence = h.paramsSequence.load (std::memory_order_relaxed);
+	h.paramsSequence.store (sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence (std::memory_order_release);
+	h.type.store (type_index, std::memory_order_relaxed);
+	h.frequency.store (std::min (std::max (frequency, 20.0f), 20000.0f), std::memory_order_relaxed);
+	h.q.store (std::min (std::max (q, 0.1f), 20.0f), std::memory_order_relaxed);
+	h.gain.store (gain_db, std::memory_order_relaxed);
+	h.paramsSequence.store (sequence + 2, std::memory_order_release);
+	return SSPO_OK;
+}
+
+float* const* sspo_client_acquire (sspo_client* client)
+{
+	if (client == nullptr) return nullptr;
+	if (client->submitted - client->released >= static_cast<uint32_t> (client->geometry.numSlots)) return nullptr;
+	return client->slots[client->submitted % client->slots.size ()].data ();
+}
+
+sspo_result sspo_client_submit (sspo_client* client, int num_samples)
+{
+	if (client == nullptr || num_samples < 0 || num_samples > client->geometry.maxBlockSize
+		|| client->submitted - client->released >= static_cast<uint32_t> (client->geometry.numSlots))
+		return SSPO_ERROR_INVALID_ARGUMENT;
+	if (client->disconnected) return SSPO_ERROR_DISCONNECTED;
+
+	auto& h = *client->header;
+	sharedSession::slot (client->mapping, client->geometry, client->submitted)->numSamples = num_samples;
+	sharedSession::publish (h.submitted, ++client->submitted, h.daemonWaiting);
+	return SSPO_OK;
+}
+
+float* const* sspo_client_wait (sspo_client* client, int* num_samples)
+{
+	if (client == nullptr || client->disconnected || client->released == client->submitted) return nullptr;
+
+	auto& h = *client->header;
+	if (!client->waited)
+	{
+		const auto stillThere = [client] { return client->daemonStillThere (); };
+		while (h.completed.load (std::memory_order_acquire) == client->released)
+			if (!sharedSession::waitWhile (h.completed, client->released, h.clientWaiting, stillThere))
+			{
+				client->disconnected = true;
+				return nullptr;
+			}
+		client->waited = true;
+	}
+
+	if (num_samples != nullptr) *num_samples = std::min (std::max (sharedSession::slot (client->mapping, client->geometry, client->released)->numSamples, 0),
+		client->geometry.maxBlockSize);
+	return client->slots[client->released % client->slots.size ()].data ();
+}
+
+void sspo_client_release (sspo_client* client)
+{
+	if (client == nullptr || !client->waited) return;
+	client->waited = false;
+	++client->released;
+}
+
+sspo_result sspo_client_process (sspo_client* client, float* const* channels, int num_channels, int num_samples)
+{
+	if (client != nullptr && client->disconnected) return SSPO_ERROR_DISCONNECTED;
+	if (client == nullptr || channels == nullptr || num_channels < 0 || num_channels > client->geometry.numChannels
+		|| num_samples < 0 || num_samples > client->geometry.maxBlockSize || client->submitted != client->released)
+		return SSPO_ERROR_INVALID_ARGUMENT;
+	for (auto c = 0; c < num_channels; ++c)
+		if (channels[c] == nullptr) return SSPO_ERROR_INVALID_ARGUMENT;
+
+	// the session's channels past num_channels are filtered too, from silence rather than
+	// whatever an earlier block left in the slot
+	auto* const* shared = sspo_client_acquire (client);
+	for (auto c = 0; c < num_channels; ++c) std::copy (channels[c], channels[c] + num_samples, shared[c]);
+	for (auto c = num_channels; c < client->geometry.numChannels; ++c) std::fill (shared[c], shared[c] + num_samples, 0.0f);
+	const auto result = sspo_client_submit (client, num_samples);
+	if (result != SSPO_OK) return result;
+
+	auto* const* filtered = sspo_client_wait (client, nullptr);
+	if (filtered == nullptr) return SSPO_ERROR_DISCONNECTED;
+	for (auto c = 0; c < num_channels; ++c) std::copy (filtered[c], filtered[c] + num_samples, channels[c]);
+	sspo_client_release (client);
+	return SSPO_OK;
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+
+/*
+ * Client of sspo_filterd, the local filtering daemon, for processes that would otherwise
+ * each load their own filters.
+ *
+ * A session holds one filter per channel in the daemon, all sharing the same type and
+ * parameters, and a ring of num_slots blocks in memory shared with the daemon. A block is
+ * written into the shared planar buffers returned by sspo_client_acquire, handed over with
+ * sspo_client_submit, and read back in place once sspo_client_wait returns it, so the
+ * audio is never copied between the processes. Up to num_slots blocks may be in flight at
+ * once, they are filtered and returned in order. sspo_client_process does all of that for
+ * one block held in the caller's own buffers, at the cost of a copy each way.
+ *
+ * A session is used from one thread at a time. Everything stays on one machine, the
+ * daemon is reached through a unix socket.
+ */
+
+#ifndef SSPO_FILTER_CLIENT_H
+#define SSPO_FILTER_CLIENT_H
+
+#include "sspo_filter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct sspo_client sspo_client;
+
+/*
+ * Opens a session, socket_path NULL for the daemon's default. Returns NULL if the daemon
+ * could not be reached or refused the session. The filters start as type 0 at 1kHz,
+ * Q 0.707, 0dB.
+ */
+SSPO_API sspo_client* sspo_client_connect (const char* socket_path, int num_channels, int sample_rate,
+	int max_block_size, int num_slots);
+
+/* ends the session, any blocks still in flight are discarded */
+SSPO_API void sspo_client_disconnect (sspo_client* client);
+
+/* applied by the daemon before the next block it filters, the same ranges as sspo_filter_set_params */
+SSPO_API sspo_result sspo_client_set_params (sspo_client* client, int type_index, float frequency, float q, float gain_db);
+
+/*
+ * The num_channels planar buffers, of max_block_size samples, of the next free slot, to
+ * write a block into. NULL when every slot is in flight, sspo_client_wait for one first.
+ */
+SSPO_API float* const* sspo_client_acquire (sspo_client* client);
+
+/* hands the acquired slot's first num_samples samples to the daemon, SSPO_ERROR_DISCONNECTED once it has gone */
+SSPO_API sspo_result sspo_client_submit (sspo_client* client, int num_samples);
+
+/*
+ * Waits for the oldest block in flight to be filtered, and returns its buffers, filtered
+ * in place, and its length. They are the client's until sspo_client_release. NULL if
+ * nothing is in flight or the daemon has gone, and from then on the session stays
+ * disconnected.
+ */
+SSPO_API float* const* sspo_client_wait (sspo_client* client, int* num_samples);
+
+/* returns the slot sspo_client_wait gave out, for reuse */
+SSPO_API void sspo_client_release (sspo_client* client);
+
+/*
+ * filters num_samples of each of num_channels planar buffers in place, through one slot,
+ * SSPO_ERROR_DISCONNECTED once the daemon has gone
+ */
+SSPO_API sspo_result sspo_client_process (sspo_client* client, float* const* channels, int num_channels, int num_samples);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SSPO_FILTER_CLIENT_H */
@@ -0,0 +1,302 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+// sspo_filterd, serves MultiFilter instances to processes on the same machine, so several
+// renderers can share the filtering without each loading the plugin. Each client session
+// gets its own filters, one per channel, and a thread that filters the blocks the client
+// places in shared memory, see SharedSession.h. Use it through sspo_filter_client.h.
+//
+// usage: sspo_filterd [--socket <path>]
+//   --socket <path>  where to listen, $XDG_RUNTIME_DIR/sspo_filterd.sock by default
+
+#include "SharedSession.h"
+#include "sspo_filter.h"
+#include "dsp/Filter.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+namespace
+{
+	volatile std::sig_atomic_t g_stop = 0;
+
+	void onSignal (int)
+	{
+		g_stop = 1;
+	}
+
+	///
+	/// \brief The Session class
+	/// One connected client, its mapping and its filters. run() owns the session from
+	/// accept to disconnect, it filters on a second thread and waits on the socket for the
+	/// client to go away. The geometry is the session's own copy of the validated request,
+	/// the client can write the Header so it is never read back from there.
+	class Session
+	{
+	public:
+		Session (int socket, int memfd, void* mapping, size_t size, const sharedSession::ConnectRequest& request)
+			: m_socket (socket), m_memfd (memfd), m_mapping (mapping), m_size (size),
+			m_header (static_cast<sharedSession::Header*> (mapping)),
+			m_geometry (sharedSession::geometry (request))
+		{
+			for (auto c = 0; c < m_geometry.numChannels; ++c)
+			{
+				m_filters.push_back (std::make_unique<MultiFilter> ());
+				m_filters.back ()->setSampleRate (request.sampleRate);
+			}
+		}
+
+		~Session ()
+		{
+			munmap (m_mapping, m_size);
+			close (m_memfd);
+			close (m_socket);
+		}
+
+		void run ()
+		{
+			std::thread worker ([this] { filter (); });
+
+			// nothing more is sent on the socket, it only tells us when the client has gone
+			char byte;
+			while (recv (m_socket, &byte, 1, 0) > 0) {}
+
+			m_header->shutdown.store (1);
+			sharedSession::futexWake (m_header->submitted);
+			worker.join ();
+		}
+
+	private:
+		void filter ()
+		{
+			// the same as the audio thread in a host, failing that it runs at normal priority
+			sched_param param{};
+			param.sched_priority = sched_get_priority_min (SCHED_FIFO);
+			pthread_setschedparam (pthread_self (), SCHED_FIFO, &param);
+
+			auto& h = *m_header;
+			auto done = h.completed.load ();
+			while (true)
+			{
+				const auto stillThere = [&h] { return h.shutdown.load () == 0; };
+				if (!sharedSession::waitWhile (h.submitted, done, h.daemonWaiting, stillThere)) return;
+
+				applyParameters ();
+
+				auto* s = sharedSession::slot (m_mapping, m_geometry, done);
+				const auto numSamples = std::min (std::max (s->numSamples, 0), m_geometry.maxBlockSize);
+				for (auto c = 0; c < m_geometry.numChannels; ++c)
+					m_filters[c]->processBlock (sharedSession::channel (s, m_geometry, c), numSamples);
+
+				sharedSession::publish (h.completed, ++done, h.clientWaiting);
+			}
+		}
+
+		/// the client's latest parameters, if they have changed and are not being written
+		void applyParameters ()
+		{
+			auto& h = *m_header;
+			const auto sequence = h.paramsSequence.load (std::memory_order_acquire);
+			if (sequence == m_appliedSequence || (sequence & 1) != 0) return;
+
+			const auto type = h.type.load (std::memory_order_relaxed);
+			const auto frequency = h.frequency.load (std::memory_order_relaxed);
+			const auto q = h.q.load (std::memory_order_relaxed);
+			const auto gain = h.gain.load (std::memory_order_relaxed);
+			std::atomic_thread_fence (std::memory_order_acquire);
+			if (h.paramsSequence.load (std::memory_order_relaxed) != sequence) return;
+
+			m_appliedSequence = sequence;
+			if (type < 0 || type >= static_cast<int> (MultiFilter::typeStings ().size ())) return;
+			for (auto& f : m_filters) f->setTypeIndex (type, frequency, q, gain);
+		}
+
+		int m_socket, m_memfd;
+		void* m_mapping;
+		size_t m_size;
+		sharedSession::Header* m_header;
+		const sharedSession::Geometry m_geometry;
+		std::vector<std::unique_ptr<MultiFilter>> m_filters;
+		uint32_t m_appliedSequence{ 0 };
+	};
+
+	bool sendReply (int socket, const sharedSession::ConnectReply& reply, int fd)
+	{
+		iovec data{ const_cast<sharedSession::ConnectReply*> (&reply), sizeof (reply) };
+		msghdr message{};
+		message.msg_iov = &data;
+		message.msg_iovlen = 1;
+
+		alignas (cmsghdr) char control[CMSG_SPACE (sizeof (int))];
+		if (fd >= 0)
+		{
+			message.msg_control = control;
+			message.msg_controllen = sizeof (control);
+			auto* header = CMSG_FIRSTHDR (&message);
+			header->cmsg_level = SOL_SOCKET;
+			header->cmsg_type = SCM_RIGHTS;
+			header->cmsg_len = CMSG_LEN (sizeof (int));
+			std::memcpy (CMSG_DATA (header), &fd, sizeof (int));
+		}
+		return sendmsg (socket, &message, MSG_NOSIGNAL) == static_cast<ssize_t> (sizeof (reply));
+	}
+
+	/// how long a client has after connecting to send its request
+	constexpr int k_requestTimeoutSeconds = 2;
+
+	/// reads the request, creates the mapping, replies and runs the session, on the session's
+	/// own thread so a client that connects and sends nothing holds up no one else
+	void runSession (int socket)
+	{
+		timeval timeout{ k_requestTimeoutSeconds, 0 };
+		setsockopt (socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout));
+
+		sharedSession::ConnectRequest request{};
+		if (recv (socket, &request, sizeof (request), MSG_WAITALL) != static_cast<ssize_t> (sizeof (request))
+			|| !sharedSession::isValid (request))
+		{
+			sendReply (socket, { SSPO_ERROR_INVALID_ARGUMENT, 0 }, -1);
+			close (socket);
+			return;
+		}
+
+		// from here the socket only waits for the client to go away
+		timeout = {};
+		setsockopt (socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout));
+
+		const auto size = sharedSession::mappingSize (sharedSession::geometry (request));
+		const auto memfd = memfd_create ("sspo_filterd", MFD_CLOEXEC);
+		void* mapping = MAP_FAILED;
+		if (memfd >= 0 && ftruncate (memfd, static_cast<off_t> (size)) == 0)
+			mapping = mmap (nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+		if (mapping == MAP_FAILED)
+		{
+			sendReply (socket, { SSPO_ERROR_OUT_OF_MEMORY, 0 }, -1);
+			if (memfd >= 0) close (memfd);
+			close (socket);
+			return;
+		}
+
+		// the memfd starts zeroed, which is every counter at 0 and no parameters yet
+		auto* header = new (mapping) sharedSession::Header ();
+		header->magic = sharedSession::k_magic;
+		header->version = sharedSession::k_version;
+		header->numChannels = request.numChannels;
+		header->sampleRate = request.sampleRate;
+		header->maxBlockSize = request.maxBlockSize;
+		header->numSlots = request.numSlots;
+
+		std::unique_ptr<Session> session;
+		try
+		{
+			session = std::make_unique<Session> (socket, memfd, mapping, size, request);
+		}
+		catch (const std::bad_alloc&)
+		{
+			sendReply (socket, { SSPO_ERROR_OUT_OF_MEMORY, 0 }, -1);
+			munmap (mapping, size);
+			close (memfd);
+			close (socket);
+			return;
+		}
+
+		if (!sendReply (socket, { SSPO_OK, static_cast<uint32_t> (size) }, memfd)) return;
+		session->run ();
+	}
+
+	void startSession (int socket)
+	{
+		try
+		{
+			std::thread (runSession, socket).detach ();
+		}
+		catch (const std::system_error&)
+		{
+			close (socket);
+		}
+	}
+}
+
+int main (int argc, char* argv[])
+{
+	auto path = sharedSession::defaultSocketPath ();
+	for (auto i = 1; i < argc; ++i)
+		if (std::strcmp (argv[i], "--socket") == 0 && i + 1 < argc) path = argv[++i];
+
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if (path.size () >= sizeof (address.sun_path))
+	{
+		std::fprintf (stderr, "socket path too long: %s\n", path.c_str ());
+		return 1;
+	}
+	std::strcpy (address.sun_path, path.c_str ());
+
+	// the socket is created 0600, only this user's processes can connect
+	const auto listener = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	unlink (path.c_str ());
+	const auto previousMask = umask (0077);
+	const auto bound = listener >= 0 && bind (listener, reinterpret_cast<sockaddr*> (&address), sizeof (address)) == 0;
+	umask (previousMask);
+	if (!bound || chmod (path.c_str (), 0600) != 0 || listen (listener, 16) != 0)
+	{
+		std::fprintf (stderr, "could not listen on %s: %s\n", path.c_str (), std::strerror (errno));
+		return 1;
+	}
+
+	struct sigaction action{};
+	action.sa_handler = onSignal;
+	sigaction (SIGINT, &action, nullptr);
+	sigaction (SIGTERM, &action, nullptr);
+	signal (SIGPIPE, SIG_IGN);
+
+	std::printf ("sspo_filterd listening on %s\n", path.c_str ());
+	std::fflush (stdout);
+
+	while (g_stop == 0)
+	{
+		pollfd pending{ listener, POLLIN, 0 };
+		if (poll (&pending, 1, 200) <= 0) continue;
+		const auto client = accept4 (listener, nullptr, nullptr, SOCK_CLOEXEC);
+		if (client >= 0) startSession (client);
+	}
+
+	close (listener);
+	unlink (path.c_str ());
+	return 0;
+}
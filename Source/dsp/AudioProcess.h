@@ -21,6 +21,25 @@
 
 #pragma once
 
+#include <algorithm>
+
+///
+/// \brief The BasicAudioSpan struct
+/// Planar audio, numChannels pointers to numSamples samples each. AudioSpan is written to,
+/// ConstAudioSpan only read, neither owns its samples.
+template <typename SampleType>
+struct BasicAudioSpan
+{
+	SampleType* const* channels{ nullptr };
+	int numChannels{ 0 };
+	int numSamples{ 0 };
+
+	SampleType* channel (int index) const noexcept { return channels[index]; }
+};
+
+using AudioSpan = BasicAudioSpan<float>;
+using ConstAudioSpan = BasicAudioSpan<const float>;
+
  /**
  The base AudioProcess class to be inherited by all audio processing classes.
  AudioProcess classes are designed to process a single channel of audio,
@@ -64,7 +83,35 @@ public:
 		}
 	}
 
+	///
+	/// \brief process
+	/// Out of place, reads in and writes out, which may be the same block but must not
+	/// otherwise overlap, in is left as it was. This default copies in to out and runs
+	/// processBlock there, classes able to read one block while writing another override it.
+	virtual void process (const float* in, float* out, int blockSize)
+	{
+		if (in == nullptr || out == nullptr) return;
+		if (in != out) std::copy (in, in + blockSize, out);
+		processBlock (out, blockSize);
+	}
+
 
 protected:
 	int m_sampleRate{ 0 };
-};
\ No newline at end of file
+};
+
+///
+/// \brief processChannels
+/// Each channel of in through its own process, processes[c] for channel c, writing the
+/// same channel of out. As every process keeps the state of one channel, a multi channel
+/// process is a container of them, std::vector<std::unique_ptr<MultiFilter>> for example.
+/// The channels of in and out may be the same blocks, when they differ in is kept, so
+/// parallel bands can each read the one input and a dry/wet mix can read the dry signal
+/// back from in, with no scratch copies.
+template <typename Processes>
+void processChannels (Processes& processes, const ConstAudioSpan& in, const AudioSpan& out)
+{
+	const auto numChannels = std::min ({ in.numChannels, out.numChannels, static_cast<int>(processes.size ()) });
+	const auto numSamples = std::min (in.numSamples, out.numSamples);
+	for (auto c = 0; c < numChannels; ++c) processes[c]->process (in.channel (c), out.channel (c), numSamples);
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/** SSPO_CACHE_LINE
+    The alignment DspArena gives everything it holds, and the gap kept between state the
+    audio thread writes and state other threads write, so neither invalidates the other's
+    cache line. 64 bytes on x86 and most ARM cores, set 128 for Apple silicon.
+*/
+#ifndef SSPO_CACHE_LINE
+ #define SSPO_CACHE_LINE 64
+#endif
+
+///
+/// \brief The DspArena class
+/// One cache line aligned block holding the DSP state of a processor, the objects and
+/// arrays made in it lie one after another, each starting on a fresh cache line, rather
+/// than wherever the heap put them. reserve () allocates the block, sized beforehand from
+/// footprint (), create () and allocateArray () then only advance through it, and
+/// release () destroys the objects, last made first, and frees it. None of it is for the
+/// audio thread, which only uses what was made.
+/// Two things the objects hold stay on the heap. Each BiQuad's and Ladder's farbot
+/// NonRealtimeMutatable keeps its coefficients in a block it replaces with a fresh copy
+/// on every non realtime write, so the block can't live in an arena. With
+/// setDesignOnRealtimeThread(), as at control rate and in ParametricEq's designers, the
+/// audio thread never reads it. A FilterChain given stages by unique_ptr keeps them where
+/// they were made, the chains the filters build hold their stages as members.
+class DspArena
+{
+public:
+	static constexpr size_t k_alignment = SSPO_CACHE_LINE;
+
+	DspArena () = default;
+	DspArena (const DspArena&) = delete;
+	DspArena& operator= (const DspArena&) = delete;
+	~DspArena () { release (); }
+
+	static constexpr size_t roundUp (size_t bytes) noexcept
+	{
+		return (bytes + k_alignment - 1) / k_alignment * k_alignment;
+	}
+
+	/// the bytes count Ts take up in the arena
+	template <typename T>
+	static constexpr size_t footprint (size_t count = 1) noexcept
+	{
+		return roundUp (sizeof (T) * count);
+	}
+
+	///
+	/// \brief reserve
+	/// Releases everything held and allocates a block of at least bytes
+	void reserve (size_t bytes)
+	{
+		release ();
+		m_capacity = roundUp (bytes);
+		if (m_capacity == 0) return;
+		m_block = static_cast<unsigned char*> (::operator new (m_capacity, std::align_val_t{ k_alignment }));
+	}
+
+	///
+	/// \brief create
+	/// Constructs a T on the next cache line, nullptr when it does not fit
+	template <typename T, typename... Args>
+	T* create (Args&&... args)
+	{
+		static_assert (alignof (T) <= k_alignment, "DspArena only aligns to SSPO_CACHE_LINE");
+		auto* memory = take (sizeof (T));
+		if (memory == nullptr) return nullptr;
+
+		auto* object = new (memory) T (std::forward<Args> (args)...);
+		if (!std::is_trivially_destructible<T>::value)
+			m_destructors.push_back ({ object, [] (void* o) { static_cast<T*> (o)->~T (); } });
+		return object;
+	}
+
+	///
+	/// \brief allocateArray
+	/// count zeroed Ts from the next cache line, for plain sample and state arrays,
+	/// nullptr when they do not fit
+	template <typename T>
+	T* allocateArray (size_t count) noexcept
+	{
+		static_assert (std::is_trivial<T>::value, "arrays are zeroed, not constructed");
+		static_assert (alignof (T) <= k_alignment, "DspArena only aligns to SSPO_CACHE_LINE");
+		auto* memory = take (sizeof (T) * count);
+		if (memory != nullptr) std::memset (memory, 0, sizeof (T) * count);
+		return static_cast<T*> (memory);
+	}
+
+	/// destroys every object, the last made first, and frees the block
+	void release () noexcept
+	{
+		for (auto d = m_destructors.rbegin (); d != m_destructors.rend (); ++d) d->destroy (d->object);
+		m_destructors.clear ();
+		if (m_block != nullptr) ::operator delete (m_block, std::align_val_t{ k_alignment });
+		m_block = nullptr;
+		m_capacity = m_used = 0;
+	}
+
+	size_t getCapacity () const noexcept { return m_capacity; }
+	size_t getUsed () const noexcept { return m_used; }
+
+private:
+	void* take (size_t bytes) noexcept
+	{
+		const auto size = roundUp (bytes);
+		if (m_block == nullptr || size > m_capacity - m_used) return nullptr;
+		auto* memory = m_block + m_used;
+		m_used += size;
+		return memory;
+	}
+
+	struct Destructor
+	{
+		void* object;
+		void (*destroy) (void*);
+	};
+
+	unsigned char* m_block{ nullptr };
+	size_t m_capacity{ 0 };
+	size_t m_used{ 0 };
+	std::vector<Destructor> m_destructors;
+};
@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <string>
+
+#include "AudioMath.h"
+#include "EnvelopeFollower.h"
+#include "Filter.h"
+
+///
+/// \brief The DynamicEq class
+/// A peak or shelf band whose gain follows the level of a detector signal, its own input
+/// or a sidechain, for de-essing and taming resonances. Above the threshold the gain moves
+/// by (level - threshold) * (1 - 1 / ratio) dB, up to range dB, negative ranges cut.
+///
+/// The level is followed a control interval at a time by EnvelopeFollower, and the band is
+/// redesigned at most once per interval. That redesign is cheap, the tanf and cosf terms
+/// only depend on the frequency and Q and are kept from the last change of those, leaving
+/// a dB to gain table lookup and a division for the gain, through the same design() as
+/// PeakFilter, LowShelf and HighShelf.
+///
+/// The parameter setters may be called from any thread, the rest belongs to the audio thread.
+class DynamicEq : public BiQuad
+{
+public:
+	enum Shape
+	{
+		peak = 0,
+		lowShelf,
+		highShelf
+	};
+
+	DynamicEq ()
+	{
+		// every design after prepare() happens in process()
+		setDesignOnRealtimeThread (true);
+	}
+
+	///
+	/// \brief shapeForType
+	/// The shape matching a MultiFilter type name, -1 for types with no gain
+	static int shapeForType (const std::string& typeName)
+	{
+		if (typeName == "Peak") return peak;
+		if (typeName == "Low Shelf") return lowShelf;
+		if (typeName == "High Shelf") return highShelf;
+		return -1;
+	}
+
+	/// not to be called while processing
+	void prepare (int sampleRate, int controlInterval)
+	{
+		m_sampleRate = sampleRate > 0 ? sampleRate : 44100;
+		m_controlInterval = controlInterval > 0 ? controlInterval : 32;
+		m_follower.prepare (m_sampleRate, m_controlInterval);
+		decibelsToGain (0.0f);	// builds the table
+		m_designedShape = -1;
+		clear ();
+	}
+
+	void clear () noexcept
+	{
+		BiQuad::clear ();
+		m_follower.clear ();
+	}
+
+	void setShape (Shape shape) noexcept { m_shape.store (shape); }
+
+	void setParameters (float freq, float Q, float gainDb) noexcept
+	{
+		m_freq.store (bound (20.0f, freq, 20000.0f));
+		m_Q.store (bound (0.1f, Q, 20.0f));
+		m_gain.store (gainDb);
+	}
+
+	void setDynamics (float thresholdDb, float ratio, float rangeDb, float attackMs, float releaseMs) noexcept
+	{
+		m_threshold.store (thresholdDb);
+		m_ratio.store (std::max (1.0f, ratio));
+		m_range.store (rangeDb);
+		m_attack.store (attackMs);
+		m_release.store (releaseMs);
+	}
+
+	/// the gain, in dB, the band was last designed for
+	float getCurrentGain () const noexcept { return m_currentGain.load (std::memory_order_relaxed); }
+
+	///
+	/// \brief process
+	/// Filters numSamples of block in place, following the level of detector,
+	/// which may be block itself
+	void process (float* block, const float* detector, int numSamples) noexcept
+	{
+		if (block == nullptr) return;
+		if (detector == nullptr) detector = block;
+
+		updateShape ();
+		m_follower.setAttackRelease (m_attack.load (), m_release.load ());
+		const auto staticGain = m_gain.load ();
+		const auto threshold = m_threshold.load ();
+		const auto slope = 1.0f - 1.0f / m_ratio.load ();
+		const auto range = m_range.load ();
+
+		for (auto start = 0; start < numSamples; start += m_controlInterval)
+		{
+			const auto n = std::min (m_controlInterval, numSamples - start);
+
+			// the detector is read before filtering, it may be the same samples
+			const auto level = m_follower.process (detector + start, n);
+			const auto over = 20.0f * log10f (level + 1.0e-9f) - threshold;
+			const auto change = over > 0.0f ? std::min (over * slope, fabsf (range)) : 0.0f;
+			const auto gain = staticGain + (range < 0.0f ? -change : change);
+
+			if (fabsf (gain - m_designedGain) > k_gainTolerance) designGain (gain);
+			tickBlock (block + start, n);
+		}
+	}
+
+private:
+	/// gain changes smaller than this, in dB, don't redesign the band
+	static constexpr float k_gainTolerance = 0.05f;
+
+	/// picks up shape, frequency and Q changes, the only part calling tanf
+	void updateShape () noexcept
+	{
+		const auto shape = m_shape.load ();
+		const auto freq = m_freq.load ();
+		const auto Q = m_Q.load ();
+		if (shape == m_designedShape && freq == m_designedFreq && Q == m_designedQ) return;
+
+		const auto theta = k_2pi * freq / m_sampleRate;
+		m_cosTheta = cosf (theta);
+		m_tan = shape == peak ? tanf (theta / (2.0f * std::max (1.0f, Q))) : tanf (theta * 0.5f);
+		m_designedShape = shape;
+		m_designedFreq = freq;
+		m_designedQ = Q;
+		designGain (m_designedGain);
+	}
+
+	/// the rest of PeakFilter, LowShelf or HighShelf calcCoefficents, through their design
+	void designGain (float gainDb) noexcept
+	{
+		const auto mu = decibelsToGain (gainDb);
+		switch (m_designedShape)
+		{
+		case peak: setCoeffs (PeakFilter::design (mu, m_tan, m_cosTheta)); break;
+		case lowShelf: setCoeffs (LowShelf::design (mu, m_tan)); break;
+		default: setCoeffs (HighShelf::design (mu, m_tan)); break;
+		}
+		m_designedGain = gainDb;
+		m_currentGain.store (gainDb, std::memory_order_relaxed);
+	}
+
+	///
+	/// \brief decibelsToGain
+	/// powf (10, dB / 20) from a table at half dB steps, linearly interpolated, the error
+	/// is below 0.005 dB
+	static float decibelsToGain (float dB) noexcept
+	{
+		constexpr auto minDb = -72.0f;
+		constexpr auto stepsPerDb = 2;
+		constexpr auto size = 144 * stepsPerDb + 1;
+		static const auto table = []
+		{
+			std::array<float, size> t;
+			for (auto i = 0; i < size; ++i) t[i] = powf (10.0f, (minDb + i / static_cast<float> (stepsPerDb)) / 20.0f);
+			return t;
+		}();
+
+		const auto position = (bound (minDb, dB, -minDb) - minDb) * stepsPerDb;
+		const auto index = std::min (static_cast<int> (position), size - 2);
+		const auto t = position - index;
+		return table[index] + t * (table[index + 1] - table[index]);
+	}
+
+	// set from any thread, on a cache line apart from the audio thread's fields below
+	alignas (SSPO_CACHE_LINE) std::atomic<int> m_shape{ peak };
+	std::atomic<float> m_freq{ 1000.0f };
+	std::atomic<float> m_Q{ 0.707f };
+	std::atomic<float> m_gain{ 0.0f };
+	std::atomic<float> m_threshold{ -24.0f };
+	std::atomic<float> m_ratio{ 4.0f };
+	std::atomic<float> m_range{ -12.0f };
+	std::atomic<float> m_attack{ 5.0f };
+	std::atomic<float> m_release{ 100.0f };
+
+	// the audio thread's, the settings only change in prepare
+	alignas (SSPO_CACHE_LINE) int m_sampleRate{ 44100 };
+	int m_controlInterval{ 32 };
+	EnvelopeFollower m_follower;
+	std::atomic<float> m_currentGain{ 0.0f };
+
+	// what the band is designed for, audio thread only
+	int m_designedShape{ -1 };
+	float m_designedFreq{ 0.0f };
+	float m_designedQ{ 0.0f };
+	float m_designedGain{ 0.0f };
+	float m_cosTheta{ 1.0f };
+	float m_tan{ 0.0f };
+};
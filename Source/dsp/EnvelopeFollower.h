@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#pragma once
+
+#include <cmath>
+
+///
+/// \brief The EnvelopeFollower class
+/// An RMS level follower run a chunk at a time rather than per sample. The mean square
+/// of each chunk is a plain sum the compiler vectorises, the attack / release smoothing
+/// is then one step per chunk, with its coefficient raised to the chunk length.
+class EnvelopeFollower
+{
+public:
+	void prepare (int sampleRate, int chunkSize) noexcept
+	{
+		m_sampleRate = sampleRate > 0 ? sampleRate : 44100;
+		m_chunkSize = chunkSize > 0 ? chunkSize : 1;
+		updateCoefficients ();
+		clear ();
+	}
+
+	void setAttackRelease (float attackMs, float releaseMs) noexcept
+	{
+		if (attackMs == m_attackMs && releaseMs == m_releaseMs) return;
+		m_attackMs = attackMs;
+		m_releaseMs = releaseMs;
+		updateCoefficients ();
+	}
+
+	void clear () noexcept { m_meanSquare = 0.0f; }
+
+	///
+	/// \brief process
+	/// Follows a chunk of numSamples, normally the chunk size given to prepare,
+	/// returning the RMS level
+	float process (const float* in, int numSamples) noexcept
+	{
+		if (numSamples <= 0) return getLevel ();
+
+		float sum = 0.0f;
+		for (auto i = 0; i < numSamples; ++i) sum += in[i] * in[i];
+		const auto meanSquare = sum / numSamples;
+
+		auto attack = m_attackCoeff;
+		auto release = m_releaseCoeff;
+		if (numSamples != m_chunkSize)
+		{
+			attack = coefficient (m_attackMs, numSamples);
+			release = coefficient (m_releaseMs, numSamples);
+		}
+		const auto coeff = meanSquare > m_meanSquare ? attack : release;
+		m_meanSquare = meanSquare + coeff * (m_meanSquare - meanSquare);
+		return getLevel ();
+	}
+
+	float getLevel () const noexcept { return sqrtf (m_meanSquare); }
+
+private:
+	/// the one pole coefficient for a time constant of ms, over numSamples samples
+	float coefficient (float ms, int numSamples) const noexcept
+	{
+		return ms > 0.0f ? expf (-numSamples / (ms * 0.001f * m_sampleRate)) : 0.0f;
+	}
+
+	void updateCoefficients () noexcept
+	{
+		m_attackCoeff = coefficient (m_attackMs, m_chunkSize);
+		m_releaseCoeff = coefficient (m_releaseMs, m_chunkSize);
+	}
+
+	int m_sampleRate{ 44100 };
+	int m_chunkSize{ 32 };
+	float m_attackMs{ 5.0f };
+	float m_releaseMs{ 100.0f };
+	float m_attackCoeff{ 0.0f };
+	float m_releaseCoeff{ 0.0f };
+	float m_meanSquare{ 0.0f };
+};
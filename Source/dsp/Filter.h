@@ -21,15 +21,26 @@
 
 #pragma once
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <cmath>
+#include <complex>
+#include <cstring>
 #include <float.h>
+#include <limits>
 #include <math.h>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include "AudioMath.h"
 #include "AudioProcess.h"
-#include "..\farbot\NonRealtimeMutatable.hpp"
+#include "DspArena.h"
+#include "FastTanh.h"
+#include "Oversampling.h"
+#include "StateSpaceKernel.h"
+#include "../farbot/NonRealtimeMutatable.hpp"
 
 
 
@@ -72,6 +83,18 @@ protected:
 };
 
 
+/** SSPO_STATE_SPACE_STEP
+    The number of samples BiQuad::tickBlock computes per step with StateSpaceKernel, 4 fills
+    an SSE register and 8 an AVX one. 0 runs tick() sample by sample instead.
+*/
+#ifndef SSPO_STATE_SPACE_STEP
+ #if defined(__AVX__)
+  #define SSPO_STATE_SPACE_STEP 8
+ #else
+  #define SSPO_STATE_SPACE_STEP 4
+ #endif
+#endif
+
 ///
 /// \brief The BiQuad class
 /// Transposed Canonical Form  BiQuad implementation. base class for various filters
@@ -79,6 +102,15 @@ protected:
 class BiQuad
 {
 public:
+	///
+	/// \brief The BiquadCoeffecients struct
+	/// H(z) = c0 * (a0 + a1 z^-1 + a2 z^-2) / (1 + b1 z^-1 + b2 z^-2) + d0
+	struct BiquadCoeffecients
+	{
+		float m_a0, m_a1, m_a2, m_b1, m_b2;
+		float m_c0, m_d0;
+	};
+
 	BiQuad ()
 	{
 		clear ();
@@ -88,39 +120,176 @@ public:
 	inline void setCoeffs (float a0, float a1, float a2, float b1, float b2, float c0, float d0)
 	{
 		BiquadCoeffecients newCoeffs{ a0,  a1,  a2,  b1,  b2,  c0,  d0 };
+		if (m_designOnRealtimeThread)
+		{
+			m_state.designed = newCoeffs;
+			return;
+		}
 		farbot::NonRealtimeMutatable<BiquadCoeffecients>::ScopedAccess<false> coeffs (m_biquadCoeffs);
 		*coeffs = newCoeffs;
 	}
 
+	inline void setCoeffs (const BiquadCoeffecients& c)
+	{
+		setCoeffs (c.m_a0, c.m_a1, c.m_a2, c.m_b1, c.m_b2, c.m_c0, c.m_d0);
+	}
+
+	///
+	/// \brief setDesignOnRealtimeThread
+	/// When set the coefficients belong to the thread calling tick(), setCoeffs() and
+	/// getCoeffs() must only be called from it, and they are kept as a plain member there
+	/// rather than shared through the non realtime path. Not to be changed while processing,
+	/// the current coefficients carry over either way.
+	void setDesignOnRealtimeThread (bool shouldDesignOnRealtimeThread)
+	{
+		if (shouldDesignOnRealtimeThread == m_designOnRealtimeThread) return;
+		farbot::NonRealtimeMutatable<BiquadCoeffecients>::ScopedAccess<false> coeffs (m_biquadCoeffs);
+		if (shouldDesignOnRealtimeThread) m_state.designed = *coeffs;
+		else *coeffs = m_state.designed;
+		m_designOnRealtimeThread = shouldDesignOnRealtimeThread;
+	}
+
+	/// A copy of the current coefficients, not for use on the realtime thread, unless it
+	/// designs them, see setDesignOnRealtimeThread(), when only for use there
+	BiquadCoeffecients getCoeffs ()
+	{
+		if (m_designOnRealtimeThread) return m_state.designed;
+		farbot::NonRealtimeMutatable<BiquadCoeffecients>::ScopedAccess<false> coeffs (m_biquadCoeffs);
+		return *coeffs;
+	}
+
+	///
+	/// \brief tailLengthSamples
+	/// How long the impulse response of a section takes to decay by decayDb, from the
+	/// radius r of its slowest pole, the root of 1 + b1 z^-1 + b2 z^-2 furthest from the
+	/// origin. The recursion rings as (p1^(n+1) - p2^(n+1)) / (p1 - p2), no more than
+	/// r^n min (n + 1, 2r / |p1 - p2|), scaled by the numerator, and the two samples of the
+	/// numerator are added so a section without feedback still has a tail. Infinite for a
+	/// pole on or outside the unit circle.
+	static double tailLengthSamples (const BiquadCoeffecients& c, double decayDb = 120.0) noexcept
+	{
+		const double b1 = c.m_b1, b2 = c.m_b2;
+		const auto disc = b1 * b1 - 4.0 * b2;
+		const auto spread = std::sqrt (std::fabs (disc));
+		const auto radius = disc < 0.0 ? std::sqrt (b2) : (std::fabs (b1) + spread) * 0.5;
+
+		if (radius >= 1.0) return std::numeric_limits<double>::infinity ();
+		if (radius <= 0.0 || c.m_c0 == 0.0f) return 2.0;
+
+		const auto gain = std::max (1.0, std::fabs ((double) c.m_c0) * (std::fabs ((double) c.m_a0) + std::fabs ((double) c.m_a1) + std::fabs ((double) c.m_a2)));
+		const auto floor = std::log (std::pow (10.0, -decayDb / 20.0) / gain);
+		const auto logRadius = std::log (radius);
+		const auto growth = std::min (floor / logRadius + 1.0, spread > 0.0 ? 2.0 * radius / spread : HUGE_VAL);
+		return std::max (0.0, (floor - std::log (std::max (1.0, growth))) / logRadius) + 2.0;
+	}
+
 	inline void clear () noexcept
 	{
-		m_z1 = 0.0f;
-		m_z2 = 0.0f;
+		m_state.z1 = 0.0f;
+		m_state.z2 = 0.0f;
+	}
+
+	/// the two state variables, so processing can be carried on elsewhere and handed back
+	void getState (float& z1, float& z2) const noexcept
+	{
+		z1 = m_state.z1;
+		z2 = m_state.z2;
+	}
+
+	void setState (float z1, float z2) noexcept
+	{
+		m_state.z1 = z1;
+		m_state.z2 = z2;
 	}
 
 	inline float tick (float in)
 	{
+		if (m_designOnRealtimeThread) return step (in, m_state.designed);
 		farbot::NonRealtimeMutatable<BiquadCoeffecients>::ScopedAccess<true> coeffs (m_biquadCoeffs);
+		return step (in, *coeffs);
+	}
 
-		float out = m_z1 + coeffs->m_a0 * in;
-		//check denormal
-		if (!isnormal (out)) out = 0.0f;
-		m_z1 = coeffs->m_a1 * in + m_z2 - coeffs->m_b1 * out;
-		m_z2 = coeffs->m_a2 * in - coeffs->m_b2 * out;
-		return out * coeffs->m_c0 + in * coeffs->m_d0;
+	///
+	/// \brief tickBlock
+	/// tick() over a block in place, SSPO_STATE_SPACE_STEP samples at a time through the
+	/// state space kernel, which is only redesigned when the coefficients have changed
+	inline void tickBlock (float* block, int blockSize)
+	{
+		tickBlock (block, block, blockSize);
+	}
+
+	///
+	/// \brief tickBlock
+	/// As tickBlock, reading in and writing out, which may be the same block
+	inline void tickBlock (const float* in, float* out, int blockSize)
+	{
+#if SSPO_STATE_SPACE_STEP > 0
+		if (m_designOnRealtimeThread) useCoefficients (m_state.designed);
+		else
+		{
+			farbot::NonRealtimeMutatable<BiquadCoeffecients>::ScopedAccess<true> coeffs (m_biquadCoeffs);
+			useCoefficients (*coeffs);
+		}
+
+		auto& z = m_state;
+		const auto numSteps = blockSize / SSPO_STATE_SPACE_STEP;
+		m_kernel.process (in, out, numSteps, z.z1, z.z2);
+
+		for (auto i = numSteps * SSPO_STATE_SPACE_STEP; i < blockSize; ++i) out[i] = step (in[i], z.coeffs);
+#else
+		for (auto i = 0; i < blockSize; ++i) out[i] = tick (in[i]);
+#endif
 	}
 
 protected:
 
-	float m_z1, m_z2;
+	/// one sample through the transposed canonical form
+	inline float step (float in, const BiquadCoeffecients& c) noexcept
+	{
+		auto& z = m_state;
+		float out = z.z1 + c.m_a0 * in;
+		//check denormal
+		if (!isnormal (out)) out = 0.0f;
+		z.z1 = c.m_a1 * in + z.z2 - c.m_b1 * out;
+		z.z2 = c.m_a2 * in - c.m_b2 * out;
+		return out * c.m_c0 + in * c.m_d0;
+	}
 
-	struct BiquadCoeffecients
+#if SSPO_STATE_SPACE_STEP > 0
+	/// the coefficients the block runs with, the kernel only redesigned when they have changed
+	inline void useCoefficients (const BiquadCoeffecients& c) noexcept
 	{
-		float m_a0, m_a1, m_a2, m_b1, m_b2;
-		float m_c0, m_d0;
+		if (std::memcmp (&c, &m_state.coeffs, sizeof (BiquadCoeffecients)) == 0) return;
+		m_state.coeffs = c;
+		m_kernel.design (c.m_a0, c.m_a1, c.m_a2, c.m_b1, c.m_b2, c.m_c0, c.m_d0);
+	}
+#endif
+
+	///
+	/// \brief The State struct
+	/// The audio thread's, the state and the coefficients the block runs with together on
+	/// one cache line of their own, so that the design thread publishing coefficients, or
+	/// writing the parameters of the Filter alongside, does not take it away
+	struct alignas (SSPO_CACHE_LINE) State
+	{
+		float z1{ 0.0f }, z2{ 0.0f };
+
+		// what the kernel was last designed for, starts out impossible so the first block designs it
+		BiquadCoeffecients coeffs{ NAN, NAN, NAN, NAN, NAN, NAN, NAN };
+
+		// with setDesignOnRealtimeThread the coefficients themselves, written and read only here
+		BiquadCoeffecients designed{ 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
 	};
+	static_assert (sizeof (State) == SSPO_CACHE_LINE, "the state and its coefficients fit one cache line");
+	State m_state;
+
+#if SSPO_STATE_SPACE_STEP > 0
+	StateSpaceKernel<SSPO_STATE_SPACE_STEP> m_kernel;
+#endif
 
-	farbot::NonRealtimeMutatable<BiquadCoeffecients> m_biquadCoeffs;
+	// shared with the design thread, unless the audio thread designs them
+	alignas (SSPO_CACHE_LINE) farbot::NonRealtimeMutatable<BiquadCoeffecients> m_biquadCoeffs;
+	bool m_designOnRealtimeThread{ false };
 };
 
 
@@ -192,6 +361,65 @@ public:
 	virtual bool getUseQ () = 0;
 	virtual bool getUseGain () = 0;
 
+	///
+	/// \brief appendStages
+	/// Appends the coefficients of each second order section this filter runs,
+	/// in processing order, or for a nonlinear filter, see isLinear(), those of its small
+	/// signal response. Not for use on the realtime thread, or with setDesignOnRealtimeThread()
+	/// only for use on it, as the coefficients are then its own.
+	virtual void appendStages (std::vector<BiQuad::BiquadCoeffecients>&)
+	{
+	}
+
+	///
+	/// \brief copyStages
+	/// As appendStages(), writing at most maxStages into stages rather than allocating, so
+	/// with setDesignOnRealtimeThread() it may be used on the realtime thread. Returns how
+	/// many it wrote.
+	virtual int copyStages (BiQuad::BiquadCoeffecients*, int)
+	{
+		return 0;
+	}
+
+	///
+	/// \brief isLinear
+	/// false for a filter with a nonlinearity in it, whose appendStages() are only its
+	/// small signal response rather than the sections it runs
+	virtual bool isLinear ()
+	{
+		return true;
+	}
+
+	///
+	/// \brief getTailLengthSamples
+	/// The samples the output takes to decay by decayDb once the input stops, the tails of
+	/// the sections from appendStages() added up, as in series each carries on the ringing
+	/// of the one before. An upper bound, the slowest pole rings out from full scale. Not
+	/// for use on the realtime thread.
+	virtual double getTailLengthSamples (double decayDb = 120.0)
+	{
+		std::vector<BiQuad::BiquadCoeffecients> stages;
+		appendStages (stages);
+		auto samples = 0.0;
+		for (const auto& s : stages) samples += BiQuad::tailLengthSamples (s, decayDb);
+		return samples;
+	}
+
+	///
+	/// \brief appendBiQuads
+	/// Appends each second order section this filter currently runs, in processing order,
+	/// whose getCoeffs() follows setDesignOnRealtimeThread() as the filter's appendStages()
+	virtual void appendBiQuads (std::vector<BiQuad*>&)
+	{
+	}
+
+	///
+	/// \brief setDesignOnRealtimeThread
+	/// See BiQuad::setDesignOnRealtimeThread, not to be changed while processing
+	virtual void setDesignOnRealtimeThread (bool)
+	{
+	}
+
 protected:
 
 	float m_freq{ 440.0f };
@@ -200,18 +428,66 @@ protected:
 
 };
 
+///
+/// \brief The BiQuadFilter class
+/// The base of the filters that run a single BiQuad, which is their one stage, and
+/// which runs each block through BiQuad::tickBlock rather than sample by sample
+class BiQuadFilter : public Filter, public BiQuad
+{
+public:
+	BiQuadFilter () : Filter ()
+	{}
+
+	BiQuadFilter (int sampleRate)
+		: Filter (sampleRate)
+	{}
+
+	void appendStages (std::vector<BiQuad::BiquadCoeffecients>& stages) override
+	{
+		stages.push_back (getCoeffs ());
+	}
+
+	int copyStages (BiQuad::BiquadCoeffecients* stages, int maxStages) override
+	{
+		if (maxStages <= 0) return 0;
+		stages[0] = getCoeffs ();
+		return 1;
+	}
+
+	void processBlock (float* block, int blockSize) override
+	{
+		if (block != nullptr) tickBlock (block, blockSize);
+	}
+
+	/// Out of place, reads in while writing out
+	void process (const float* in, float* out, int blockSize) override
+	{
+		if (in != nullptr && out != nullptr) tickBlock (in, out, blockSize);
+	}
+
+	void appendBiQuads (std::vector<BiQuad*>& biquads) override
+	{
+		biquads.push_back (this);
+	}
+
+	void setDesignOnRealtimeThread (bool shouldDesignOnRealtimeThread) override
+	{
+		BiQuad::setDesignOnRealtimeThread (shouldDesignOnRealtimeThread);
+	}
+};
+
 ///
 /// \brief The Lp6 Filter class
 /// A 1 pole Low Pass Filter
 /// Coefficent calculations from Designing Audio Effects Plugins in c++ 2nd ed Will Pirkle
-class Lp6 : public Filter, public BiQuad
+class Lp6 : public BiQuadFilter
 {
 public:
-	Lp6 () : Filter ()
+	Lp6 () : BiQuadFilter ()
 	{}
 
 	Lp6 (int sampleRate)
-		: Filter (sampleRate)
+		: BiQuadFilter (sampleRate)
 	{}
 
 	float processSample (float in) override
@@ -256,14 +532,14 @@ public:
 /// \brief The Hp6 Filter class
 /// A 1 pole High Pass Filter
 /// Coefficent calculations from Designing Audio Effects Plugins in c++ 2nd ed Will Pirkle
-class Hp6 : public Filter, public BiQuad
+class Hp6 : public BiQuadFilter
 {
 public:
-	Hp6 () : Filter ()
+	Hp6 () : BiQuadFilter ()
 	{}
 
 	Hp6 (int sampleRate)
-		: Filter (sampleRate)
+		: BiQuadFilter (sampleRate)
 	{}
 
 	float processSample (float in) override
@@ -310,16 +586,16 @@ public:
 /// \brief The Hp12 Filter class
 /// A 2 pole High Pass Filter
 /// Coefficent calculations from Designing Audio Effects Plugins in c++ 2nd ed Will Pirkle
-class Hp12 : public Filter, public BiQuad
+class Hp12 : public BiQuadFilter
 {
 public:
 
-	Hp12 () : Filter ()
+	Hp12 () : BiQuadFilter ()
 	{}
 
 
 	Hp12 (int samplerate) :
-		Filter (samplerate)
+		BiQuadFilter (samplerate)
 	{
 	}
 
@@ -372,16 +648,16 @@ public:
 /// A 2 pole low pass filter
 /// Coefficent calculations from Designing Audio Effects Plugins in c++ 2nd ed Will Pirkle
 ///
-class Lp12 : public Filter, public BiQuad
+class Lp12 : public BiQuadFilter
 {
 public:
 	Lp12 () :
-		Filter ()
+		BiQuadFilter ()
 	{
 	}
 
 	Lp12 (int samplerate) :
-		Filter (samplerate)
+		BiQuadFilter (samplerate)
 	{
 	}
 
@@ -431,16 +707,16 @@ public:
 /// A 2 pole band pass filter
 /// Coefficent calculations from Designing Audio Effects Plugins in c++ 2nd ed Will Pirkle
 ///
-class Bp12 : public Filter, public BiQuad
+class Bp12 : public BiQuadFilter
 {
 public:
 	Bp12 () :
-		Filter ()
+		BiQuadFilter ()
 	{
 	}
 
 	Bp12 (int samplerate) :
-		Filter (samplerate)
+		BiQuadFilter (samplerate)
 	{
 	}
 
@@ -486,16 +762,16 @@ public:
 /// A 2 pole band stop filter
 /// Coefficent calculations from Designing Audio Effects Plugins in c++ 2nd ed Will Pirkle
 ///
-class Bs12 : public Filter, public BiQuad
+class Bs12 : public BiQuadFilter
 {
 public:
 	Bs12 () :
-		Filter ()
+		BiQuadFilter ()
 	{
 	}
 
 	Bs12 (int samplerate) :
-		Filter (samplerate)
+		BiQuadFilter (samplerate)
 	{
 	}
 
@@ -542,16 +818,16 @@ public:
 /// \brief The PeakFilter class
 /// A 2 pole Peak Pass Filter
 /// Coefficent calculations from Designing Audio Effects Plugins in c++ 2nd ed Will Pirkle
-class PeakFilter : public Filter, public BiQuad
+class PeakFilter : public BiQuadFilter
 {
 public:
 	PeakFilter () :
-		Filter ()
+		BiQuadFilter ()
 	{
 	}
 
 	PeakFilter (int samplerate) :
-		Filter (samplerate)
+		BiQuadFilter (samplerate)
 	{
 	}
 
@@ -571,9 +847,18 @@ public:
 		const float Q = fmax (1.0f, m_Q);
 		const float theta = k_2pi * m_freq / m_sampleRate;
 		const float mu = powf (10, m_gain / 20.0f);
+		setCoeffs (design (mu, tanf (theta / (2.0f * Q)), cosf (theta)));
+	}
+
+	///
+	/// \brief design
+	/// The coefficients for a linear gain mu, from tan (theta / 2Q) and cos (theta), theta
+	/// the centre in radians per sample, which DynamicEq keeps while only the gain moves
+	static BiquadCoeffecients design (float mu, float tanHalfBandwidth, float cosTheta) noexcept
+	{
 		const float zeta = 4.0f / (1.0f + mu);
-		const float beta = 0.5f * ((1 - zeta * tanf (theta / (2.0f * Q))) / (1 + zeta * tanf (theta / (2 * Q))));
-		const float gamma = (0.5f + beta) * cosf (theta);
+		const float beta = 0.5f * ((1 - zeta * tanHalfBandwidth) / (1 + zeta * tanHalfBandwidth));
+		const float gamma = (0.5f + beta) * cosTheta;
 
 		const float a0 = 0.5f - beta;
 		const float a1 = 0.0;
@@ -583,7 +868,7 @@ public:
 		const float c0 = mu - 1.0f;
 		const float d0 = 1.0f;
 
-		setCoeffs (a0, a1, a2, b1, b2, c0, d0);
+		return { a0, a1, a2, b1, b2, c0, d0 };
 	}
 
 	bool getUseGain () noexcept override
@@ -603,16 +888,16 @@ public:
 /// \brief The LowShelf Filter class
 /// A Low Shelf Filter
 /// Coefficent calculations from Designing Audio Effects Plugins in c++ 2nd ed Will Pirkle
-class LowShelf : public Filter, public BiQuad
+class LowShelf : public BiQuadFilter
 {
 public:
 	LowShelf () :
-		Filter ()
+		BiQuadFilter ()
 	{
 	}
 
 	LowShelf (int samplerate) :
-		Filter (samplerate)
+		BiQuadFilter (samplerate)
 	{
 	}
 
@@ -629,8 +914,17 @@ public:
 	{
 		const float theta = k_2pi * m_freq / m_sampleRate;
 		const float mu = powf (10, m_gain / 20.0f);
+		setCoeffs (design (mu, tanf (theta * 0.5f)));
+	}
+
+	///
+	/// \brief design
+	/// The coefficients for a linear gain mu, from tan (theta / 2), theta the corner in
+	/// radians per sample, as PeakFilter::design
+	static BiquadCoeffecients design (float mu, float tanHalfTheta) noexcept
+	{
 		const float beta = 4.0f / (1.0f + mu);
-		const float delta = beta * tanf (theta * 0.5f);
+		const float delta = beta * tanHalfTheta;
 		const float gamma = (1.0f - delta) / (1.0f + delta);
 
 		const float a0 = (1.0f - gamma) * 0.5f;
@@ -641,7 +935,7 @@ public:
 		const float c0 = mu - 1.0f;
 		const float d0 = 1.0f;
 
-		setCoeffs (a0, a1, a2, b1, b2, c0, d0);
+		return { a0, a1, a2, b1, b2, c0, d0 };
 	}
 
 	bool getUseGain () noexcept override
@@ -659,16 +953,16 @@ public:
 /// \brief The HighShelf Filter class
 /// A  High Shelf Filter
 /// Coefficent calculations from Designing Audio Effects Plugins in c++ 2nd ed Will Pirkle
-class HighShelf : public Filter, public BiQuad
+class HighShelf : public BiQuadFilter
 {
 public:
 	HighShelf () :
-		Filter ()
+		BiQuadFilter ()
 	{
 	}
 
 	HighShelf (int samplerate) :
-		Filter (samplerate)
+		BiQuadFilter (samplerate)
 	{
 	}
 
@@ -686,8 +980,16 @@ public:
 	{
 		const float theta = k_2pi * m_freq / m_sampleRate;
 		const float mu = powf (10, m_gain / 20.0f);
+		setCoeffs (design (mu, tanf (theta * 0.5f)));
+	}
+
+	///
+	/// \brief design
+	/// As LowShelf::design, for the high shelf
+	static BiquadCoeffecients design (float mu, float tanHalfTheta) noexcept
+	{
 		const float beta = (1.0f + mu) / 4.0f;
-		const float delta = beta * tanf (theta * 0.5f);
+		const float delta = beta * tanHalfTheta;
 		const float gamma = (1.0f - delta) / (1.0f + delta);
 
 		const float a0 = (1.0f + gamma) * 0.5f;
@@ -698,7 +1000,7 @@ public:
 		const float c0 = mu - 1.0f;
 		const float d0 = 1.0f;
 
-		setCoeffs (a0, a1, a2, b1, b2, c0, d0);
+		return { a0, a1, a2, b1, b2, c0, d0 };
 	}
 
 	bool getUseGain () noexcept override
@@ -718,45 +1020,125 @@ public:
 class FilterChain : public Filter
 {
 public:
+	static constexpr int k_maxStages = 8;
+
 	FilterChain ()
 		: Filter () {}
 
 	~FilterChain () {  }
 
-	void push_back (std::unique_ptr<Filter> newFilter) { m_filters.push_back (std::move (newFilter)); }
+	/// takes ownership of a stage
+	void push_back (std::unique_ptr<Filter> newFilter)
+	{
+		push_back (*newFilter);
+		m_owned.push_back (std::move (newFilter));
+	}
+
+	/// a stage owned elsewhere, normally a member of the chain itself, so the stages lie
+	/// alongside the chain rather than each in its own allocation. The first k_maxStages
+	/// are listed in the chain, a longer chain moves its list to the heap.
+	void push_back (Filter& stage)
+	{
+		if (m_numStages < k_maxStages && m_moreStages.empty ())
+		{
+			m_stages[m_numStages++] = &stage;
+			return;
+		}
+		if (m_moreStages.empty ()) m_moreStages.assign (m_stages, m_stages + m_numStages);
+		m_moreStages.push_back (&stage);
+		++m_numStages;
+	}
 
-	inline void setFrequency (float freq) override { for (auto& f : m_filters) { f->setFrequency (freq); } }
+	inline void setFrequency (float freq) override { for (auto* f : chain ()) { f->setFrequency (freq); } }
 
-	void setQ (float Q) override { for (auto& f : m_filters) { f->setQ (Q); } }
+	void setQ (float Q) override { for (auto* f : chain ()) { f->setQ (Q); } }
 
-	void setGain (float proposedGain) override { for (auto& f : m_filters) { f->setGain (proposedGain); } }
+	void setGain (float proposedGain) override { for (auto* f : chain ()) { f->setGain (proposedGain); } }
 
 	inline void setParameters (float freq, float Q, float gain = 0.0) override
 	{
-		for (auto& f : m_filters) { f->setParameters (freq, Q, gain); }
+		for (auto* f : chain ()) { f->setParameters (freq, Q, gain); }
 	}
 
 	inline float processSample (float in) override
 	{
 		float val = in;
-		for (auto& f : m_filters) { val = f->processSample (val); }
+		for (auto* f : chain ()) { val = f->processSample (val); }
 		return val;
 	}
 
-	inline void clear () override { for (auto& f : m_filters) { f->clear (); } }
+	/// each stage takes the whole block in turn
+	void processBlock (float* block, int blockSize) override
+	{
+		for (auto* f : chain ()) { f->processBlock (block, blockSize); }
+	}
+
+	/// the first stage reads in, the rest work in place on out
+	void process (const float* in, float* out, int blockSize) override
+	{
+		if (in == nullptr || out == nullptr) return;
+		if (m_numStages == 0)
+		{
+			AudioProcess::process (in, out, blockSize);
+			return;
+		}
+		const auto stages = chain ();
+		(*stages.first)->process (in, out, blockSize);
+		for (auto f = stages.first + 1; f != stages.last; ++f) { (*f)->processBlock (out, blockSize); }
+	}
+
+	inline void clear () override { for (auto* f : chain ()) { f->clear (); } }
 
 	void calcCoefficents () override
 	{
-		for (auto& f : m_filters) { f->calcCoefficents (); }
+		for (auto* f : chain ()) { f->calcCoefficents (); }
 	}
 
 	void setSampleRate (int sr) override
 	{
-		for (auto& f : m_filters) { f->setSampleRate (sr); }
+		for (auto* f : chain ()) { f->setSampleRate (sr); }
+	}
+
+	void appendStages (std::vector<BiQuad::BiquadCoeffecients>& stages) override
+	{
+		for (auto* f : chain ()) { f->appendStages (stages); }
+	}
+
+	int copyStages (BiQuad::BiquadCoeffecients* stages, int maxStages) override
+	{
+		auto n = 0;
+		for (auto* f : chain ()) { n += f->copyStages (stages + n, maxStages - n); }
+		return n;
+	}
+
+	void appendBiQuads (std::vector<BiQuad*>& biquads) override
+	{
+		for (auto* f : chain ()) { f->appendBiQuads (biquads); }
+	}
+
+	void setDesignOnRealtimeThread (bool shouldDesignOnRealtimeThread) override
+	{
+		for (auto* f : chain ()) { f->setDesignOnRealtimeThread (shouldDesignOnRealtimeThread); }
 	}
 
 private:
-	std::vector<std::unique_ptr<Filter>> m_filters;
+	struct Stages
+	{
+		Filter* const* first;
+		Filter* const* last;
+		Filter* const* begin () const noexcept { return first; }
+		Filter* const* end () const noexcept { return last; }
+	};
+	Stages chain () const noexcept
+	{
+		const auto* first = m_moreStages.empty () ? m_stages : m_moreStages.data ();
+		return { first, first + m_numStages };
+	}
+
+	Filter* m_stages[k_maxStages]{};
+	int m_numStages{ 0 };
+	std::vector<Filter*> m_moreStages;	// every stage, once there are more than k_maxStages
+	std::vector<std::unique_ptr<Filter>> m_owned;
 };
 
 class Lp24 : public FilterChain
@@ -764,8 +1146,8 @@ class Lp24 : public FilterChain
 public:
 	Lp24 () : FilterChain ()
 	{
-		push_back (std::make_unique<Lp12> ());
-		push_back (std::make_unique<Lp12> ());
+		push_back (m_sections[0]);
+		push_back (m_sections[1]);
 	};
 
 	bool getUseGain () noexcept override
@@ -777,6 +1159,9 @@ public:
 	{
 		return true;
 	}
+
+private:
+	Lp12 m_sections[2];
 };
 
 class Hp24 : public FilterChain
@@ -784,8 +1169,8 @@ class Hp24 : public FilterChain
 public:
 	Hp24 () : FilterChain ()
 	{
-		push_back (std::make_unique<Hp12> ());
-		push_back (std::make_unique<Hp12> ());
+		push_back (m_sections[0]);
+		push_back (m_sections[1]);
 	}
 
 	bool getUseGain () noexcept override
@@ -797,6 +1182,296 @@ public:
 	{
 		return true;
 	}
+
+private:
+	Hp12 m_sections[2];
+};
+
+
+///
+/// \brief The Ladder Filter class
+/// A 4 pole transistor ladder low pass, with a tanh saturator on each stage inside the
+/// feedback loop, resonating more as Q rises up to the edge of self oscillation. Solved
+/// without a unit delay in the loop as in Teemu Voipio's "Cheap non-linear zero-delay
+/// filters", 2012: each stage's tanh (x) / x is taken from the state at the last step,
+/// which leaves a linear system to solve, and the four stages take theirs at once through
+/// fastTanhXdX4. It runs at twice the sample rate inside an Oversampler2x, so the harmonics
+/// the saturation adds above the original Nyquist are filtered out rather than folded back
+/// into the audio band. Gain is the drive into the ladder in dB, the output is scaled back
+/// down by it and up by 1 + the feedback, so the passband stays at unity while the
+/// resonance grows.
+class Ladder : public Filter
+{
+public:
+	struct LadderCoefficients
+	{
+		float m_f;			// each stage's prewarped gain, tan (pi fc / 2 fs)
+		float m_r;			// the feedback, 4 self oscillates
+		float m_drive;		// into the ladder
+		float m_makeUp;		// out of it, (1 + r) / drive
+	};
+
+	Ladder () :
+		Filter ()
+	{
+		clear ();
+	}
+
+	Ladder (int samplerate) :
+		Filter (samplerate)
+	{
+		clear ();
+	}
+
+	float processSample (float in) override
+	{
+		fetchCoefficients ();
+		return tickOversampled (in);
+	}
+
+	void processBlock (float* block, int blockSize) override
+	{
+		process (block, block, blockSize);
+	}
+
+	void process (const float* in, float* out, int blockSize) override
+	{
+		if (in == nullptr || out == nullptr) return;
+		fetchCoefficients ();
+		for (auto i = 0; i < blockSize; ++i) out[i] = tickOversampled (in[i]);
+	}
+
+	void clear () override
+	{
+		for (auto& s : m_state.s) s = 0.0f;
+		m_state.previousIn = 0.0f;
+		m_oversampler.clear ();
+	}
+
+	void calcCoefficents () override
+	{
+		if (m_sampleRate <= 0) return;
+		const auto coeffs = design (static_cast<float> (m_sampleRate), m_freq, m_Q, m_gain);
+		if (m_designOnRealtimeThread)
+		{
+			m_state.coeffs = coeffs;
+			return;
+		}
+		farbot::NonRealtimeMutatable<LadderCoefficients>::ScopedAccess<false> current (m_ladderCoeffs);
+		*current = coeffs;
+	}
+
+	///
+	/// \brief design
+	/// The coefficients for a cutoff, Q and drive in dB, at twice sampleRate. Q 0.5 and
+	/// below has no feedback, 0.707 gives r 1.17 and 20 gives r 3.9
+	static LadderCoefficients design (float sampleRate, float freq, float Q, float gain) noexcept
+	{
+		const auto cutoff = std::min (freq, 0.45f * sampleRate);
+		const auto r = 4.0f * bound (0.0f, 1.0f - 0.5f / std::max (0.1f, Q), 0.975f);
+		const auto drive = powf (10.0f, gain / 20.0f);
+		return { tanf (k_pi * cutoff / (2.0f * sampleRate)), r, drive, (1.0f + r) / drive };
+	}
+
+	bool getUseGain () noexcept override
+	{
+		return true;
+	}
+
+	bool getUseQ () noexcept override
+	{
+		return true;
+	}
+
+	bool isLinear () noexcept override
+	{
+		return false;
+	}
+
+	/// A copy of the current coefficients, as BiQuad::getCoeffs
+	LadderCoefficients getCoeffs ()
+	{
+		if (m_designOnRealtimeThread) return m_state.coeffs;
+		farbot::NonRealtimeMutatable<LadderCoefficients>::ScopedAccess<false> coeffs (m_ladderCoeffs);
+		return *coeffs;
+	}
+
+	///
+	/// \brief appendStages
+	/// The small signal response, at the sample rate rather than oversampled, the analog
+	/// ladder (1 + r) / ((1 + s / wc)^4 + r) through the bilinear transform prewarped to the
+	/// cutoff, its two pairs of poles -1 + r^1/4 e^(+-j pi / 4) and -1 + r^1/4 e^(+-j 3 pi / 4)
+	/// as two low pass sections of unity gain at DC
+	void appendStages (std::vector<BiQuad::BiquadCoeffecients>& stages) override
+	{
+		BiQuad::BiquadCoeffecients sections[2];
+		stages.insert (stages.end (), sections, sections + copyStages (sections, 2));
+	}
+
+	int copyStages (BiQuad::BiquadCoeffecients* stages, int maxStages) override
+	{
+		if (m_sampleRate <= 0) return 0;
+		constexpr auto pi = static_cast<double> (LD_PI);
+		const auto c = getCoeffs ();
+		const auto K = std::tan (pi * std::min (m_freq, 0.45f * m_sampleRate) / m_sampleRate);
+		const auto spread = std::pow (static_cast<double> (c.m_r), 0.25) * std::sqrt (0.5);
+		auto n = 0;
+		for (auto side : { 1.0, -1.0 })
+		{
+			if (n == maxStages) break;
+			// the pole -1 + spread (side + j), as s^2 + a s + P normalised to the cutoff
+			const auto re = -1.0 + side * spread;
+			const auto a = -2.0 * re;
+			const auto P = re * re + spread * spread;
+			const auto den = 1.0 + a * K + P * K * K;
+			const auto a0 = P * K * K / den;
+			stages[n++] = { static_cast<float> (a0), static_cast<float> (2.0 * a0), static_cast<float> (a0),
+				static_cast<float> ((2.0 * P * K * K - 2.0) / den), static_cast<float> ((1.0 - a * K + P * K * K) / den), 1.0f, 0.0f };
+		}
+		return n;
+	}
+
+	///
+	/// \brief getTailLengthSamples
+	/// The linear ladder's, from the poles of 1 + r G(z)^4, G the oversampled one pole
+	/// f (1 + z^-1) / ((1 + f) - (1 - f) z^-1), and the residues of each, the impulse response
+	/// being their sum of geometric series. With no feedback its four poles coincide and it
+	/// rings no longer than K^4 C(n + 3, 3) a^n, a the one pole's and K the bound on its own
+	/// response, K a^n. Halved for the sample rate, with the oversampler's tail added. The
+	/// saturation only slows the decay while the ladder is driven, so this bounds it once
+	/// the input has fallen below its knee.
+	double getTailLengthSamples (double decayDb = 120.0) override
+	{
+		constexpr auto pi = static_cast<double> (LD_PI);
+		const auto c = getCoeffs ();
+		const auto floor = std::log (std::pow (10.0, -decayDb / 20.0));
+		const double f = c.m_f, r = c.m_r;
+		if (f <= 0.0) return Oversampler2x::tailLengthSamples (decayDb);
+
+		auto oversampled = 0.0;
+		if (r <= 0.0)
+		{
+			// from past the peak of n^3 a^n, where the iteration converges on the later root
+			const auto logA = std::log ((1.0 - f) / (1.0 + f));
+			const auto logK = std::log (2.0 * f / ((1.0 + f) * (1.0 - f)));
+			oversampled = -3.0 / logA;
+			for (auto i = 0; i < 32; ++i)
+			{
+				const auto n = oversampled;
+				oversampled = std::max (-3.0 / logA, (floor - 4.0 * logK - std::log ((n + 1.0) * (n + 2.0) * (n + 3.0) / 6.0)) / logA);
+			}
+		}
+		else
+		{
+			const auto rho = std::pow (r, -0.25);
+			auto radius = 0.0, residues = 0.0;
+			for (auto k = 0; k < 4; ++k)
+			{
+				const auto G = std::polar (rho, pi * (2 * k + 1) / 4.0);
+				const auto w = (G * (1.0 + f) - f) / (f + G * (1.0 - f));
+				const auto stage = (1.0 + f) - (1.0 - f) * w;
+				const auto numerator = (1.0 + r) * std::pow (f, 4.0) * std::pow (1.0 + w, 4.0);
+				const auto slope = -4.0 * (1.0 - f) * std::pow (stage, 3.0) + 4.0 * r * std::pow (f, 4.0) * std::pow (1.0 + w, 3.0);
+				radius = std::max (radius, 1.0 / std::abs (w));
+				residues += std::abs (numerator / (slope * w));
+			}
+			if (radius >= 1.0) return std::numeric_limits<double>::infinity ();
+			oversampled = std::max (0.0, (floor - std::log (std::max (1.0, residues))) / std::log (radius));
+		}
+		return 0.5 * oversampled + Oversampler2x::tailLengthSamples (decayDb) + 2.0;
+	}
+
+	///
+	/// \brief setDesignOnRealtimeThread
+	/// As BiQuad::setDesignOnRealtimeThread
+	void setDesignOnRealtimeThread (bool shouldDesignOnRealtimeThread) override
+	{
+		if (shouldDesignOnRealtimeThread == m_designOnRealtimeThread) return;
+		farbot::NonRealtimeMutatable<LadderCoefficients>::ScopedAccess<false> coeffs (m_ladderCoeffs);
+		if (shouldDesignOnRealtimeThread) m_state.coeffs = *coeffs;
+		else *coeffs = m_state.coeffs;
+		m_designOnRealtimeThread = shouldDesignOnRealtimeThread;
+	}
+
+private:
+	/// the coefficients the block runs with, copied onto the state's cache line, where
+	/// they are designed already when the audio thread designs them
+	inline void fetchCoefficients () noexcept
+	{
+		if (m_designOnRealtimeThread) return;
+		farbot::NonRealtimeMutatable<LadderCoefficients>::ScopedAccess<true> coeffs (m_ladderCoeffs);
+		m_state.coeffs = *coeffs;
+	}
+
+	/// one sample through the oversampler and two steps of the ladder
+	inline float tickOversampled (float in) noexcept
+	{
+		const auto& c = m_state.coeffs;
+		float oversampled[2];
+		m_oversampler.upsample (in * c.m_drive, oversampled);
+		oversampled[0] = tick (oversampled[0]);
+		oversampled[1] = tick (oversampled[1]);
+		return m_oversampler.downsample (oversampled) * c.m_makeUp;
+	}
+
+	/// one step at twice the sample rate
+	inline float tick (float in) noexcept
+	{
+		auto& s = m_state.s;
+		const auto f = m_state.coeffs.m_f, r = m_state.coeffs.m_r;
+
+		// the stages' gains from their states, and the input's from halfway to the last input
+		float t[4];
+		fastTanhXdX4 (s, t);
+		const auto t0 = fastTanhXdX (0.5f * (in + m_state.previousIn) - r * s[3]);
+		m_state.previousIn = in;
+
+		// each stage solved on its own, y = t g (s + f x), then the loop through all four
+		const float g[4] = { 1.0f / (1.0f + f * t[0]), 1.0f / (1.0f + f * t[1]), 1.0f / (1.0f + f * t[2]), 1.0f / (1.0f + f * t[3]) };
+		const auto f3 = f * t[2] * g[3];
+		const auto f2 = f * t[1] * g[2] * f3;
+		const auto f1 = f * t[0] * g[1] * f2;
+		const auto f0 = f * t0 * g[0] * f1;
+		const auto y3 = (g[3] * s[3] + f3 * g[2] * s[2] + f2 * g[1] * s[1] + f1 * g[0] * s[0] + f0 * in) / (1.0f + r * f0);
+
+		// the first three stages as offset + slope x, worked out while y3 is, so once the
+		// ladder's input x is known they follow at once rather than one after another
+		const auto slope0 = t[0] * g[0] * f;
+		const auto offset0 = t[0] * g[0] * s[0];
+		const auto slope1 = t[1] * g[1] * f * slope0;
+		const auto offset1 = t[1] * g[1] * (s[1] + f * offset0);
+		const auto slope2 = t[2] * g[2] * f * slope1;
+		const auto offset2 = t[2] * g[2] * (s[2] + f * offset1);
+
+		const auto x = t0 * (in - r * y3);
+		const auto y0 = offset0 + slope0 * x;
+		const auto y1 = offset1 + slope1 * x;
+		const auto y2 = offset2 + slope2 * x;
+
+		s[0] += 2.0f * f * (x - y0);
+		s[1] += 2.0f * f * (y0 - y1);
+		s[2] += 2.0f * f * (y1 - y2);
+		s[3] += 2.0f * f * (y2 - t[3] * y3);
+		//check denormal
+		for (auto& v : s) if (!isnormal (v)) v = 0.0f;
+		return y3;
+	}
+
+	/// the audio thread's, the stages and the coefficients together on one cache line as
+	/// the BiQuad's are
+	struct alignas (SSPO_CACHE_LINE) State
+	{
+		float s[4];
+		float previousIn;
+		LadderCoefficients coeffs;
+	};
+	static_assert (sizeof (State) == SSPO_CACHE_LINE, "the state and its coefficients fit one cache line");
+	State m_state{};
+	Oversampler2x m_oversampler;
+
+	// shared with the design thread
+	alignas (SSPO_CACHE_LINE) farbot::NonRealtimeMutatable<LadderCoefficients> m_ladderCoeffs;
+	bool m_designOnRealtimeThread{ false };
 };
 
 
@@ -806,23 +1481,12 @@ public:
 
 	static std::vector<std::string> typeStings ()
 	{
-		return { "LP6", "LP12", "LP24", "HP6", "HP12", "HP24", "Low Shelf", "High Shelf", "Peak", "BP12", "BS12" };
+		return { "LP6", "LP12", "LP24", "HP6", "HP12", "HP24", "Low Shelf", "High Shelf", "Peak", "BP12", "BS12", "Ladder" };
 	}
 
 	MultiFilter ()
+		: m_filters{ &m_lp6, &m_lp12, &m_lp24, &m_hp6, &m_hp12, &m_hp24, &m_lowShelf, &m_highShelf, &m_peak, &m_bp12, &m_bs12, &m_ladder }
 	{
-		m_filters.push_back (std::make_unique < Lp6> ());
-		m_filters.push_back (std::make_unique < Lp12 > ());
-		m_filters.push_back (std::make_unique < Lp24 > ());
-		m_filters.push_back (std::make_unique < Hp6 > ());
-		m_filters.push_back (std::make_unique < Hp12 > ());
-		m_filters.push_back (std::make_unique < Hp24 > ());
-		m_filters.push_back (std::make_unique < LowShelf > ());
-		m_filters.push_back (std::make_unique < HighShelf > ());
-		m_filters.push_back (std::make_unique < PeakFilter > ());
-		m_filters.push_back (std::make_unique < Bp12 > ());
-		m_filters.push_back (std::make_unique < Bs12 > ());
-
 		setType (typeStings ().at (0));
 	}
 
@@ -832,36 +1496,165 @@ public:
 
 	bool setType (std::string type)
 	{
-		for (auto i = 0; i < typeStings ().size (); ++i)
+		const auto types = typeStings ();
+		for (auto i = 0; i < static_cast<int>(types.size ()); ++i)
 		{
-			if (type.compare (typeStings ().at (i)) == 0)
+			if (type.compare (types.at (i)) == 0)
 			{
-				m_filters.at (i)->setSampleRate (m_sampleRate);
-				m_filters.at (i)->calcCoefficents ();
-				m_filters.at (i)->clear ();
-				m_currentFilterIndex.store (i);
-				return true;
+				return setTypeIndex (i);
 			}
 		}
 		return false;
 	}
 
-	inline void setFrequency (float freq) override { m_filters.at (m_currentFilterIndex.load ())->setFrequency (freq); }
+	bool setTypeIndex (int index)
+	{
+		if (index < 0 || index >= static_cast<int>(m_filters.size ())) return false;
+		m_targetType.store (index);
+		if (isControlRate ()) return true;
+
+		// setSampleRate keeps every filter at our rate, so only the coefficients need designing
+		m_filters.at (index)->calcCoefficents ();
+		m_filters.at (index)->clear ();
+		m_currentFilterIndex.store (index);
+		return true;
+	}
+
+	///
+	/// \brief setTypeIndex
+	/// Selects a type and sets its parameters, designing the coefficients once
+	bool setTypeIndex (int index, float freq, float Q, float gain)
+	{
+		if (index < 0 || index >= static_cast<int>(m_filters.size ())) return false;
+		setTargets (freq, Q, gain);
+		m_targetType.store (index);
+		if (isControlRate ()) return true;
+
+		m_filters.at (index)->setParameters (freq, Q, gain);
+		m_filters.at (index)->clear ();
+		m_currentFilterIndex.store (index);
+		return true;
+	}
+
+	int getTypeIndex () const noexcept
+	{
+		return m_currentFilterIndex.load ();
+	}
+
+	///
+	/// \brief setControlRate
+	/// With samplesPerUpdate > 0 parameter and type changes only set targets, processing
+	/// then smooths towards them and redesigns the coefficients, on the audio thread,
+	/// at most once every samplesPerUpdate samples, the biquads run uninterrupted in
+	/// between. 0, the default, designs immediately on every change.
+	/// Not to be called while processing, the current parameters are applied straight away.
+	void setControlRate (int samplesPerUpdate, float smoothingMs = 20.0f)
+	{
+		m_controlInterval = std::max (0, samplesPerUpdate);
+		m_smoothingMs = std::max (0.0f, smoothingMs);
+		for (auto& f : m_filters) { f->setDesignOnRealtimeThread (m_controlInterval > 0); }
+		m_targetType.store (m_currentFilterIndex.load ());
+		snapToTargets ();
+	}
+
+	bool isControlRate () const noexcept { return m_controlInterval > 0; }
+	int getControlInterval () const noexcept { return m_controlInterval; }
+
+	///
+	/// \brief snapToTargets
+	/// Jumps straight to the target parameters, not to be called while processing
+	void snapToTargets ()
+	{
+		m_controlFreq = m_targetFreq.load ();
+		m_controlQ = m_targetQ.load ();
+		m_controlGain = m_targetGain.load ();
+		const auto type = m_targetType.load ();
+		m_currentFilterIndex.store (type);
+		m_filters.at (type)->setParameters (m_controlFreq, m_controlQ, m_controlGain);
+		m_samplesUntilUpdate = 0;
+		updateSmoothing ();
+	}
+
+	/// coefficient redesigns made by the control rate updates so far
+	uint64_t getRedesignCount () const noexcept { return m_redesignCount.load (std::memory_order_relaxed); }
+	/// samples processed so far, with getRedesignCount gives the redesign rate
+	uint64_t getProcessedSampleCount () const noexcept { return m_processedSamples.load (std::memory_order_relaxed); }
+	/// zeroes both counts, not while processing
+	void resetCounts () noexcept
+	{
+		m_redesignCount.store (0, std::memory_order_relaxed);
+		m_processedSamples.store (0, std::memory_order_relaxed);
+	}
+
+	void setSampleRate (int sr) override
+	{
+		if (sr <= 0) return;
+		m_sampleRate = sr;
+		for (auto& f : m_filters) { f->setSampleRate (sr); }
+		updateSmoothing ();
+	}
+
+	inline void setFrequency (float freq) override
+	{
+		m_targetFreq.store (freq);
+		if (!isControlRate ()) m_filters.at (m_currentFilterIndex.load ())->setFrequency (freq);
+	}
 
-	void setQ (float Q) override { m_filters.at (m_currentFilterIndex.load ())->setQ (Q); }
+	void setQ (float Q) override
+	{
+		m_targetQ.store (Q);
+		if (!isControlRate ()) m_filters.at (m_currentFilterIndex.load ())->setQ (Q);
+	}
 
-	void setGain (float proposedGain) override { m_filters.at (m_currentFilterIndex)->setGain (proposedGain); }
+	void setGain (float proposedGain) override
+	{
+		m_targetGain.store (proposedGain);
+		if (!isControlRate ()) m_filters.at (m_currentFilterIndex)->setGain (proposedGain);
+	}
 
 	inline void setParameters (float freq, float Q, float proposedGain = 1.0) override
 	{
-		m_filters.at (m_currentFilterIndex.load ())->setParameters (freq, Q, proposedGain);
+		setTargets (freq, Q, proposedGain);
+		if (!isControlRate ()) m_filters.at (m_currentFilterIndex.load ())->setParameters (freq, Q, proposedGain);
 	}
 
 	inline float processSample (float in) override
 	{
+		if (isControlRate ())
+		{
+			if (m_samplesUntilUpdate <= 0) controlUpdate ();
+			--m_samplesUntilUpdate;
+			m_processedSamples.store (m_processedSamples.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		}
 		return m_filters.at (m_currentFilterIndex.load ())->processSample (in);
 	}
 
+	void processBlock (float* block, int blockSize) override
+	{
+		process (block, block, blockSize);
+	}
+
+	void process (const float* in, float* out, int blockSize) override
+	{
+		if (in == nullptr || out == nullptr) return;
+		if (!isControlRate ())
+		{
+			m_filters.at (m_currentFilterIndex.load ())->process (in, out, blockSize);
+			return;
+		}
+
+		auto done = 0;
+		while (done < blockSize)
+		{
+			if (m_samplesUntilUpdate <= 0) controlUpdate ();
+			const auto run = std::min (m_samplesUntilUpdate, blockSize - done);
+			m_filters.at (m_currentFilterIndex.load ())->process (in + done, out + done, run);
+			m_samplesUntilUpdate -= run;
+			done += run;
+		}
+		m_processedSamples.store (m_processedSamples.load (std::memory_order_relaxed) + blockSize, std::memory_order_relaxed);
+	}
+
 	inline void clear () override { m_filters.at (m_currentFilterIndex.load ())->clear (); }
 
 	void calcCoefficents () override
@@ -869,6 +1662,33 @@ public:
 		m_filters.at (m_currentFilterIndex.load ())->calcCoefficents ();
 	}
 
+	void appendStages (std::vector<BiQuad::BiquadCoeffecients>& stages) override
+	{
+		m_filters.at (m_currentFilterIndex.load ())->appendStages (stages);
+	}
+
+	int copyStages (BiQuad::BiquadCoeffecients* stages, int maxStages) override
+	{
+		return m_filters[static_cast<size_t> (m_currentFilterIndex.load ())]->copyStages (stages, maxStages);
+	}
+
+	/// every type designs on the calling thread, as with setControlRate but designing
+	/// each change straight away, see BiQuad::setDesignOnRealtimeThread
+	void setDesignOnRealtimeThread (bool shouldDesignOnRealtimeThread) override
+	{
+		for (auto& f : m_filters) { f->setDesignOnRealtimeThread (shouldDesignOnRealtimeThread); }
+	}
+
+	void appendBiQuads (std::vector<BiQuad*>& biquads) override
+	{
+		m_filters.at (m_currentFilterIndex.load ())->appendBiQuads (biquads);
+	}
+
+	double getTailLengthSamples (double decayDb = 120.0) override
+	{
+		return m_filters.at (m_currentFilterIndex.load ())->getTailLengthSamples (decayDb);
+	}
+
 	bool getUseGain (int index)
 	{
 		return m_filters.at (index)->getUseGain ();
@@ -879,6 +1699,12 @@ public:
 		return m_filters.at (index)->getUseQ ();
 	}
 
+	/// false for the Ladder, which saturates, the rest are biquad cascades
+	bool isLinear (int index)
+	{
+		return m_filters.at (index)->isLinear ();
+	}
+
 	bool getUseGain () noexcept override
 	{
 		return false;
@@ -889,12 +1715,378 @@ public:
 		return false;
 	}
 
+	bool isLinear () override
+	{
+		return m_filters.at (m_currentFilterIndex.load ())->isLinear ();
+	}
+
 private:
-	std::vector<std::unique_ptr<Filter>> m_filters;
-	//Filter* m_currentFilter;
-	std::atomic_int m_currentFilterIndex{ 0 };
+	void setTargets (float freq, float Q, float gain) noexcept
+	{
+		m_targetFreq.store (freq);
+		m_targetQ.store (Q);
+		m_targetGain.store (gain);
+	}
+
+	void updateSmoothing () noexcept
+	{
+		const auto samples = m_smoothingMs * 0.001f * m_sampleRate;
+		m_smoothingCoeff = samples > m_controlInterval && m_controlInterval > 0 ? 1.0f - expf (-m_controlInterval / samples) : 1.0f;
+	}
+
+	/// one pole smoothing, snapping once close enough that no more redesigns are needed
+	static bool smoothTowards (float& value, float target, float coeff, float tolerance) noexcept
+	{
+		if (value == target) return false;
+		value += (target - value) * coeff;
+		if (fabsf (target - value) <= tolerance) value = target;
+		return true;
+	}
+
+	///
+	/// \brief controlUpdate
+	/// A control rate tick on the audio thread, takes any new type, smooths the
+	/// parameters, and redesigns the current filter if anything moved
+	void controlUpdate () noexcept
+	{
+		m_samplesUntilUpdate = m_controlInterval;
+
+		auto changed = false;
+		const auto type = m_targetType.load ();
+		if (type != m_currentFilterIndex.load ())
+		{
+			m_filters.at (type)->clear ();
+			m_currentFilterIndex.store (type);
+			changed = true;
+		}
+
+		// cutoff moves in octaves rather than Hz
+		auto logFreq = log2f (bound (20.0f, m_controlFreq, 20000.0f));
+		const auto targetLogFreq = log2f (bound (20.0f, m_targetFreq.load (), 20000.0f));
+		if (smoothTowards (logFreq, targetLogFreq, m_smoothingCoeff, 1.0e-4f))
+		{
+			m_controlFreq = logFreq == targetLogFreq ? m_targetFreq.load () : exp2f (logFreq);
+			changed = true;
+		}
+		changed |= smoothTowards (m_controlQ, m_targetQ.load (), m_smoothingCoeff, 1.0e-4f);
+		changed |= smoothTowards (m_controlGain, m_targetGain.load (), m_smoothingCoeff, 1.0e-3f);
+
+		if (changed)
+		{
+			m_filters.at (m_currentFilterIndex.load ())->setParameters (m_controlFreq, m_controlQ, m_controlGain);
+			m_redesignCount.store (m_redesignCount.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		}
+	}
+
+	// the types, in the order of typeStings, held here rather than each in its own allocation,
+	// every one keeps its state variables on their own cache line
+	Lp6 m_lp6;
+	Lp12 m_lp12;
+	Lp24 m_lp24;
+	Hp6 m_hp6;
+	Hp12 m_hp12;
+	Hp24 m_hp24;
+	LowShelf m_lowShelf;
+	HighShelf m_highShelf;
+	PeakFilter m_peak;
+	Bp12 m_bp12;
+	Bs12 m_bs12;
+	Ladder m_ladder;
+	const std::array<Filter*, 12> m_filters;
+
+	// control rate updates, the targets may be set from any thread, on a cache line apart
+	// from the audio thread's fields below so that moving a control does not take it away
+	alignas (SSPO_CACHE_LINE) std::atomic<float> m_targetFreq{ 440.0f };
+	std::atomic<float> m_targetQ{ 0.707f };
+	std::atomic<float> m_targetGain{ 0.0f };
+	std::atomic_int m_targetType{ 0 };
+
+	// the audio thread's, the settings only change while not processing
+	alignas (SSPO_CACHE_LINE) std::atomic_int m_currentFilterIndex{ 0 };
 	static_assert (std::atomic_int::is_always_lock_free);
+	int m_samplesUntilUpdate{ 0 };
+	float m_controlFreq{ 440.0f };
+	float m_controlQ{ 0.707f };
+	float m_controlGain{ 0.0f };
+	std::atomic<uint64_t> m_redesignCount{ 0 };
+	std::atomic<uint64_t> m_processedSamples{ 0 };
+	int m_controlInterval{ 0 };
+	float m_smoothingMs{ 20.0f };
+	float m_smoothingCoeff{ 1.0f };
 
 	// Inherited via Filter
 
-};
\ No newline at end of file
+};
+
+///
+/// \brief The CoefficientBank class
+/// The coefficients of many filters in structure of arrays form, filter i's a0 is a0[i],
+/// as designCoefficientBatch writes them. get () gives one filter's as the
+/// BiquadCoeffecients every kernel takes, process () runs the whole bank straight from
+/// the arrays. LP24 and HP24 run two sections of the one set.
+class CoefficientBank
+{
+public:
+	///
+	/// \brief The SectionState struct
+	/// One section's delay line for every filter in the bank, in the same form
+	struct SectionState
+	{
+		void resize (int numFilters)
+		{
+			z1.assign (static_cast<size_t> (std::max (0, numFilters)), 0.0f);
+			z2.assign (static_cast<size_t> (std::max (0, numFilters)), 0.0f);
+		}
+
+		std::vector<float> z1, z2;
+	};
+
+	void resize (int numFilters)
+	{
+		for (auto* v : { &m_a0, &m_a1, &m_a2, &m_b1, &m_b2, &m_c0, &m_d0 }) v->resize (static_cast<size_t> (std::max (0, numFilters)));
+	}
+
+	int size () const noexcept { return static_cast<int> (m_a0.size ()); }
+
+	BiQuad::BiquadCoeffecients get (int i) const noexcept
+	{
+		return { m_a0[i], m_a1[i], m_a2[i], m_b1[i], m_b2[i], m_c0[i], m_d0[i] };
+	}
+
+	///
+	/// \brief process
+	/// Runs one section of every filter in the bank over numFrames interleaved frames in
+	/// place, channel i of each frame through filter i, so frames holds numFrames * size ()
+	/// samples and state must have been resized to size (). Within a frame the filters are
+	/// independent and read their coefficients and state contiguously, so the loop over
+	/// them vectorises. The arithmetic is BiQuad::tick's, with denormals flushed by a blend
+	/// rather than a branch. LP24 and HP24 filters need a second pass with a second state.
+	void process (SectionState& state, float* frames, int numFrames) const noexcept
+	{
+		const auto n = size ();
+		const auto* a0 = m_a0.data ();
+		const auto* a1 = m_a1.data ();
+		const auto* a2 = m_a2.data ();
+		const auto* b1 = m_b1.data ();
+		const auto* b2 = m_b2.data ();
+		const auto* c0 = m_c0.data ();
+		const auto* d0 = m_d0.data ();
+		auto* z1 = state.z1.data ();
+		auto* z2 = state.z2.data ();
+
+		for (auto f = 0; f < numFrames; ++f)
+		{
+			auto* frame = frames + static_cast<size_t> (f) * static_cast<size_t> (n);
+			for (auto i = 0; i < n; ++i)
+			{
+				const auto in = frame[i];
+				auto out = z1[i] + a0[i] * in;
+				out = std::fabs (out) >= std::numeric_limits<float>::min () ? out : 0.0f;
+				z1[i] = a1[i] * in + z2[i] - b1[i] * out;
+				z2[i] = a2[i] * in - b2[i] * out;
+				frame[i] = out * c0[i] + in * d0[i];
+			}
+		}
+	}
+
+	std::vector<float> m_a0, m_a1, m_a2, m_b1, m_b2, m_c0, m_d0;
+};
+
+namespace batchDesign
+{
+	/// the MultiFilter type indices
+	enum Type
+	{
+		lp6 = 0, lp12, lp24, hp6, hp12, hp24, lowShelf, highShelf, peak, bp12, bs12, ladder
+	};
+
+	/// filters are designed this many at a time, the working arrays live on the stack
+	constexpr int k_tile = 64;
+
+	///
+	/// \brief sinCos
+	/// sin and cos of n angles, branch free series the compiler vectorises. Reduced to
+	/// [-pi, pi], then by symmetry to [-pi / 2, pi / 2], where the series to x^11 and x^12
+	/// are within 1e-7. cos has its own series rather than a shifted sin, so that near 0,
+	/// low cutoffs, it is as close to 1 as cosf and the poles are not detuned.
+	inline void sinCos (const float* x, float* sinOut, float* cosOut, int n) noexcept
+	{
+		constexpr auto halfPi = 0.5f * k_pi;
+		for (auto i = 0; i < n; ++i)
+		{
+			// blends rather than selects, arithmetic in either arm of a ?: counts as
+			// control flow and stops the loop vectorising
+			auto v = x[i];
+			const auto turns = v * (1.0f / k_2pi);
+			v -= k_2pi * static_cast<float> (static_cast<int> (turns + std::copysign (0.5f, turns)));
+			const auto a = std::fabs (v);
+			const auto reflect = a > halfPi ? 1.0f : 0.0f;
+			const auto y = v + reflect * (std::copysign (k_pi - a, v) - v);
+			const auto y2 = y * y;
+
+			sinOut[i] = y * (1.0f + y2 * (-1.0f / 6.0f + y2 * (1.0f / 120.0f + y2 * (-1.0f / 5040.0f
+				+ y2 * (1.0f / 362880.0f + y2 * (-1.0f / 39916800.0f))))));
+			const auto cosY = 1.0f + y2 * (-0.5f + y2 * (1.0f / 24.0f + y2 * (-1.0f / 720.0f + y2 * (1.0f / 40320.0f
+				+ y2 * (-1.0f / 3628800.0f + y2 * (1.0f / 479001600.0f))))));
+			cosOut[i] = cosY * (1.0f - 2.0f * reflect);
+		}
+	}
+
+	///
+	/// \brief exp2
+	/// 2^x for n values, the series to x^8 for the fraction, which keeps the sign of x, the
+	/// whole part put straight into the exponent bits, within 2e-7 relative, x must lie
+	/// within +-126, a gain of +-750dB
+	inline void exp2 (const float* x, float* out, int n) noexcept
+	{
+		for (auto i = 0; i < n; ++i)
+		{
+			const auto v = x[i];
+			const auto whole = static_cast<float> (static_cast<int> (v));
+			const auto f = (v - whole) * 0.69314718f;
+			const auto p = 1.0f + f * (1.0f + f * (0.5f + f * (1.0f / 6.0f + f * (1.0f / 24.0f + f * (1.0f / 120.0f
+				+ f * (1.0f / 720.0f + f * (1.0f / 5040.0f + f * (1.0f / 40320.0f))))))));
+			const auto bits = static_cast<uint32_t> (static_cast<int> (whole) + 127) << 23;
+			float scale;
+			std::memcpy (&scale, &bits, sizeof (scale));
+			out[i] = p * scale;
+		}
+	}
+}
+
+///
+/// \brief designCoefficientBatch
+/// Designs numFilters filters at once into bank, which is resized to fit, filter i having
+/// MultiFilter type index types[i], and freqs[i], Qs[i], gains[i] and sampleRates[i], each
+/// clamped as Filter::setParameters clamps them. The same designs as calcCoefficents (),
+/// with the trig and gain done for a whole tile of filters together, in structure of
+/// arrays form, rather than filter by filter, and without any per filter lock or virtual
+/// call. Returns false if any type has no biquad design, the nonlinear Ladder or an
+/// unknown index, or any sample rate isn't above 0, those filters are given coefficients
+/// that pass their input straight through. Safe on any thread once the bank has been sized, it then doesn't allocate.
+inline bool designCoefficientBatch (const int* types, const float* freqs, const float* Qs, const float* gains,
+	const float* sampleRates, int numFilters, CoefficientBank& bank)
+{
+	using namespace batchDesign;
+	if (bank.size () != numFilters) bank.resize (numFilters);
+	auto allDesigned = true;
+
+	for (auto start = 0; start < numFilters; start += k_tile)
+	{
+		const auto n = std::min (k_tile, numFilters - start);
+		int type[k_tile];
+		float theta[k_tile], phi[k_tile], Q[k_tile], sinTheta[k_tile], cosTheta[k_tile], sinPhi[k_tile], cosPhi[k_tile], mu[k_tile];
+
+		// the Peak's tan is of theta / 2Q, the others' of theta / 2. A rate that is 0, negative
+		// or NaN designs nothing, as an unknown type doesn't
+		for (auto i = 0; i < n; ++i)
+		{
+			const auto freq = std::min (20000.0f, std::max (20.0f, freqs[start + i]));
+			const auto rate = sampleRates[start + i];
+			type[i] = rate > 0.0f ? types[start + i] : -1;
+			Q[i] = std::min (20.0f, std::max (0.1f, Qs[start + i]));
+			theta[i] = rate > 0.0f ? k_2pi * freq / rate : 0.0f;
+			phi[i] = theta[i] / (2.0f * (type[i] == peak ? std::max (1.0f, Q[i]) : 1.0f));
+			mu[i] = std::min (240.0f, std::max (-240.0f, gains[start + i])) * (3.32192809f / 20.0f);	// log2 (10) / 20
+		}
+		sinCos (theta, sinTheta, cosTheta, n);
+		sinCos (phi, sinPhi, cosPhi, n);
+		exp2 (mu, mu, n);
+
+		for (auto i = 0; i < n; ++i)
+		{
+			const auto s = sinTheta[i];
+			const auto c = cosTheta[i];
+			const auto t = sinPhi[i] / cosPhi[i];
+			float a0 = 1.0f, a1 = 0.0f, a2 = 0.0f, b1 = 0.0f, b2 = 0.0f, c0 = 1.0f, d0 = 0.0f;
+			switch (type[i])
+			{
+			case lp6:
+			case hp6:
+			{
+				const auto gamma = c / (1.0f + s);
+				const auto high = type[i] == hp6;
+				a0 = (1.0f + (high ? gamma : -gamma)) * 0.5f;
+				a1 = high ? -a0 : a0;
+				b1 = -gamma;
+				break;
+			}
+			case lp12:
+			case lp24:
+			case hp12:
+			case hp24:
+			{
+				const auto d = 1.0f / Q[i];
+				const auto beta = 0.5f * ((1.0f - 0.5f * d * s) / (1.0f + 0.5f * d * s));
+				const auto gamma = (0.5f + beta) * c;
+				const auto high = type[i] == hp12 || type[i] == hp24;
+				a0 = (0.5f + beta + (high ? gamma : -gamma)) * 0.5f;
+				a1 = high ? -2.0f * a0 : 2.0f * a0;
+				a2 = a0;
+				b1 = -2.0f * gamma;
+				b2 = 2.0f * beta;
+				break;
+			}
+			case bp12:
+			case bs12:
+			{
+				const auto delta = t * t * Q[i] + t + Q[i];
+				b1 = (2.0f * Q[i] * (t * t - 1.0f)) / delta;
+				b2 = (t * t * Q[i] - t + Q[i]) / delta;
+				if (type[i] == bp12)
+				{
+					a0 = t / delta;
+					a2 = -a0;
+				}
+				else
+				{
+					a0 = (Q[i] * (t * t + 1.0f)) / delta;
+					a1 = b1;
+					a2 = a0;
+				}
+				break;
+			}
+			case peak:
+			{
+				const auto zeta = 4.0f / (1.0f + mu[i]);
+				const auto beta = 0.5f * ((1.0f - zeta * t) / (1.0f + zeta * t));
+				const auto gamma = (0.5f + beta) * c;
+				a0 = 0.5f - beta;
+				a2 = -a0;
+				b1 = -2.0f * gamma;
+				b2 = 2.0f * beta;
+				c0 = mu[i] - 1.0f;
+				d0 = 1.0f;
+				break;
+			}
+			case lowShelf:
+			case highShelf:
+			{
+				const auto high = type[i] == highShelf;
+				const auto beta = high ? (1.0f + mu[i]) / 4.0f : 4.0f / (1.0f + mu[i]);
+				const auto delta = beta * t;
+				const auto gamma = (1.0f - delta) / (1.0f + delta);
+				a0 = (1.0f + (high ? gamma : -gamma)) * 0.5f;
+				a1 = high ? -a0 : a0;
+				b1 = -gamma;
+				c0 = mu[i] - 1.0f;
+				d0 = 1.0f;
+				break;
+			}
+			default:
+				allDesigned = false;
+				break;
+			}
+
+			const auto j = start + i;
+			bank.m_a0[j] = a0;
+			bank.m_a1[j] = a1;
+			bank.m_a2[j] = a2;
+			bank.m_b1[j] = b1;
+			bank.m_b2[j] = b2;
+			bank.m_c0[j] = c0;
+			bank.m_d0[j] = d0;
+		}
+	}
+	return allDesigned;
+}
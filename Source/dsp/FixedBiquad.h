@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#pragma once
+
+#include "AudioMath.h"
+#include "Filter.h"
+
+#include <ratio>
+
+///
+/// Filters whose type, cutoff, Q and sample rate are known when compiling, a DC block
+/// or a fixed crossover, have their coefficients designed by the compiler and baked into
+/// the kernel as constants, leaving only the arithmetic of the recurrence.
+/// The designs are those of the matching Filter classes, computed in double.
+enum class FixedType
+{
+	lp6, hp6, lp12, hp12, bp12, bs12, peak, lowShelf, highShelf
+};
+
+namespace constexprDesign
+{
+	constexpr double k_pi = static_cast<double> (LD_PI);
+	constexpr double k_ln10 = 2.30258509299404568402;
+
+	constexpr double round (double x) noexcept
+	{
+		return static_cast<double> (static_cast<long long> (x < 0.0 ? x - 0.5 : x + 0.5));
+	}
+
+	/// Taylor series, about zero, after reducing to [-pi, pi]
+	constexpr double sin (double x) noexcept
+	{
+		x -= 2.0 * k_pi * round (x / (2.0 * k_pi));
+		double term = x, sum = x;
+		for (auto n = 1; n < 20; ++n)
+		{
+			term *= -x * x / ((2.0 * n) * (2.0 * n + 1.0));
+			sum += term;
+		}
+		return sum;
+	}
+
+	constexpr double cos (double x) noexcept
+	{
+		return sin (x + 0.5 * k_pi);
+	}
+
+	constexpr double tan (double x) noexcept
+	{
+		return sin (x) / cos (x);
+	}
+
+	/// halved until small, the series, then squared back
+	constexpr double exp (double x) noexcept
+	{
+		auto halvings = 0;
+		while (x > 0.5 || x < -0.5)
+		{
+			x *= 0.5;
+			++halvings;
+		}
+		double term = 1.0, sum = 1.0;
+		for (auto n = 1; n < 16; ++n)
+		{
+			term *= x / n;
+			sum += term;
+		}
+		for (; halvings > 0; --halvings) sum *= sum;
+		return sum;
+	}
+
+	constexpr double decibelsToGain (double db) noexcept
+	{
+		return exp (db / 20.0 * k_ln10);
+	}
+
+	constexpr BiQuad::BiquadCoeffecients coeffs (double a0, double a1, double a2, double b1, double b2, double c0, double d0) noexcept
+	{
+		return { static_cast<float> (a0), static_cast<float> (a1), static_cast<float> (a2),
+			static_cast<float> (b1), static_cast<float> (b2), static_cast<float> (c0), static_cast<float> (d0) };
+	}
+
+	constexpr BiQuad::BiquadCoeffecients onePole (double freq, double sampleRate, bool highPass) noexcept
+	{
+		const auto theta = 2.0 * k_pi * freq / sampleRate;
+		const auto gamma = cos (theta) / (1.0 + sin (theta));
+		const auto a0 = (1.0 + (highPass ? gamma : -gamma)) * 0.5;
+		return coeffs (a0, highPass ? -a0 : a0, 0.0, -gamma, 0.0, 1.0, 0.0);
+	}
+
+	constexpr BiQuad::BiquadCoeffecients twoPole (double freq, double Q, double sampleRate, bool highPass) noexcept
+	{
+		const auto theta = 2.0 * k_pi * freq / sampleRate;
+		const auto s = sin (theta);
+		const auto d = 1.0 / Q;
+		const auto beta = 0.5 * ((1.0 - 0.5 * d * s) / (1.0 + 0.5 * d * s));
+		const auto gamma = (0.5 + beta) * cos (theta);
+		const auto a0 = (0.5 + beta + (highPass ? gamma : -gamma)) * 0.5;
+		return coeffs (a0, highPass ? -2.0 * a0 : 2.0 * a0, a0, -2.0 * gamma, 2.0 * beta, 1.0, 0.0);
+	}
+
+	constexpr BiQuad::BiquadCoeffecients bandPassOrStop (double freq, double Q, double sampleRate, bool stop) noexcept
+	{
+		const auto K = tan (k_pi * freq / sampleRate);
+		const auto delta = K * K * Q + K + Q;
+		const auto b1 = 2.0 * Q * (K * K - 1.0) / delta;
+		const auto b2 = (K * K * Q - K + Q) / delta;
+		if (stop)
+		{
+			const auto a0 = Q * (K * K + 1.0) / delta;
+			return coeffs (a0, b1, a0, b1, b2, 1.0, 0.0);
+		}
+		return coeffs (K / delta, 0.0, -K / delta, b1, b2, 1.0, 0.0);
+	}
+
+	constexpr BiQuad::BiquadCoeffecients peak (double freq, double Q, double gainDb, double sampleRate) noexcept
+	{
+		Q = Q < 1.0 ? 1.0 : Q;
+		const auto theta = 2.0 * k_pi * freq / sampleRate;
+		const auto mu = decibelsToGain (gainDb);
+		const auto zeta = 4.0 / (1.0 + mu);
+		const auto t = tan (theta / (2.0 * Q));
+		const auto beta = 0.5 * ((1.0 - zeta * t) / (1.0 + zeta * t));
+		const auto gamma = (0.5 + beta) * cos (theta);
+		return coeffs (0.5 - beta, 0.0, -(0.5 - beta), -2.0 * gamma, 2.0 * beta, mu - 1.0, 1.0);
+	}
+
+	constexpr BiQuad::BiquadCoeffecients shelf (double freq, double gainDb, double sampleRate, bool high) noexcept
+	{
+		const auto theta = 2.0 * k_pi * freq / sampleRate;
+		const auto mu = decibelsToGain (gainDb);
+		const auto beta = high ? (1.0 + mu) / 4.0 : 4.0 / (1.0 + mu);
+		const auto delta = beta * tan (theta * 0.5);
+		const auto gamma = (1.0 - delta) / (1.0 + delta);
+		const auto a0 = (1.0 + (high ? gamma : -gamma)) * 0.5;
+		return coeffs (a0, high ? -a0 : a0, 0.0, -gamma, 0.0, mu - 1.0, 1.0);
+	}
+
+	///
+	/// \brief design
+	/// The coefficients the Filter class for type would set, usable in a constant expression
+	constexpr BiQuad::BiquadCoeffecients design (FixedType type, double freq, double Q, double gainDb, double sampleRate) noexcept
+	{
+		switch (type)
+		{
+		case FixedType::lp6: return onePole (freq, sampleRate, false);
+		case FixedType::hp6: return onePole (freq, sampleRate, true);
+		case FixedType::lp12: return twoPole (freq, Q, sampleRate, false);
+		case FixedType::hp12: return twoPole (freq, Q, sampleRate, true);
+		case FixedType::bp12: return bandPassOrStop (freq, Q, sampleRate, false);
+		case FixedType::bs12: return bandPassOrStop (freq, Q, sampleRate, true);
+		case FixedType::peak: return peak (freq, Q, gainDb, sampleRate);
+		case FixedType::lowShelf: return shelf (freq, gainDb, sampleRate, false);
+		case FixedType::highShelf: return shelf (freq, gainDb, sampleRate, true);
+		}
+		return coeffs (1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0);
+	}
+
+	template <typename Ratio>
+	constexpr double ratioValue () noexcept
+	{
+		return static_cast<double> (Ratio::num) / static_cast<double> (Ratio::den);
+	}
+}
+
+/// the Butterworth Q, for the Q argument of FixedBiquad
+using ButterworthQ = std::ratio<7071, 10000>;
+
+///
+/// \brief The FixedBiquad class
+/// A BiQuad whose coefficients are designed at compile time. Q and GainDb are std::ratio
+/// types, as a float cannot be a template argument,
+///   FixedBiquad<FixedType::hp12, 20, ButterworthQ, 48000> dcBlock;
+/// No virtual calls, no coefficient storage, nothing to redesign, the same transposed
+/// canonical form and denormal check as BiQuad::tick.
+template <FixedType Type, int Freq, typename Q = ButterworthQ, int SampleRate = 48000, typename GainDb = std::ratio<0>>
+class FixedBiquad
+{
+public:
+	static_assert (Freq > 0 && 2 * Freq < SampleRate, "the cutoff must lie below nyquist");
+	static_assert (Q::num > 0, "Q must be positive");
+
+	static constexpr BiQuad::BiquadCoeffecients k_coeffs = constexprDesign::design (Type, Freq,
+		constexprDesign::ratioValue<Q> (), constexprDesign::ratioValue<GainDb> (), SampleRate);
+
+	void clear () noexcept
+	{
+		m_z1 = 0.0f;
+		m_z2 = 0.0f;
+	}
+
+	inline float processSample (float in) noexcept
+	{
+		float out = m_z1 + k_coeffs.m_a0 * in;
+		//check denormal
+		if (!std::isnormal (out)) out = 0.0f;
+		m_z1 = k_coeffs.m_a1 * in + m_z2 - k_coeffs.m_b1 * out;
+		m_z2 = k_coeffs.m_a2 * in - k_coeffs.m_b2 * out;
+
+		// in * 0 is not folded away by the compiler, it could be a nan
+		if constexpr (k_coeffs.m_d0 == 0.0f) return out * k_coeffs.m_c0;
+		else return out * k_coeffs.m_c0 + in * k_coeffs.m_d0;
+	}
+
+	inline void processBlock (float* block, int blockSize) noexcept
+	{
+		for (auto i = 0; i < blockSize; ++i) block[i] = processSample (block[i]);
+	}
+
+private:
+	float m_z1{ 0.0f }, m_z2{ 0.0f };
+};
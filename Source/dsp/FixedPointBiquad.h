@@ -0,0 +1,403 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#pragma once
+
+#include "Filter.h"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+///
+/// Fixed point filtering of integer PCM, 24 bit capture left justified into the top of
+/// an int32 so every sample is a Q31 fraction of full scale, without the round trip
+/// through float. The coefficients come from the same calcCoefficents() designs as the
+/// float filters, through BiQuad::getCoeffs() or Filter::appendStages().
+namespace fixedPoint
+{
+	/// a right justified 24 bit sample as Q31
+	inline int32_t fromPcm24 (int32_t sample) noexcept
+	{
+		return static_cast<int32_t> (static_cast<uint32_t> (sample) << 8);
+	}
+
+	/// Q31 back to right justified 24 bit, rounded to nearest
+	inline int32_t toPcm24 (int32_t sample) noexcept
+	{
+		return sample >= INT32_MAX - 127 ? 0x7fffff : (sample + 128) >> 8;
+	}
+
+	/// saturating float to Q31
+	inline int32_t fromFloat (float sample) noexcept
+	{
+		const auto scaled = static_cast<double> (sample) * 2147483648.0;
+		if (scaled >= 2147483647.0) return INT32_MAX;
+		if (scaled <= -2147483648.0) return INT32_MIN;
+		return static_cast<int32_t> (std::lround (scaled));
+	}
+
+	inline float toFloat (int32_t sample) noexcept
+	{
+		return static_cast<float> (sample) * (1.0f / 2147483648.0f);
+	}
+
+	inline int32_t saturate (int64_t x) noexcept
+	{
+		return static_cast<int32_t> (x > INT32_MAX ? INT32_MAX : (x < INT32_MIN ? INT32_MIN : x));
+	}
+
+	///
+	/// \brief The Coefficients struct
+	/// A biquad in direct form I, the c0 and d0 of the transposed canonical form folded
+	/// into the numerator,
+	///   H(z) = (a0 + a1 z^-1 + a2 z^-2) / (1 + b1 z^-1 + b2 z^-2)
+	/// Each coefficient is a Q31 fraction of 2^shift. The shift is the headroom that lets
+	/// b1 reach 2 and a boosted numerator go well past 1, it is chosen so the magnitudes of
+	/// all five sum to no more than 2^shift, which bounds the accumulated products of five
+	/// Q31 samples to 2^62, so the 64 bit accumulator can never overflow.
+	struct Coefficients
+	{
+		int32_t m_a0{ 0 }, m_a1{ 0 }, m_a2{ 0 }, m_b1{ 0 }, m_b2{ 0 };
+		int m_shift{ 0 };
+	};
+
+	inline Coefficients toFixed (const BiQuad::BiquadCoeffecients& c) noexcept
+	{
+		const double c0 = c.m_c0, d0 = c.m_d0;
+		const double taps[5] = {
+			c0 * c.m_a0 + d0,
+			c0 * c.m_a1 + d0 * c.m_b1,
+			c0 * c.m_a2 + d0 * c.m_b2,
+			c.m_b1,
+			c.m_b2 };
+
+		auto sum = 0.0;
+		for (auto t : taps) sum += std::fabs (t);
+
+		Coefficients fixed;
+		// 2^16 of gain is well past anything calcCoefficents designs
+		while (fixed.m_shift < 16 && sum > std::ldexp (1.0, fixed.m_shift)) ++fixed.m_shift;
+
+		int32_t* q[5] = { &fixed.m_a0, &fixed.m_a1, &fixed.m_a2, &fixed.m_b1, &fixed.m_b2 };
+		for (auto i = 0; i < 5; ++i)
+		{
+			const auto scaled = std::round (std::ldexp (taps[i], 31 - fixed.m_shift));
+			*q[i] = static_cast<int32_t> (std::fmax (-2147483648.0, std::fmin (2147483647.0, scaled)));
+		}
+		return fixed;
+	}
+}
+
+///
+/// \brief The FixedPointBiquad class
+/// One channel of Q31 samples through a direct form I biquad, the products summed in a
+/// 64 bit accumulator. Only the output is quantised, and the bits it drops are carried
+/// into the next sample's accumulator, first order error feedback, which shapes the
+/// truncation noise away from DC and the low frequencies where a low cutoff's recursion
+/// would otherwise amplify it. The output saturates rather than wraps.
+class FixedPointBiquad
+{
+public:
+	FixedPointBiquad () = default;
+
+	explicit FixedPointBiquad (const BiQuad::BiquadCoeffecients& c)
+	{
+		setCoeffs (c);
+	}
+
+	void setCoeffs (const BiQuad::BiquadCoeffecients& c) noexcept
+	{
+		m_coeffs = fixedPoint::toFixed (c);
+	}
+
+	const fixedPoint::Coefficients& getCoeffs () const noexcept
+	{
+		return m_coeffs;
+	}
+
+	void clear () noexcept
+	{
+		m_x1 = m_x2 = m_y1 = m_y2 = 0;
+		m_error = 0;
+	}
+
+	inline int32_t processSample (int32_t in) noexcept
+	{
+		const auto bits = 31 - m_coeffs.m_shift;
+		const int64_t acc = m_error
+			+ static_cast<int64_t> (m_coeffs.m_a0) * in
+			+ static_cast<int64_t> (m_coeffs.m_a1) * m_x1
+			+ static_cast<int64_t> (m_coeffs.m_a2) * m_x2
+			- static_cast<int64_t> (m_coeffs.m_b1) * m_y1
+			- static_cast<int64_t> (m_coeffs.m_b2) * m_y2;
+
+		const auto whole = acc >> bits;
+		m_error = acc - (whole << bits);
+		const auto out = fixedPoint::saturate (whole);
+
+		m_x2 = m_x1;
+		m_x1 = in;
+		m_y2 = m_y1;
+		m_y1 = out;
+		return out;
+	}
+
+	inline void processBlock (int32_t* block, int blockSize) noexcept
+	{
+		for (auto i = 0; i < blockSize; ++i) block[i] = processSample (block[i]);
+	}
+
+private:
+	fixedPoint::Coefficients m_coeffs;
+	int32_t m_x1{ 0 }, m_x2{ 0 }, m_y1{ 0 }, m_y2{ 0 };
+	int64_t m_error{ 0 };
+};
+
+/** SSPO_FIXED_POINT_SIMD
+    The number of 64 bit accumulators FixedPointBiquadLanes works on at once, 4 with AVX2 and
+    2 with SSE4.2, which the 32 x 32 -> 64 bit multiplies and 64 bit compares need. 0 runs
+    every channel through the scalar recurrence instead.
+*/
+#ifndef SSPO_FIXED_POINT_SIMD
+ #if defined(__AVX2__)
+  #define SSPO_FIXED_POINT_SIMD 4
+ #elif defined(__SSE4_2__)
+  #define SSPO_FIXED_POINT_SIMD 2
+ #else
+  #define SSPO_FIXED_POINT_SIMD 0
+ #endif
+#endif
+
+#if SSPO_FIXED_POINT_SIMD > 0
+ #include <immintrin.h>
+#endif
+
+///
+/// \brief The FixedPointBiquadLanes class
+/// Lanes channels of interleaved Q31 frames, as they arrive from the capture hardware,
+/// through the same design at once, bit exact with a FixedPointBiquad per channel.
+/// One channel's recursion is serial, so the parallelism is across the channels, each
+/// group of SSPO_FIXED_POINT_SIMD channels is run through the whole block with its state
+/// held in registers, the channels left over through the scalar recurrence. The compilers
+/// do not vectorise the 64 bit accumulators from plain loops, hence the intrinsics.
+template <int Lanes>
+class FixedPointBiquadLanes
+{
+public:
+	static_assert (Lanes > 0, "at least one channel");
+
+	void setCoeffs (const BiQuad::BiquadCoeffecients& c) noexcept
+	{
+		m_coeffs = fixedPoint::toFixed (c);
+	}
+
+	void clear () noexcept
+	{
+		for (auto l = 0; l < Lanes; ++l)
+		{
+			m_x1[l] = m_x2[l] = m_y1[l] = m_y2[l] = 0;
+			m_error[l] = 0;
+		}
+	}
+
+	/// numFrames frames of Lanes interleaved samples, in place
+	void processBlock (int32_t* frames, int numFrames) noexcept
+	{
+		auto l = 0;
+#if SSPO_FIXED_POINT_SIMD > 0
+		for (; l + SSPO_FIXED_POINT_SIMD <= Lanes; l += SSPO_FIXED_POINT_SIMD) processGroup (frames + l, numFrames, l);
+#endif
+		for (; l < Lanes; ++l) processLane (frames + l, numFrames, l);
+	}
+
+private:
+	/// a whole multiple of 2^31 larger than any accumulator, which is at most 2^62 plus the error
+	static constexpr int64_t k_bias = int64_t{ 3 } << 61;
+
+	void processLane (int32_t* samples, int numFrames, int l) noexcept
+	{
+		const auto bits = 31 - m_coeffs.m_shift;
+		auto x1 = m_x1[l], x2 = m_x2[l], y1 = m_y1[l], y2 = m_y2[l], error = m_error[l];
+		for (auto f = 0; f < numFrames; ++f)
+		{
+			const int64_t in = samples[f * Lanes];
+			const auto acc = error + m_coeffs.m_a0 * in + m_coeffs.m_a1 * x1 + m_coeffs.m_a2 * x2
+				- m_coeffs.m_b1 * y1 - m_coeffs.m_b2 * y2;
+			const auto whole = acc >> bits;
+			error = acc - (whole << bits);
+			const int64_t out = fixedPoint::saturate (whole);
+
+			x2 = x1;
+			x1 = in;
+			y2 = y1;
+			y1 = out;
+			samples[f * Lanes] = static_cast<int32_t> (out);
+		}
+		m_x1[l] = x1;
+		m_x2[l] = x2;
+		m_y1[l] = y1;
+		m_y2[l] = y2;
+		m_error[l] = error;
+	}
+
+#if SSPO_FIXED_POINT_SIMD == 4
+	void processGroup (int32_t* samples, int numFrames, int l) noexcept
+	{
+		const auto bits = _mm_cvtsi32_si128 (31 - m_coeffs.m_shift);
+		const auto a0 = _mm256_set1_epi64x (m_coeffs.m_a0), a1 = _mm256_set1_epi64x (m_coeffs.m_a1);
+		const auto a2 = _mm256_set1_epi64x (m_coeffs.m_a2), b1 = _mm256_set1_epi64x (m_coeffs.m_b1);
+		const auto b2 = _mm256_set1_epi64x (m_coeffs.m_b2);
+		const auto bias = _mm256_set1_epi64x (k_bias);
+		const auto biasWhole = _mm256_set1_epi64x (k_bias >> (31 - m_coeffs.m_shift));
+		const auto mask = _mm256_set1_epi64x ((int64_t{ 1 } << (31 - m_coeffs.m_shift)) - 1);
+		const auto maxOut = _mm256_set1_epi64x (INT32_MAX), minOut = _mm256_set1_epi64x (INT32_MIN);
+		const auto evens = _mm256_setr_epi32 (0, 2, 4, 6, 0, 2, 4, 6);
+
+		auto x1 = load (m_x1 + l), x2 = load (m_x2 + l), y1 = load (m_y1 + l), y2 = load (m_y2 + l);
+		auto error = load (m_error + l);
+		for (auto f = 0; f < numFrames; ++f)
+		{
+			auto* frame = samples + f * Lanes;
+			const auto in = _mm256_cvtepi32_epi64 (_mm_loadu_si128 (reinterpret_cast<const __m128i*> (frame)));
+			auto acc = _mm256_add_epi64 (error, _mm256_mul_epi32 (a0, in));
+			acc = _mm256_add_epi64 (acc, _mm256_mul_epi32 (a1, x1));
+			acc = _mm256_add_epi64 (acc, _mm256_mul_epi32 (a2, x2));
+			acc = _mm256_sub_epi64 (acc, _mm256_mul_epi32 (b1, y1));
+			acc = _mm256_sub_epi64 (acc, _mm256_mul_epi32 (b2, y2));
+
+			// the floor of acc >> bits as a logical shift, there is no 64 bit arithmetic shift before AVX-512
+			const auto biased = _mm256_add_epi64 (acc, bias);
+			auto out = _mm256_sub_epi64 (_mm256_srl_epi64 (biased, bits), biasWhole);
+			error = _mm256_and_si256 (biased, mask);
+			out = _mm256_blendv_epi8 (out, maxOut, _mm256_cmpgt_epi64 (out, maxOut));
+			out = _mm256_blendv_epi8 (out, minOut, _mm256_cmpgt_epi64 (minOut, out));
+
+			x2 = x1;
+			x1 = in;
+			y2 = y1;
+			y1 = out;
+			_mm_storeu_si128 (reinterpret_cast<__m128i*> (frame), _mm256_castsi256_si128 (_mm256_permutevar8x32_epi32 (out, evens)));
+		}
+		store (m_x1 + l, x1);
+		store (m_x2 + l, x2);
+		store (m_y1 + l, y1);
+		store (m_y2 + l, y2);
+		store (m_error + l, error);
+	}
+
+	static __m256i load (const int64_t* p) noexcept { return _mm256_loadu_si256 (reinterpret_cast<const __m256i*> (p)); }
+	static void store (int64_t* p, __m256i v) noexcept { _mm256_storeu_si256 (reinterpret_cast<__m256i*> (p), v); }
+#elif SSPO_FIXED_POINT_SIMD == 2
+	void processGroup (int32_t* samples, int numFrames, int l) noexcept
+	{
+		const auto bits = _mm_cvtsi32_si128 (31 - m_coeffs.m_shift);
+		const auto a0 = _mm_set1_epi64x (m_coeffs.m_a0), a1 = _mm_set1_epi64x (m_coeffs.m_a1);
+		const auto a2 = _mm_set1_epi64x (m_coeffs.m_a2), b1 = _mm_set1_epi64x (m_coeffs.m_b1);
+		const auto b2 = _mm_set1_epi64x (m_coeffs.m_b2);
+		const auto bias = _mm_set1_epi64x (k_bias);
+		const auto biasWhole = _mm_set1_epi64x (k_bias >> (31 - m_coeffs.m_shift));
+		const auto mask = _mm_set1_epi64x ((int64_t{ 1 } << (31 - m_coeffs.m_shift)) - 1);
+		const auto maxOut = _mm_set1_epi64x (INT32_MAX), minOut = _mm_set1_epi64x (INT32_MIN);
+
+		auto x1 = load (m_x1 + l), x2 = load (m_x2 + l), y1 = load (m_y1 + l), y2 = load (m_y2 + l);
+		auto error = load (m_error + l);
+		for (auto f = 0; f < numFrames; ++f)
+		{
+			auto* frame = samples + f * Lanes;
+			const auto in = _mm_cvtepi32_epi64 (_mm_loadl_epi64 (reinterpret_cast<const __m128i*> (frame)));
+			auto acc = _mm_add_epi64 (error, _mm_mul_epi32 (a0, in));
+			acc = _mm_add_epi64 (acc, _mm_mul_epi32 (a1, x1));
+			acc = _mm_add_epi64 (acc, _mm_mul_epi32 (a2, x2));
+			acc = _mm_sub_epi64 (acc, _mm_mul_epi32 (b1, y1));
+			acc = _mm_sub_epi64 (acc, _mm_mul_epi32 (b2, y2));
+
+			// the floor of acc >> bits as a logical shift, there is no 64 bit arithmetic shift before AVX-512
+			const auto biased = _mm_add_epi64 (acc, bias);
+			auto out = _mm_sub_epi64 (_mm_srl_epi64 (biased, bits), biasWhole);
+			error = _mm_and_si128 (biased, mask);
+			out = _mm_blendv_epi8 (out, maxOut, _mm_cmpgt_epi64 (out, maxOut));
+			out = _mm_blendv_epi8 (out, minOut, _mm_cmpgt_epi64 (minOut, out));
+
+			x2 = x1;
+			x1 = in;
+			y2 = y1;
+			y1 = out;
+			_mm_storel_epi64 (reinterpret_cast<__m128i*> (frame), _mm_shuffle_epi32 (out, _MM_SHUFFLE (3, 1, 2, 0)));
+		}
+		store (m_x1 + l, x1);
+		store (m_x2 + l, x2);
+		store (m_y1 + l, y1);
+		store (m_y2 + l, y2);
+		store (m_error + l, error);
+	}
+
+	static __m128i load (const int64_t* p) noexcept { return _mm_loadu_si128 (reinterpret_cast<const __m128i*> (p)); }
+	static void store (int64_t* p, __m128i v) noexcept { _mm_storeu_si128 (reinterpret_cast<__m128i*> (p), v); }
+#endif
+
+	fixedPoint::Coefficients m_coeffs;
+	// sign extended to 64 bits, as the SIMD multiplies read them
+	int64_t m_x1[Lanes]{}, m_x2[Lanes]{}, m_y1[Lanes]{}, m_y2[Lanes]{};
+	int64_t m_error[Lanes]{};
+};
+
+///
+/// \brief The FixedPointFilter class
+/// Any Filter, a MultiFilter of any type or a FilterChain cascade, rebuilt as a series of
+/// FixedPointBiquad sections from its appendStages(). design() allocates, so call it off
+/// the audio thread, then process() is the fixed point equivalent of processBlock().
+/// A nonlinear filter, see Filter::isLinear(), has no equivalent, design() then returns
+/// false and leaves no sections, which passes the input through unchanged.
+class FixedPointFilter
+{
+public:
+	bool design (Filter& filter)
+	{
+		m_sections.clear ();
+		if (!filter.isLinear ()) return false;
+
+		std::vector<BiQuad::BiquadCoeffecients> stages;
+		filter.appendStages (stages);
+		m_sections.resize (stages.size ());
+		for (size_t i = 0; i < stages.size (); ++i) m_sections[i].setCoeffs (stages[i]);
+		return true;
+	}
+
+	void clear () noexcept
+	{
+		for (auto& s : m_sections) s.clear ();
+	}
+
+	int getNumSections () const noexcept
+	{
+		return static_cast<int> (m_sections.size ());
+	}
+
+	void processBlock (int32_t* block, int blockSize) noexcept
+	{
+		for (auto& s : m_sections) s.processBlock (block, blockSize);
+	}
+
+private:
+	std::vector<FixedPointBiquad> m_sections;
+};
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+#include "AudioMath.h"
+#include "Filter.h"
+
+///
+/// \brief The FrequencyResponse class
+/// Evaluates the magnitude and phase of a cascade of biquad stages at a set of
+/// log spaced frequencies. The trig terms for each frequency are computed once
+/// in prepare(), evaluate() is then only multiplies and adds over flat arrays,
+/// written branch free so that the compiler vectorises the loops.
+class FrequencyResponse
+{
+public:
+	void prepare (int numPoints, float minFreq, float maxFreq, float sampleRate)
+	{
+		m_frequencies.resize (numPoints);
+		m_cos1.resize (numPoints);
+		m_sin1.resize (numPoints);
+		m_cos2.resize (numPoints);
+		m_sin2.resize (numPoints);
+		m_re.resize (numPoints);
+		m_im.resize (numPoints);
+		m_magnitudeDb.resize (numPoints);
+		m_phase.resize (numPoints);
+
+		const auto ratio = maxFreq / minFreq;
+		for (auto i = 0; i < numPoints; ++i)
+		{
+			const auto proportion = numPoints > 1 ? i / static_cast<float>(numPoints - 1) : 0.0f;
+			m_frequencies[i] = minFreq * powf (ratio, proportion);
+			const auto w = k_2pi * std::fmin (m_frequencies[i], sampleRate * 0.5f) / sampleRate;
+			m_cos1[i] = cosf (w);
+			m_sin1[i] = sinf (w);
+			m_cos2[i] = cosf (2.0f * w);
+			m_sin2[i] = sinf (2.0f * w);
+		}
+	}
+
+	///
+	/// \brief evaluate
+	/// Computes the response of the stages in series, an empty cascade is unity
+	void evaluate (const std::vector<BiQuad::BiquadCoeffecients>& stages)
+	{
+		const auto n = static_cast<int>(m_frequencies.size ());
+		float* const re = m_re.data ();
+		float* const im = m_im.data ();
+		const float* const c1 = m_cos1.data ();
+		const float* const s1 = m_sin1.data ();
+		const float* const c2 = m_cos2.data ();
+		const float* const s2 = m_sin2.data ();
+
+		for (auto i = 0; i < n; ++i)
+		{
+			re[i] = 1.0f;
+			im[i] = 0.0f;
+		}
+
+		for (const auto& st : stages)
+		{
+			for (auto i = 0; i < n; ++i)
+			{
+				// e^-jw = cos w - j sin w
+				const auto numRe = st.m_a0 + st.m_a1 * c1[i] + st.m_a2 * c2[i];
+				const auto numIm = -(st.m_a1 * s1[i] + st.m_a2 * s2[i]);
+				const auto denRe = 1.0f + st.m_b1 * c1[i] + st.m_b2 * c2[i];
+				const auto denIm = -(st.m_b1 * s1[i] + st.m_b2 * s2[i]);
+				const auto denMag = denRe * denRe + denIm * denIm;
+
+				// H = c0 * num / den + d0
+				const auto hRe = st.m_c0 * (numRe * denRe + numIm * denIm) / denMag + st.m_d0;
+				const auto hIm = st.m_c0 * (numIm * denRe - numRe * denIm) / denMag;
+
+				const auto r = re[i] * hRe - im[i] * hIm;
+				im[i] = re[i] * hIm + im[i] * hRe;
+				re[i] = r;
+			}
+		}
+
+		float* const mag = m_magnitudeDb.data ();
+		for (auto i = 0; i < n; ++i)
+		{
+			mag[i] = 10.0f * log10f (re[i] * re[i] + im[i] * im[i] + 1.0e-20f);
+		}
+
+		float* const phase = m_phase.data ();
+		for (auto i = 0; i < n; ++i)
+		{
+			phase[i] = atan2f (im[i], re[i]);
+		}
+	}
+
+	int size () const noexcept { return static_cast<int>(m_frequencies.size ()); }
+	const std::vector<float>& getFrequencies () const noexcept { return m_frequencies; }
+	const std::vector<float>& getMagnitudeDb () const noexcept { return m_magnitudeDb; }
+	const std::vector<float>& getPhase () const noexcept { return m_phase; }
+
+private:
+	std::vector<float> m_frequencies;
+	std::vector<float> m_cos1, m_sin1, m_cos2, m_sin2;
+	std::vector<float> m_re, m_im;
+	std::vector<float> m_magnitudeDb;
+	std::vector<float> m_phase;
+};
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include "AudioMath.h"
+
+///
+/// \brief The Oversampler2x class
+/// Doubles the sample rate and brings it back down through a pair of polyphase IIR
+/// halfband filters, each two chains of first order allpasses running at the lower rate,
+/// one for the even and one for the odd samples, after Valenzuela and Constantinides as in
+/// Laurent de Soras' HIIR. Eight coefficients with a transition of 0.04 of the higher rate
+/// keep the response flat to within 1e-8 dB up to 0.42 of the lower rate, and take 99 dB
+/// off everything from 0.58 of it, so what is made above the lower rate's Nyquist while
+/// oversampled does not fold back into the audio band. There is no latency to report,
+/// the allpasses only bend the phase near the band edge.
+class Oversampler2x
+{
+public:
+	static constexpr int k_numCoeffs = 8;
+	static constexpr double k_transition = 0.04;
+
+	Oversampler2x ()
+	{
+		clear ();
+	}
+
+	inline void clear () noexcept
+	{
+		m_upX.fill (0.0f);
+		m_upY.fill (0.0f);
+		m_downX.fill (0.0f);
+		m_downY.fill (0.0f);
+	}
+
+	///
+	/// \brief upsample
+	/// One sample in, out[0] and out[1] at twice the rate
+	inline void upsample (float in, float* out) noexcept
+	{
+		auto even = in, odd = in;
+		allpasses (even, odd, m_upX, m_upY);
+		out[0] = even;
+		out[1] = odd;
+	}
+
+	///
+	/// \brief downsample
+	/// in[0] and in[1] at twice the rate, one sample out
+	inline float downsample (const float* in) noexcept
+	{
+		auto even = in[1], odd = in[0];
+		allpasses (even, odd, m_downX, m_downY);
+		return 0.5f * (even + odd);
+	}
+
+	///
+	/// \brief tailLengthSamples
+	/// At the lower rate, how long the up and down filters together ring for, the allpass
+	/// (c + z^-1) / (1 + c z^-1) rings as (1 - c^2) (-c)^(n - 1), the longer path of each counts
+	static double tailLengthSamples (double decayDb = 120.0) noexcept
+	{
+		const auto floor = std::log (std::pow (10.0, -decayDb / 20.0));
+		double paths[2] = { 0.0, 0.0 };
+		for (auto i = 0; i < k_numCoeffs; ++i)
+		{
+			const double c = coeffs ()[i];
+			paths[i % 2] += c > 0.0 ? 1.0 + std::max (0.0, (floor - std::log (1.0 - c * c)) / std::log (c)) : 1.0;
+		}
+		return 2.0 * std::max (paths[0], paths[1]);
+	}
+
+	///
+	/// \brief design
+	/// The allpass coefficients of a halfband with numCoeffs allpasses and the given transition
+	/// band, as a fraction of the higher rate, even indices for the even path. From HIIR's
+	/// PolyphaseIir2Designer, the elliptic filter's nome q, then each coefficient.
+	static void design (double* coeffs, int numCoeffs, double transition) noexcept
+	{
+		constexpr auto pi = static_cast<double> (LD_PI);
+		auto k = std::tan ((1.0 - transition * 2.0) * pi / 4.0);
+		k *= k;
+		const auto kksqrt = std::pow (1.0 - k * k, 0.25);
+		const auto e = 0.5 * (1.0 - kksqrt) / (1.0 + kksqrt);
+		const auto e4 = e * e * e * e;
+		const auto q = e * (1.0 + e4 * (2.0 + e4 * (15.0 + 150.0 * e4)));
+
+		const auto order = numCoeffs * 2 + 1;
+		for (auto index = 0; index < numCoeffs; ++index)
+		{
+			const auto c = index + 1;
+
+			auto num = 0.0, term = 0.0, sign = 1.0;
+			for (auto i = 0; i == 0 || std::fabs (term) > 1.0e-100; ++i, sign = -sign)
+			{
+				term = std::pow (q, i * (i + 1)) * std::sin ((i * 2 + 1) * c * pi / order) * sign;
+				num += term;
+			}
+			num *= std::pow (q, 0.25);
+
+			auto den = 0.5;
+			sign = -1.0;
+			for (auto i = 1; i == 1 || std::fabs (term) > 1.0e-100; ++i, sign = -sign)
+			{
+				term = std::pow (q, i * i) * std::cos (i * 2 * c * pi / order) * sign;
+				den += term;
+			}
+
+			const auto ww = num / den;
+			const auto wwsq = ww * ww;
+			const auto x = std::sqrt ((1.0 - wwsq * k) * (1.0 - wwsq / k)) / (1.0 + wwsq);
+			coeffs[index] = (1.0 - x) / (1.0 + x);
+		}
+	}
+
+	/// the coefficients every Oversampler2x shares, designed the first time one is made
+	static const std::array<float, k_numCoeffs>& coeffs () noexcept
+	{
+		static const auto designed = []
+		{
+			double c[k_numCoeffs];
+			design (c, k_numCoeffs, k_transition);
+			std::array<float, k_numCoeffs> rounded{};
+			for (auto i = 0; i < k_numCoeffs; ++i) rounded[i] = static_cast<float> (c[i]);
+			return rounded;
+		} ();
+		return designed;
+	}
+
+private:
+	using State = std::array<float, k_numCoeffs>;
+
+	/// the two paths side by side, y = c (x - y[n - 1]) + x[n - 1] for each allpass
+	inline void allpasses (float& even, float& odd, State& x, State& y) noexcept
+	{
+		const auto& c = m_coeffs;
+		for (auto i = 0; i < k_numCoeffs; i += 2)
+		{
+			auto nextEven = (even - y[i]) * c[i] + x[i];
+			auto nextOdd = (odd - y[i + 1]) * c[i + 1] + x[i + 1];
+			//check denormal
+			if (!std::isnormal (nextEven)) nextEven = 0.0f;
+			if (!std::isnormal (nextOdd)) nextOdd = 0.0f;
+			x[i] = even;
+			x[i + 1] = odd;
+			y[i] = nextEven;
+			y[i + 1] = nextOdd;
+			even = nextEven;
+			odd = nextOdd;
+		}
+	}
+
+	State m_coeffs{ coeffs () };
+	State m_upX, m_upY, m_downX, m_downY;
+};
@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "Filter.h"
+
+///
+/// \brief The ParallelIirRenderer class
+/// Offline processing of one long channel on several cores. A biquad is linear, so the
+/// signal is cut into a chunk per thread and every chunk is filtered from silence. The true
+/// state at each chunk boundary is then found by a short serial scan, using the section's
+/// 2x2 state transition matrix raised to the chunk length, and each chunk adds on the
+/// decaying response to its true starting state. Cascades are run a section at a time,
+/// with the correction of one section fused into the filtering of the next.
+/// The output is within float rounding of the exact result of the filter's coefficients, as
+/// processBlock's is, but the two round differently. With poles near the unit circle, low
+/// cutoffs at high Q, either can be only 40 to 60 dB from the exact result, and as far from
+/// each other; FilterAccuracyTest holds this to 55 dB. A nonlinear filter, see
+/// Filter::isLinear(), can't be split this way and is run serially through processBlock.
+class ParallelIirRenderer
+{
+public:
+	/// chunks shorter than this are not worth a thread
+	static constexpr int64_t k_minChunkSize = 1 << 15;
+
+	/// numThreads of 0 uses every core
+	explicit ParallelIirRenderer (int numThreads = 0)
+	{
+		m_numThreads = numThreads > 0 ? numThreads : static_cast<int> (std::max (1u, std::thread::hardware_concurrency ()));
+	}
+
+	int getNumThreads () const noexcept { return m_numThreads; }
+
+	///
+	/// \brief process
+	/// Filters numSamples of data in place through the filter's current sections, carrying
+	/// on from, and leaving behind, the filter's state just as processBlock would.
+	/// Not for use on the realtime thread, threads are started on each call.
+	void process (Filter& filter, float* data, int64_t numSamples)
+	{
+		if (data == nullptr || numSamples <= 0) return;
+		if (!filter.isLinear ())
+		{
+			processSerially (filter, data, numSamples);
+			return;
+		}
+
+		std::vector<BiQuad*> biquads;
+		filter.appendBiQuads (biquads);
+		const auto numChunks = static_cast<int> (std::clamp<int64_t> (numSamples / k_minChunkSize, 1, m_numThreads));
+
+		std::vector<int64_t> bounds (numChunks + 1);
+		for (auto k = 0; k <= numChunks; ++k) bounds[k] = numSamples * k / numChunks;
+
+		std::vector<Section> sections (biquads.size ());
+		for (size_t s = 0; s < biquads.size (); ++s)
+		{
+			sections[s].coeffs = biquads[s]->getCoeffs ();
+			sections[s].starts.resize (numChunks + 1);
+			sections[s].ends.resize (numChunks);
+			float z1, z2;
+			biquads[s]->getState (z1, z2);
+			sections[s].starts[0] = { z1, z2 };
+		}
+
+		for (size_t s = 0; s <= sections.size (); ++s)
+		{
+			parallelFor (numChunks, [&] (int k)
+				{
+					auto* chunk = data + bounds[k];
+					const auto length = bounds[k + 1] - bounds[k];
+					if (s > 0 && k > 0) addStateResponse (sections[s - 1], chunk, length, k);
+					// the first chunk knows its true state already, the others start from silence
+					if (s < sections.size ()) run (sections[s], chunk, length, k);
+				});
+			if (s < sections.size ()) scanBoundaries (sections[s], bounds);
+		}
+
+		for (size_t s = 0; s < sections.size (); ++s)
+		{
+			const auto& end = sections[s].starts[numChunks];
+			biquads[s]->setState (static_cast<float> (end.z1), static_cast<float> (end.z2));
+		}
+	}
+
+private:
+	/// in double, the boundary states are sums of long decayed histories that rounding to
+	/// float would detune at every chunk, most of all for poles near the unit circle
+	struct State
+	{
+		double z1{ 0.0 }, z2{ 0.0 };
+	};
+
+	struct Section
+	{
+		BiQuad::BiquadCoeffecients coeffs;
+		std::vector<State> starts;	// the true state at the start of each chunk, and at the end
+		std::vector<State> ends;	// the state each chunk ended in, from silence for all but the first
+	};
+
+	/// the 2x2 matrix taking the state one sample on with no input
+	struct Transition
+	{
+		double m[2][2];
+
+		Transition operator* (const Transition& o) const noexcept
+		{
+			Transition r;
+			for (auto i = 0; i < 2; ++i)
+				for (auto j = 0; j < 2; ++j)
+					r.m[i][j] = m[i][0] * o.m[0][j] + m[i][1] * o.m[1][j];
+			return r;
+		}
+	};
+
+	/// The same transposed canonical form as BiQuad::tick
+	static void run (Section& section, float* block, int64_t length, int chunk) noexcept
+	{
+		const auto& c = section.coeffs;
+		auto z1 = chunk == 0 ? static_cast<float> (section.starts[0].z1) : 0.0f;
+		auto z2 = chunk == 0 ? static_cast<float> (section.starts[0].z2) : 0.0f;
+		for (int64_t i = 0; i < length; ++i)
+		{
+			const auto in = block[i];
+			auto out = z1 + c.m_a0 * in;
+			//check denormal
+			if (!std::isnormal (out)) out = 0.0f;
+			z1 = c.m_a1 * in + z2 - c.m_b1 * out;
+			z2 = c.m_a2 * in - c.m_b2 * out;
+			block[i] = out * c.m_c0 + in * c.m_d0;
+		}
+		section.ends[chunk] = { z1, z2 };
+	}
+
+	///
+	/// \brief scanBoundaries
+	/// The serial step, with no input the state moves on by
+	///   z1' = -b1 z1 + z2, z2' = -b2 z1
+	/// so the true state after a chunk is A^length applied to the state it started
+	/// in, plus the state the chunk reached from silence
+	static void scanBoundaries (Section& section, const std::vector<int64_t>& bounds) noexcept
+	{
+		const auto& c = section.coeffs;
+		const Transition step{ { { -c.m_b1, 1.0 }, { -c.m_b2, 0.0 } } };
+
+		section.starts[1] = section.ends[0];
+		for (size_t k = 1; k < section.ends.size (); ++k)
+		{
+			const auto a = power (step, bounds[k + 1] - bounds[k]);
+			const auto& s = section.starts[k];
+			const auto& e = section.ends[k];
+			section.starts[k + 1] = { a.m[0][0] * s.z1 + a.m[0][1] * s.z2 + e.z1, a.m[1][0] * s.z1 + a.m[1][1] * s.z2 + e.z2 };
+		}
+	}
+
+	static Transition power (Transition a, int64_t n) noexcept
+	{
+		Transition r{ { { 1.0, 0.0 }, { 0.0, 1.0 } } };
+		for (; n > 0; n >>= 1)
+		{
+			if (n & 1) r = r * a;
+			a = a * a;
+		}
+		return r;
+	}
+
+	///
+	/// \brief addStateResponse
+	/// Adds the output due to the chunk's true starting state, stopping once it has decayed
+	/// far below anything a float sample can hold
+	static void addStateResponse (const Section& section, float* block, int64_t length, int chunk) noexcept
+	{
+		const auto& c = section.coeffs;
+		double z1 = section.starts[chunk].z1;
+		double z2 = section.starts[chunk].z2;
+		for (int64_t i = 0; i < length && std::abs (z1) + std::abs (z2) > 1.0e-20; ++i)
+		{
+			const auto out = z1;
+			block[i] += static_cast<float> (out * c.m_c0);
+			z1 = z2 - c.m_b1 * out;
+			z2 = -c.m_b2 * out;
+		}
+	}
+
+	static void processSerially (Filter& filter, float* data, int64_t numSamples)
+	{
+		constexpr int64_t blockSize = 1 << 16;
+		for (int64_t start = 0; start < numSamples; start += blockSize)
+			filter.processBlock (data + start, static_cast<int> (std::min (blockSize, numSamples - start)));
+	}
+
+	template <typename Fn>
+	void parallelFor (int count, Fn&& fn)
+	{
+		std::vector<std::thread> threads;
+		threads.reserve (count);
+		for (auto k = 1; k < count; ++k) threads.emplace_back (fn, k);
+		fn (0);
+		for (auto& t : threads) t.join ();
+	}
+
+	int m_numThreads{ 1 };
+};
@@ -0,0 +1,348 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "AudioProcess.h"
+#include "DspArena.h"
+#include "Filter.h"
+
+///
+/// \brief The ParametricEq class
+/// Up to k_maxBands bands, each any MultiFilter type, over any number of channels. The
+/// bands' settings are published as atomics, from any thread, and the audio thread designs
+/// the bands that changed at the start of each k_chunkSize chunk, without a lock or an
+/// allocation, into a cascade of second order sections with a fixed slot for each. It runs
+/// the chunk through every section before moving on, so each chunk is read and written
+/// once while it is in cache rather than once per band. A band that is off, or a Peak or
+/// shelf at 0dB, has its sections skipped and costs nothing.
+class ParametricEq
+{
+public:
+	static constexpr int k_maxBands = 8;
+	static constexpr int k_maxSectionsPerBand = 2;	// LP24 and HP24 are two
+	static constexpr int k_chunkSize = 256;
+
+	struct Band
+	{
+		bool enabled;
+		int type;	// index into MultiFilter::typeStings ()
+		float freq, Q, gain;
+	};
+
+	ParametricEq ()
+	{
+		for (auto& d : m_designers) d.setDesignOnRealtimeThread (true);
+		for (auto band = 0; band < k_maxBands; ++band) setBand (band, { false, 8, 1000.0f, 0.707f, 0.0f });
+#if SSPO_STATE_SPACE_STEP > 0
+		// impossible coefficients, so the first block designs every kernel it uses
+		for (auto& c : m_kernelCoeffs) c = { NAN, NAN, NAN, NAN, NAN, NAN, NAN };
+#endif
+	}
+
+	///
+	/// \brief prepare
+	/// Sizes the state for numChannels and redesigns every band, not to be called while processing
+	void prepare (int sampleRate, int numChannels)
+	{
+		m_numChannels = std::max (0, numChannels);
+		m_ownedState.assign (stateSize (m_numChannels), { 0.0f, 0.0f });
+		m_state = m_ownedState.data ();
+		redesign (sampleRate);
+	}
+
+	///
+	/// \brief prepare
+	/// As above, with the state for numChannels, stateFootprint (numChannels) bytes, taken
+	/// from arena rather than allocated here, the arena must outlive its use
+	void prepare (int sampleRate, int numChannels, DspArena& arena)
+	{
+		m_numChannels = std::max (0, numChannels);
+		m_ownedState.clear ();
+		m_state = arena.allocateArray<State> (stateSize (m_numChannels));
+		if (m_state == nullptr) m_numChannels = 0;
+		redesign (sampleRate);
+	}
+
+	/// redesigns every band for a new rate, keeping the state, not to be called while processing
+	void setSampleRate (int sampleRate)
+	{
+		redesign (sampleRate);
+	}
+
+	static size_t stateFootprint (int numChannels) noexcept
+	{
+		return DspArena::footprint<State> (stateSize (numChannels));
+	}
+
+	///
+	/// \brief setBand
+	/// Publishes a band's settings, which the audio thread designs at the start of its next
+	/// chunk, lock free so safe on any thread, the audio thread included, though from one
+	/// thread at a time. Changing the type starts the band's filters from silence, as
+	/// MultiFilter does.
+	void setBand (int band, const Band& settings) noexcept
+	{
+		if (band < 0 || band >= k_maxBands) return;
+		auto& target = m_targets[band];
+		target.enabled.store (settings.enabled, std::memory_order_relaxed);
+		target.type.store (settings.type, std::memory_order_relaxed);
+		target.freq.store (settings.freq, std::memory_order_relaxed);
+		target.Q.store (settings.Q, std::memory_order_relaxed);
+		target.gain.store (settings.gain, std::memory_order_relaxed);
+		target.version.fetch_add (1, std::memory_order_release);
+	}
+
+	Band getBand (int band) const noexcept
+	{
+		const auto& target = m_targets[std::min (std::max (band, 0), k_maxBands - 1)];
+		return { target.enabled.load (std::memory_order_relaxed), target.type.load (std::memory_order_relaxed),
+			target.freq.load (std::memory_order_relaxed), target.Q.load (std::memory_order_relaxed), target.gain.load (std::memory_order_relaxed) };
+	}
+
+	/// the sections the audio thread runs for the current settings, summed over the bands,
+	/// designed here, not for use on the audio thread and from one thread at a time
+	int getNumActiveSections ()
+	{
+		auto total = 0;
+		BiQuad::BiquadCoeffecients sections[k_maxSectionsPerBand];
+		for (auto band = 0; band < k_maxBands; ++band)
+		{
+			const auto n = probeBand (band, sections);
+			for (auto s = 0; s < n; ++s) total += isFlat (sections[s]) ? 0 : 1;
+		}
+		return total;
+	}
+
+	/// the tail of the whole cascade, as Filter::getTailLengthSamples, designed here, not for
+	/// use on the audio thread and from one thread at a time
+	double getTailLengthSamples (double decayDb = 120.0)
+	{
+		auto samples = 0.0;
+		BiQuad::BiquadCoeffecients sections[k_maxSectionsPerBand];
+		for (auto band = 0; band < k_maxBands; ++band)
+		{
+			const auto n = probeBand (band, sections);
+			for (auto s = 0; s < n; ++s)
+				if (!isFlat (sections[s])) samples += BiQuad::tailLengthSamples (sections[s], decayDb);
+		}
+		return samples;
+	}
+
+	/// audio thread
+	void clear () noexcept
+	{
+		std::fill (m_state, m_state + stateSize (m_numChannels), State{ 0.0f, 0.0f });
+	}
+
+	///
+	/// \brief process
+	/// Runs the cascade from in to out, which may be the same channels, on the audio thread
+	void process (const ConstAudioSpan& in, const AudioSpan& out) noexcept
+	{
+		const auto numChannels = std::min ({ in.numChannels, out.numChannels, m_numChannels });
+		const auto numSamples = std::min (in.numSamples, out.numSamples);
+		for (auto start = 0; start < numSamples; start += k_chunkSize)
+		{
+			takeChanges ();
+			const auto n = std::min (k_chunkSize, numSamples - start);
+			for (auto c = 0; c < numChannels; ++c)
+			{
+				auto* state = m_state + static_cast<size_t> (c) * k_maxSections;
+				const auto* src = in.channel (c) + start;
+				auto* dst = out.channel (c) + start;
+				for (auto index = 0; index < k_maxSections; ++index)
+				{
+					if (!m_active[index]) continue;
+					runSection (index, m_sections[index], src, dst, n, state[index]);
+					src = dst;
+				}
+				// no band has any sections
+				if (src != dst) std::copy (src, src + n, dst);
+			}
+		}
+	}
+
+	void process (const AudioSpan& block) noexcept
+	{
+		process (ConstAudioSpan{ block.channels, block.numChannels, block.numSamples }, block);
+	}
+
+private:
+	static constexpr int k_maxSections = k_maxBands * k_maxSectionsPerBand;
+
+	/// a band's settings as published, version changes after the rest are written
+	struct Target
+	{
+		std::atomic<bool> enabled{ false };
+		std::atomic<int> type{ 0 };
+		std::atomic<float> freq{ 1000.0f };
+		std::atomic<float> Q{ 0.707f };
+		std::atomic<float> gain{ 0.0f };
+		std::atomic<uint32_t> version{ 0 };
+	};
+
+	struct State
+	{
+		float z1, z2;
+	};
+
+	static size_t stateSize (int numChannels) noexcept
+	{
+		return static_cast<size_t> (std::max (0, numChannels)) * k_maxSections;
+	}
+
+	/// a Peak or shelf at 0dB passes the input straight through
+	static bool isFlat (const BiQuad::BiquadCoeffecients& c) noexcept
+	{
+		return c.m_c0 == 0.0f && c.m_d0 == 1.0f;
+	}
+
+	void redesign (int sampleRate)
+	{
+		for (auto& d : m_designers) d.setSampleRate (sampleRate);
+		m_probe.setSampleRate (sampleRate);
+		for (auto band = 0; band < k_maxBands; ++band) designBand (band);
+	}
+
+	/// the sections a band runs, designed by the probe from its published settings
+	int probeBand (int band, BiQuad::BiquadCoeffecients* sections)
+	{
+		const auto settings = getBand (band);
+		if (!settings.enabled || !m_probe.setTypeIndex (settings.type, settings.freq, settings.Q, settings.gain)) return 0;
+		return m_probe.copyStages (sections, k_maxSectionsPerBand);
+	}
+
+	///
+	/// \brief designBand
+	/// Designs a band from its published settings into its fixed slots, on the audio thread
+	/// or while not processing. A slot that starts running again, a band that changed type
+	/// or was switched on, starts from silence.
+	void designBand (int band) noexcept
+	{
+		auto& target = m_targets[band];
+		m_versions[band] = target.version.load (std::memory_order_acquire);
+		const auto settings = getBand (band);
+
+		BiQuad::BiquadCoeffecients designed[k_maxSectionsPerBand];
+		auto numSections = 0;
+		if (settings.enabled)
+		{
+			auto& designer = m_designers[band];
+			const auto restart = settings.type != designer.getTypeIndex () || !m_enabled[band];
+			if (designer.setTypeIndex (settings.type, settings.freq, settings.Q, settings.gain))
+				numSections = designer.copyStages (designed, k_maxSectionsPerBand);
+			if (restart) clearBand (band);
+		}
+		m_enabled[band] = settings.enabled;
+
+		for (auto s = 0; s < k_maxSectionsPerBand; ++s)
+		{
+			const auto index = band * k_maxSectionsPerBand + s;
+			const auto active = s < numSections && !isFlat (designed[s]);
+			if (active && !m_active[index]) clearSection (index);
+			m_active[index] = active;
+			if (!active) continue;
+			m_sections[index] = designed[s];
+#if SSPO_STATE_SPACE_STEP > 0
+			const auto& c = m_sections[index];
+			if (std::memcmp (&c, &m_kernelCoeffs[index], sizeof (BiQuad::BiquadCoeffecients)) != 0)
+			{
+				m_kernelCoeffs[index] = c;
+				m_kernels[index].design (c.m_a0, c.m_a1, c.m_a2, c.m_b1, c.m_b2, c.m_c0, c.m_d0);
+			}
+#endif
+		}
+	}
+
+	/// redesigns the bands whose settings have been published since they were last designed
+	void takeChanges () noexcept
+	{
+		for (auto band = 0; band < k_maxBands; ++band)
+			if (m_targets[band].version.load (std::memory_order_acquire) != m_versions[band]) designBand (band);
+	}
+
+	void clearSection (int index) noexcept
+	{
+		for (auto c = 0; c < m_numChannels; ++c) m_state[static_cast<size_t> (c) * k_maxSections + index] = { 0.0f, 0.0f };
+	}
+
+	void clearBand (int band) noexcept
+	{
+		for (auto s = 0; s < k_maxSectionsPerBand; ++s) clearSection (band * k_maxSectionsPerBand + s);
+	}
+
+	/// as BiQuad::tickBlock, with the coefficients and state held here
+	void runSection (int index, const BiQuad::BiquadCoeffecients& c, const float* in, float* out, int n, State& state) const noexcept
+	{
+		auto done = 0;
+#if SSPO_STATE_SPACE_STEP > 0
+		const auto numSteps = n / SSPO_STATE_SPACE_STEP;
+		m_kernels[index].process (in, out, numSteps, state.z1, state.z2);
+		done = numSteps * SSPO_STATE_SPACE_STEP;
+#else
+		(void) index;
+#endif
+		auto z1 = state.z1;
+		auto z2 = state.z2;
+		for (auto i = done; i < n; ++i)
+		{
+			const auto x = in[i];
+			float y = z1 + c.m_a0 * x;
+			//check denormal
+			if (!std::isnormal (y)) y = 0.0f;
+			z1 = c.m_a1 * x + z2 - c.m_b1 * y;
+			z2 = c.m_a2 * x - c.m_b2 * y;
+			out[i] = y * c.m_c0 + x * c.m_d0;
+		}
+		state = { z1, z2 };
+	}
+
+	// the settings as published, on any thread, and a probe designing them off to one side
+	// for the queries from outside the audio thread
+	std::array<Target, k_maxBands> m_targets;
+	MultiFilter m_probe;
+	std::vector<State> m_ownedState;	// when prepare is not given an arena
+
+	// the audio thread's, sized by prepare, on cache lines apart from the published settings,
+	// a designer for each band, designing on the audio thread, and the cascade it designs.
+	// The designers are held here rather than each in its own allocation, so an eq made in a
+	// DspArena has them there too.
+	alignas (SSPO_CACHE_LINE) int m_numChannels{ 0 };
+	State* m_state{ nullptr };	// [channel][band][section]
+	uint32_t m_versions[k_maxBands]{};
+	bool m_enabled[k_maxBands]{};
+	bool m_active[k_maxSections]{};
+	BiQuad::BiquadCoeffecients m_sections[k_maxSections]{};
+	std::array<MultiFilter, k_maxBands> m_designers;
+#if SSPO_STATE_SPACE_STEP > 0
+	BiQuad::BiquadCoeffecients m_kernelCoeffs[k_maxSections];
+	StateSpaceKernel<SSPO_STATE_SPACE_STEP> m_kernels[k_maxSections];
+#endif
+};
@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "Filter.h"
+
+///
+/// A preset bank file holds filter presets along with their coefficients,
+/// designed ahead of time for each of a set of sample rates, so that a bank
+/// can be memory mapped read only and a preset switched to with no parsing
+/// or design work. The layout, in native byte order, is
+///   PresetBankHeader
+///   uint32_t sampleRates[numSampleRates]
+///   PresetBankEntry entries[numPresets]
+///   PresetStages stages[numPresets][numSampleRates]
+///
+namespace presetbank
+{
+	constexpr char k_magic[4] = { 'S', 'S', 'P', 'B' };
+	constexpr uint32_t k_version = 1;
+	constexpr int k_maxStages = 2;
+	constexpr int k_nameLength = 32;
+
+	struct PresetBankHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t numPresets;
+		uint32_t numSampleRates;
+		uint32_t maxStages;
+		uint32_t reserved[3];
+	};
+
+	struct PresetBankEntry
+	{
+		char name[k_nameLength];	// null terminated
+		int32_t type;				// index into MultiFilter::typeStings ()
+		float cutoff;
+		float res;
+		float gain;
+	};
+
+	struct PresetStages
+	{
+		uint32_t numStages;
+		BiQuad::BiquadCoeffecients stages[k_maxStages];
+	};
+
+	static_assert (sizeof (PresetBankHeader) == 32, "bank layout must not depend on the compiler");
+	static_assert (sizeof (PresetBankEntry) == 48, "bank layout must not depend on the compiler");
+	static_assert (sizeof (PresetStages) == 4 + k_maxStages * 7 * 4, "bank layout must not depend on the compiler");
+}
+
+///
+/// \brief The PresetBankView class
+/// Read only access to a preset bank already in memory, typically memory mapped.
+/// Nothing is copied, every accessor returns a pointer into the bank's data.
+class PresetBankView
+{
+public:
+	///
+	/// \brief open
+	/// Checks the data holds a complete bank, returns false, leaving the view
+	/// empty, if it doesn't. The data must outlive the view.
+	bool open (const void* data, size_t size) noexcept
+	{
+		using namespace presetbank;
+		*this = PresetBankView ();
+
+		if (data == nullptr || size < sizeof (PresetBankHeader)) return false;
+		const auto* header = static_cast<const PresetBankHeader*> (data);
+		if (std::memcmp (header->magic, k_magic, sizeof (k_magic)) != 0) return false;
+		if (header->version != k_version || header->maxStages != k_maxStages) return false;
+
+		const auto numPresets = static_cast<size_t> (header->numPresets);
+		const auto numRates = static_cast<size_t> (header->numSampleRates);
+		const auto required = sizeof (PresetBankHeader) + numRates * sizeof (uint32_t)
+			+ numPresets * sizeof (PresetBankEntry) + numPresets * numRates * sizeof (PresetStages);
+		if (size < required) return false;
+
+		const auto* bytes = static_cast<const char*> (data) + sizeof (PresetBankHeader);
+		m_sampleRates = reinterpret_cast<const uint32_t*> (bytes);
+		bytes += numRates * sizeof (uint32_t);
+		m_entries = reinterpret_cast<const PresetBankEntry*> (bytes);
+		bytes += numPresets * sizeof (PresetBankEntry);
+		m_stages = reinterpret_cast<const PresetStages*> (bytes);
+		m_numPresets = static_cast<int> (numPresets);
+		m_numSampleRates = static_cast<int> (numRates);
+		return true;
+	}
+
+	bool isOpen () const noexcept { return m_entries != nullptr; }
+	int getNumPresets () const noexcept { return m_numPresets; }
+	int getNumSampleRates () const noexcept { return m_numSampleRates; }
+
+	const presetbank::PresetBankEntry* getEntry (int preset) const noexcept
+	{
+		return preset >= 0 && preset < m_numPresets ? m_entries + preset : nullptr;
+	}
+
+	/// the index of a sample rate in the bank, -1 if the bank wasn't designed for it
+	int findSampleRate (int sampleRate) const noexcept
+	{
+		for (auto i = 0; i < m_numSampleRates; ++i)
+		{
+			if (static_cast<int> (m_sampleRates[i]) == sampleRate) return i;
+		}
+		return -1;
+	}
+
+	/// Realtime safe, the coefficients of a preset at a sample rate
+	const presetbank::PresetStages* getStages (int preset, int sampleRateIndex) const noexcept
+	{
+		if (preset < 0 || preset >= m_numPresets || sampleRateIndex < 0 || sampleRateIndex >= m_numSampleRates) return nullptr;
+		return m_stages + static_cast<size_t> (preset) * m_numSampleRates + sampleRateIndex;
+	}
+
+private:
+	const uint32_t* m_sampleRates{ nullptr };
+	const presetbank::PresetBankEntry* m_entries{ nullptr };
+	const presetbank::PresetStages* m_stages{ nullptr };
+	int m_numPresets{ 0 };
+	int m_numSampleRates{ 0 };
+};
+
+///
+/// \brief The PresetBankWriter class
+/// Designs each preset at each sample rate and writes a bank file. Only linear types can be
+/// stored as coefficients, write() fails on a preset of a nonlinear type, the Ladder.
+class PresetBankWriter
+{
+public:
+	struct Preset
+	{
+		std::string name;
+		int type;
+		float cutoff;
+		float res;
+		float gain;
+	};
+
+	void addPreset (const Preset& preset) { m_presets.push_back (preset); }
+	void addSampleRate (int sampleRate) { m_sampleRates.push_back (static_cast<uint32_t> (sampleRate)); }
+
+	bool write (const std::string& path) const
+	{
+		using namespace presetbank;
+		const auto numTypes = static_cast<int> (MultiFilter::typeStings ().size ());
+
+		PresetBankHeader header{};
+		std::memcpy (header.magic, k_magic, sizeof (k_magic));
+		header.version = k_version;
+		header.numPresets = static_cast<uint32_t> (m_presets.size ());
+		header.numSampleRates = static_cast<uint32_t> (m_sampleRates.size ());
+		header.maxStages = k_maxStages;
+
+		MultiFilter designer;
+		std::vector<PresetBankEntry> entries;
+		for (const auto& p : m_presets)
+		{
+			if (p.type < 0 || p.type >= numTypes || !designer.isLinear (p.type)) return false;
+			PresetBankEntry entry{};
+			std::strncpy (entry.name, p.name.c_str (), k_nameLength - 1);
+			entry.type = p.type;
+			entry.cutoff = p.cutoff;
+			entry.res = p.res;
+			entry.gain = p.gain;
+			entries.push_back (entry);
+		}
+
+		std::vector<PresetStages> stages;
+		std::vector<BiQuad::BiquadCoeffecients> designed;
+		for (const auto& p : m_presets)
+		{
+			for (auto sampleRate : m_sampleRates)
+			{
+				designer.setSampleRate (static_cast<int> (sampleRate));
+				designer.setTypeIndex (p.type, p.cutoff, p.res, p.gain);
+				designed.clear ();
+				designer.appendStages (designed);
+				if (designed.size () > static_cast<size_t> (k_maxStages)) return false;
+
+				PresetStages s{};
+				s.numStages = static_cast<uint32_t> (designed.size ());
+				std::copy (designed.begin (), designed.end (), s.stages);
+				stages.push_back (s);
+			}
+		}
+
+		std::ofstream file (path, std::ios::binary | std::ios::trunc);
+		if (!file) return false;
+		file.write (reinterpret_cast<const char*> (&header), sizeof (header));
+		file.write (reinterpret_cast<const char*> (m_sampleRates.data ()), m_sampleRates.size () * sizeof (uint32_t));
+		file.write (reinterpret_cast<const char*> (entries.data ()), entries.size () * sizeof (PresetBankEntry));
+		file.write (reinterpret_cast<const char*> (stages.data ()), stages.size () * sizeof (PresetStages));
+		return static_cast<bool> (file);
+	}
+
+private:
+	std::vector<Preset> m_presets;
+	std::vector<uint32_t> m_sampleRates;
+};
+
+///
+/// \brief The PresetCascade class
+/// Runs a preset's precomputed stages, the same transposed canonical form as
+/// BiQuad::tick, reading the coefficients straight from the bank
+class PresetCascade
+{
+public:
+	void clear () noexcept
+	{
+		for (auto& z : m_state) z = { 0.0f, 0.0f };
+	}
+
+	void processBlock (float* block, int blockSize, const presetbank::PresetStages& stages) noexcept
+	{
+		if (block == nullptr) return;
+		const auto numStages = std::min (static_cast<int> (stages.numStages), presetbank::k_maxStages);
+
+		for (auto s = 0; s < numStages; ++s)
+		{
+			const auto& c = stages.stages[s];
+			auto z1 = m_state[s].z1;
+			auto z2 = m_state[s].z2;
+			for (auto i = 0; i < blockSize; ++i)
+			{
+				const auto in = block[i];
+				auto out = z1 + c.m_a0 * in;
+				//check denormal
+				if (!std::isnormal (out)) out = 0.0f;
+				z1 = c.m_a1 * in + z2 - c.m_b1 * out;
+				z2 = c.m_a2 * in - c.m_b2 * out;
+				block[i] = out * c.m_c0 + in * c.m_d0;
+			}
+			m_state[s] = { z1, z2 };
+		}
+	}
+
+private:
+	struct State
+	{
+		float z1, z2;
+	};
+	State m_state[presetbank::k_maxStages]{};
+};
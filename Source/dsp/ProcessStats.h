@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#pragma once
+
+/** SSPO_ENABLE_PROCESS_STATS
+	Times every processBlock call, set to 0 in the project's preprocessor
+	definitions to compile the instrumentation out entirely.
+*/
+#ifndef SSPO_ENABLE_PROCESS_STATS
+ #define SSPO_ENABLE_PROCESS_STATS 1
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+///
+/// \brief The ProcessStats class
+/// Lock free timing statistics for a realtime process callback.
+/// The audio thread is the only writer, calling addBlock() (or using ScopedBlock)
+/// once per block, any other thread may read a Snapshot at any time.
+/// The cost of each block is recorded in a histogram of the fraction of the
+/// block's deadline, that is the time the block of samples represents, used.
+/// The buckets are log spaced, a quarter octave wide, from 0.006% to 400%.
+class ProcessStats
+{
+public:
+	static constexpr int k_bucketsPerOctave = 4;
+	static constexpr int k_minLoadLog2 = -14;
+	static constexpr int k_maxLoadLog2 = 2;
+	static constexpr int k_numBuckets = (k_maxLoadLog2 - k_minLoadLog2) * k_bucketsPerOctave;
+
+	/// the load at the top of a histogram bucket
+	static double bucketUpperLoad (int bucket) noexcept
+	{
+		return std::exp2 (k_minLoadLog2 + (bucket + 1) / static_cast<double>(k_bucketsPerOctave));
+	}
+
+	struct Snapshot
+	{
+		uint64_t blocks{ 0 };
+		uint64_t samples{ 0 };
+		uint64_t overruns{ 0 };			// blocks over budget
+		double meanBlockSeconds{ 0.0 };
+		double maxBlockSeconds{ 0.0 };
+		double nsPerSample{ 0.0 };
+		double meanLoad{ 0.0 };			// mean fraction of the deadline used
+		double maxLoad{ 0.0 };
+		float budget{ 1.0f };
+		std::array<uint32_t, k_numBuckets> histogram{};
+
+		/// the load at or below which the given proportion (0 - 1) of blocks fell
+		double loadPercentile (double proportion) const noexcept
+		{
+			if (blocks == 0) return 0.0;
+			const auto target = static_cast<uint64_t>(proportion * static_cast<double>(blocks));
+			uint64_t count = 0;
+			for (auto i = 0; i < k_numBuckets; ++i)
+			{
+				count += histogram[i];
+				if (count > target) return std::min (bucketUpperLoad (i), maxLoad);
+			}
+			return maxLoad;
+		}
+	};
+
+	///
+	/// \brief The ScopedBlock class
+	/// Times its own lifetime, and adds it to the stats as one block
+	class ScopedBlock
+	{
+	public:
+		ScopedBlock (ProcessStats& stats, int numSamples) noexcept
+			: m_stats (stats), m_numSamples (numSamples), m_start (now ())
+		{
+		}
+
+		~ScopedBlock () noexcept
+		{
+			m_stats.addBlock (now () - m_start, m_numSamples);
+		}
+
+		ScopedBlock (const ScopedBlock&) = delete;
+		ScopedBlock& operator= (const ScopedBlock&) = delete;
+
+	private:
+		ProcessStats& m_stats;
+		const int m_numSamples;
+		const uint64_t m_start;
+	};
+
+	ProcessStats ()
+	{
+		reset ();
+	}
+
+	///
+	/// \brief prepare
+	/// Call before processing starts, not concurrently with addBlock()
+	void prepare (double sampleRate)
+	{
+		if (sampleRate > 0.0) m_ticksPerSample = ticksPerSecond () / sampleRate;
+	}
+
+	/// the fraction of the deadline a block may use before counting as an overrun
+	void setBudget (float fractionOfDeadline) noexcept
+	{
+		m_budget.store (std::max (0.0f, fractionOfDeadline));
+	}
+
+	float getBudget () const noexcept
+	{
+		return m_budget.load ();
+	}
+
+	void addBlock (uint64_t ticks, int numSamples) noexcept
+	{
+		if (numSamples <= 0) return;
+
+		const auto load = static_cast<double>(ticks) / (numSamples * m_ticksPerSample);
+		const auto position = (std::log2 (std::max (load, 1.0e-9)) - k_minLoadLog2) * k_bucketsPerOctave;
+		const auto bucket = std::clamp (static_cast<int>(position), 0, k_numBuckets - 1);
+
+		// single writer, so plain load / store pairs are enough
+		bump (m_histogram[bucket], 1u);
+		bump (m_blocks, uint64_t{ 1 });
+		bump (m_samples, static_cast<uint64_t>(numSamples));
+		bump (m_ticks, ticks);
+		if (ticks > m_maxTicks.load (std::memory_order_relaxed)) m_maxTicks.store (ticks, std::memory_order_relaxed);
+		if (load > m_maxLoad.load (std::memory_order_relaxed)) m_maxLoad.store (load, std::memory_order_relaxed);
+		if (load > m_budget.load (std::memory_order_relaxed)) bump (m_overruns, uint64_t{ 1 });
+		bump (m_loadSum, load);
+	}
+
+	/// Safe to call from any thread, the counters are read individually so may
+	/// be off by a block relative to each other.
+	Snapshot getSnapshot () const noexcept
+	{
+		Snapshot s;
+		s.blocks = m_blocks.load (std::memory_order_relaxed);
+		s.samples = m_samples.load (std::memory_order_relaxed);
+		s.overruns = m_overruns.load (std::memory_order_relaxed);
+		s.budget = m_budget.load (std::memory_order_relaxed);
+		s.maxLoad = m_maxLoad.load (std::memory_order_relaxed);
+		for (auto i = 0; i < k_numBuckets; ++i) s.histogram[i] = m_histogram[i].load (std::memory_order_relaxed);
+
+		const auto secondsPerTick = 1.0 / ticksPerSecond ();
+		const auto ticks = static_cast<double>(m_ticks.load (std::memory_order_relaxed));
+		s.maxBlockSeconds = m_maxTicks.load (std::memory_order_relaxed) * secondsPerTick;
+		if (s.blocks > 0)
+		{
+			s.meanBlockSeconds = ticks * secondsPerTick / s.blocks;
+			s.meanLoad = m_loadSum.load (std::memory_order_relaxed) / s.blocks;
+		}
+		if (s.samples > 0) s.nsPerSample = ticks * secondsPerTick * 1.0e9 / s.samples;
+		return s;
+	}
+
+	/// Clears the counters, a block being added concurrently may be partly lost
+	void reset () noexcept
+	{
+		for (auto& h : m_histogram) h.store (0);
+		m_blocks.store (0);
+		m_samples.store (0);
+		m_ticks.store (0);
+		m_maxTicks.store (0);
+		m_overruns.store (0);
+		m_loadSum.store (0.0);
+		m_maxLoad.store (0.0);
+	}
+
+	/// a timestamp in nanoseconds, steady_clock reads the cpu's invariant
+	/// timestamp counter where there is one, already scaled, so the rate is
+	/// known up front rather than measured by spinning the calling thread
+	static inline uint64_t now () noexcept
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now ().time_since_epoch ()).count ());
+	}
+
+	/// the rate now() counts at
+	static constexpr double ticksPerSecond () noexcept
+	{
+		return 1.0e9;
+	}
+
+private:
+	template <typename T>
+	static inline void bump (std::atomic<T>& a, T amount) noexcept
+	{
+		a.store (a.load (std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+	}
+
+	double m_ticksPerSample{ ticksPerSecond () / 44100.0 };
+	std::atomic<float> m_budget{ 1.0f };
+
+	std::array<std::atomic<uint32_t>, k_numBuckets> m_histogram;
+	std::atomic<uint64_t> m_blocks;
+	std::atomic<uint64_t> m_samples;
+	std::atomic<uint64_t> m_ticks;
+	std::atomic<uint64_t> m_maxTicks;
+	std::atomic<uint64_t> m_overruns;
+	std::atomic<double> m_loadSum;
+	std::atomic<double> m_maxLoad;
+};
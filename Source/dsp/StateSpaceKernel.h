@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#pragma once
+
+#include <cfloat>
+#include <cmath>
+
+///
+/// \brief The StateSpaceKernel struct
+/// Runs a transposed canonical form biquad N samples at a time. Sample by sample each
+/// output waits on the one before through z1, instead the N outputs and the next state
+/// are written directly in terms of the state and the N inputs,
+///   [y ; z'] = [C ; A] z + [D ; B] x
+/// where D is the lower triangular matrix of the impulse response and A is the state
+/// transition over N samples. Stacking the outputs over the next state makes every one of
+/// the N + 2 columns a vertical vector, so a step is only broadcast multiply adds across
+/// whole SIMD registers, with no horizontal sums, and only the two state lanes are carried
+/// from one step to the next. That is more multiplies than tick() but most of them are
+/// independent of the state.
+/// The coefficients are as BiQuad::BiquadCoeffecients,
+///   H(z) = c0 * (a0 + a1 z^-1 + a2 z^-2) / (1 + b1 z^-1 + b2 z^-2) + d0
+template <int N>
+struct StateSpaceKernel
+{
+	static_assert (N == 4 || N == 8, "the step size should fill whole SIMD registers");
+
+	/// the N outputs then the 2 state variables, padded to whole registers
+	static constexpr int k_lanes = (N + 2 + 3) / 4 * 4;
+
+	///
+	/// \brief design
+	/// Builds the columns by running the recurrence, in double precision, from a unit
+	/// state and from an impulse at each input position
+	void design (float a0, float a1, float a2, float b1, float b2, float c0, float d0) noexcept
+	{
+		struct Recurrence
+		{
+			double a0, a1, a2, b1, b2, c0, d0;
+
+			double step (double in, double& z1, double& z2) const noexcept
+			{
+				const auto out = z1 + a0 * in;
+				z1 = a1 * in + z2 - b1 * out;
+				z2 = a2 * in - b2 * out;
+				return out * c0 + in * d0;
+			}
+		};
+		const Recurrence r{ a0, a1, a2, b1, b2, c0, d0 };
+
+		auto fill = [&r] (float* column, double in, int inputAt, double z1, double z2)
+		{
+			for (auto n = 0; n < N; ++n) column[n] = static_cast<float> (r.step (n == inputAt ? in : 0.0, z1, z2));
+			column[N] = static_cast<float> (z1);
+			column[N + 1] = static_cast<float> (z2);
+			for (auto n = N + 2; n < k_lanes; ++n) column[n] = 0.0f;
+		};
+
+		fill (m_state[0], 0.0, -1, 1.0, 0.0);
+		fill (m_state[1], 0.0, -1, 0.0, 1.0);
+		for (auto j = 0; j < N; ++j) fill (m_input[j], 1.0, j, 0.0, 0.0);
+	}
+
+	///
+	/// \brief process
+	/// Filters numSteps * N samples in place, carrying the state in z1 and z2
+	void process (float* block, int numSteps, float& z1, float& z2) const noexcept
+	{
+		process (block, block, numSteps, z1, z2);
+	}
+
+	///
+	/// \brief process
+	/// Filters numSteps * N samples from in to out, which may be the same block, as each
+	/// step reads all of its inputs before writing any output
+	void process (const float* in, float* out, int numSteps, float& z1, float& z2) const noexcept
+	{
+		// the columns through restrict pointers, so the compiler knows writing the block can't
+		// change them and keeps them in registers, rather than copying the kernel each call
+		const float* __restrict input = &m_input[0][0];
+		const float* __restrict state = &m_state[0][0];
+		auto s1 = z1;
+		auto s2 = z2;
+		for (auto step = 0; step < numSteps; ++step, in += N, out += N)
+		{
+			// the inputs' part doesn't wait on the state
+			alignas (32) float acc[k_lanes];
+			for (auto n = 0; n < k_lanes; ++n) acc[n] = in[0] * input[n];
+			for (auto j = 1; j < N; ++j)
+			{
+				const auto x = in[j];
+				for (auto n = 0; n < k_lanes; ++n) acc[n] += x * input[j * k_lanes + n];
+			}
+			for (auto n = 0; n < k_lanes; ++n) acc[n] += s1 * state[n] + s2 * state[k_lanes + n];
+
+			for (auto n = 0; n < N; ++n) out[n] = acc[n];
+			// the per sample denormal check in tick() becomes one per step on the state
+			s1 = std::fabs (acc[N]) < FLT_MIN ? 0.0f : acc[N];
+			s2 = std::fabs (acc[N + 1]) < FLT_MIN ? 0.0f : acc[N + 1];
+		}
+		z1 = s1;
+		z2 = s2;
+	}
+
+	alignas (32) float m_state[2][k_lanes];	// outputs and next state from each state variable
+	alignas (32) float m_input[N][k_lanes];	// outputs and next state from each input
+};
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#pragma once
+
+#include <array>
+#include <atomic>
+
+///
+/// \brief The TripleBuffer class
+/// Hands the latest value from one writer thread to one reader thread without
+/// either ever waiting. The writer fills getWriteBuffer() then publish()es it,
+/// the reader calls update() and, if it returns true, reads getReadBuffer().
+/// Frames published faster than the reader updates are simply overwritten.
+template <typename T>
+class TripleBuffer
+{
+public:
+	/// writer thread only
+	T& getWriteBuffer () noexcept
+	{
+		return m_buffers[m_writeIndex];
+	}
+
+	/// writer thread only, makes the write buffer the latest value
+	void publish () noexcept
+	{
+		const auto previous = m_middle.exchange (m_writeIndex | k_fresh, std::memory_order_acq_rel);
+		m_writeIndex = previous & k_indexMask;
+	}
+
+	/// reader thread only, returns true if a newer value has been published
+	bool update () noexcept
+	{
+		if ((m_middle.load (std::memory_order_relaxed) & k_fresh) == 0) return false;
+		const auto previous = m_middle.exchange (m_readIndex, std::memory_order_acq_rel);
+		m_readIndex = previous & k_indexMask;
+		return true;
+	}
+
+	/// reader thread only
+	const T& getReadBuffer () const noexcept
+	{
+		return m_buffers[m_readIndex];
+	}
+
+private:
+	static constexpr int k_indexMask = 3;
+	static constexpr int k_fresh = 4;
+
+	std::array<T, 3> m_buffers{};
+	int m_writeIndex{ 0 };
+	std::atomic<int> m_middle{ 1 };
+	int m_readIndex{ 2 };
+	static_assert (std::atomic<int>::is_always_lock_free);
+};
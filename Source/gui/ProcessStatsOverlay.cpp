@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include "ProcessStatsOverlay.h"
+
+#if SSPO_ENABLE_PROCESS_STATS
+
+ProcessStatsOverlay::ProcessStatsOverlay (ProcessStats& stats) : m_stats (stats)
+{
+	startTimerHz (4);
+}
+
+ProcessStatsOverlay::~ProcessStatsOverlay ()
+{
+	stopTimer ();
+}
+
+void ProcessStatsOverlay::paint (Graphics& g)
+{
+	const auto percent = [](double load) { return String (load * 100.0, 2) + "%"; };
+
+	g.setFont (11.0f);
+	g.setColour (m_snapshot.overruns > 0 ? Colours::orange : Colours::whitesmoke.withAlpha (0.6f));
+
+	const auto line1 = "CPU " + percent (m_snapshot.meanLoad)
+		+ "  p99.9 " + percent (m_snapshot.loadPercentile (0.999))
+		+ "  max " + percent (m_snapshot.maxLoad);
+	const auto line2 = String (m_snapshot.nsPerSample, 1) + " ns/sample  "
+		+ String (static_cast<int64>(m_snapshot.overruns)) + " over " + percent (m_snapshot.budget);
+
+	auto area = getLocalBounds ();
+	g.drawText (line1, area.removeFromTop (area.getHeight () / 2), Justification::centredLeft, false);
+	g.drawText (line2, area, Justification::centredLeft, false);
+}
+
+void ProcessStatsOverlay::mouseUp (const MouseEvent&)
+{
+	m_stats.reset ();
+	timerCallback ();
+}
+
+void ProcessStatsOverlay::timerCallback ()
+{
+	const auto snapshot = m_stats.getSnapshot ();
+	if (snapshot.blocks != m_snapshot.blocks || snapshot.overruns != m_snapshot.overruns)
+	{
+		m_snapshot = snapshot;
+		repaint ();
+	}
+}
+
+#endif
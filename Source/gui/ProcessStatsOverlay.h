@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../dsp/ProcessStats.h"
+
+#if SSPO_ENABLE_PROCESS_STATS
+
+///
+/// \brief The ProcessStatsOverlay class
+/// A small read out of the processor's ProcessStats, polled a few times a second.
+/// Clicking it resets the statistics.
+class ProcessStatsOverlay : public Component, private Timer
+{
+public:
+	explicit ProcessStatsOverlay (ProcessStats& stats);
+	~ProcessStatsOverlay ();
+
+	void paint (Graphics& g) override;
+	void mouseUp (const MouseEvent&) override;
+
+private:
+	void timerCallback () override;
+
+	ProcessStats& m_stats;
+	ProcessStats::Snapshot m_snapshot;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ProcessStatsOverlay)
+};
+
+#endif
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include "ResponseCurve.h"
+
+ResponseCurveEngine::ResponseCurveEngine (int numPoints, std::function<void ()> onNewCurve)
+	: Thread ("SSPO response curve"), m_numPoints (numPoints), m_onNewCurve (std::move (onNewCurve))
+{
+	startThread (3);
+}
+
+ResponseCurveEngine::~ResponseCurveEngine ()
+{
+	stopThread (2000);
+}
+
+void ResponseCurveEngine::request (const Snapshot& snapshot)
+{
+	{
+		const ScopedLock sl (m_lock);
+		m_requested = snapshot;
+	}
+	notify ();
+}
+
+Path ResponseCurveEngine::getCurve () const
+{
+	const ScopedLock sl (m_lock);
+	return m_curve;
+}
+
+Path ResponseCurveEngine::getSecondCurve () const
+{
+	const ScopedLock sl (m_lock);
+	return m_secondCurve;
+}
+
+void ResponseCurveEngine::run ()
+{
+	while (!threadShouldExit ())
+	{
+		Snapshot snapshot;
+		{
+			const ScopedLock sl (m_lock);
+			snapshot = m_requested;
+		}
+
+		if (snapshot.sampleRate <= 0.0 || snapshot == m_computed)
+		{
+			wait (-1);
+			continue;
+		}
+
+		if (snapshot.sampleRate != m_preparedSampleRate)
+		{
+			m_response.prepare (m_numPoints, k_minFreq, k_maxFreq, static_cast<float>(snapshot.sampleRate));
+			m_designer.setSampleRate (static_cast<int>(snapshot.sampleRate));
+			m_preparedSampleRate = snapshot.sampleRate;
+		}
+
+		auto curve = trace (snapshot.first);
+		auto secondCurve = snapshot.second == snapshot.first ? Path () : trace (snapshot.second);
+
+		{
+			const ScopedLock sl (m_lock);
+			m_curve.swapWithPath (curve);
+			m_secondCurve.swapWithPath (secondCurve);
+		}
+		m_computed = snapshot;
+
+		if (m_onNewCurve) m_onNewCurve ();
+	}
+}
+
+Path ResponseCurveEngine::trace (const std::vector<Band>& bands)
+{
+	m_stages.clear ();
+	for (const auto& band : bands)
+		if (m_designer.setTypeIndex (band.type, band.cutoff, band.res, band.gain)) m_designer.appendStages (m_stages);
+	m_response.evaluate (m_stages);
+
+	Path curve;
+	const auto& magnitude = m_response.getMagnitudeDb ();
+	for (auto i = 0; i < m_response.size (); ++i)
+	{
+		const auto x = m_response.size () > 1 ? i / static_cast<float>(m_response.size () - 1) : 0.0f;
+		const auto y = 0.5f - 0.5f * bound (-k_rangeDb, magnitude[i], k_rangeDb) / k_rangeDb;
+		if (i == 0) curve.startNewSubPath (x, y);
+		else curve.lineTo (x, y);
+	}
+	return curve;
+}
+
+//==============================================================================
+ResponseCurve::ResponseCurve (std::function<ResponseCurveEngine::Snapshot ()> getSnapshot)
+	: m_getSnapshot (std::move (getSnapshot)), m_engine (256, [this] { triggerAsyncUpdate (); })
+{
+	setInterceptsMouseClicks (false, false);
+	timerCallback ();
+	startTimerHz (30);
+}
+
+ResponseCurve::~ResponseCurve ()
+{
+	stopTimer ();
+	cancelPendingUpdate ();
+}
+
+void ResponseCurve::paint (Graphics& g)
+{
+	const auto area = getLocalBounds ().toFloat ().reduced (1.0f);
+
+	g.setColour (Colours::black.withAlpha (0.3f));
+	g.fillRect (area);
+
+	// 0dB line and decade markers
+	g.setColour (Colours::whitesmoke.withAlpha (0.2f));
+	g.drawHorizontalLine (roundToInt (area.getCentreY ()), area.getX (), area.getRight ());
+	for (auto f : { 100.0f, 1000.0f, 10000.0f })
+	{
+		const auto x = area.getX () + area.getWidth () * std::log (f / ResponseCurveEngine::k_minFreq)
+			/ std::log (ResponseCurveEngine::k_maxFreq / ResponseCurveEngine::k_minFreq);
+		g.drawVerticalLine (roundToInt (x), area.getY (), area.getBottom ());
+	}
+
+	const auto toArea = AffineTransform::scale (area.getWidth (), area.getHeight ()).translated (area.getX (), area.getY ());
+	g.setColour (Colours::lightskyblue.withAlpha (0.8f));
+	g.strokePath (m_secondCurve, PathStrokeType (1.5f), toArea);
+	g.setColour (Colours::antiquewhite);
+	g.strokePath (m_curve, PathStrokeType (1.5f), toArea);
+}
+
+void ResponseCurve::timerCallback ()
+{
+	const auto snapshot = m_getSnapshot ();
+	if (snapshot != m_lastRequested)
+	{
+		m_lastRequested = snapshot;
+		m_engine.request (snapshot);
+	}
+}
+
+void ResponseCurve::handleAsyncUpdate ()
+{
+	m_curve = m_engine.getCurve ();
+	m_secondCurve = m_engine.getSecondCurve ();
+	repaint ();
+}
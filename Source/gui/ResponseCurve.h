@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../dsp/Filter.h"
+#include "../dsp/FrequencyResponse.h"
+
+///
+/// \brief The ResponseCurveEngine class
+/// Designs the filters of a snapshot on a background thread, evaluates their frequency
+/// response and turns it into a Path, one for each of the two channels when they differ.
+/// The last snapshot is cached, requesting the same snapshot again does no work.
+/// The curves are normalised, x 0 - 1 across log frequency, y 0 - 1 from
+/// +k_rangeDb to -k_rangeDb, so they only need scaling to draw.
+class ResponseCurveEngine : private Thread
+{
+public:
+	static constexpr float k_minFreq = 20.0f;
+	static constexpr float k_maxFreq = 20000.0f;
+	static constexpr float k_rangeDb = 36.0f;
+
+	/// one filter, the settings MultiFilter::setTypeIndex takes
+	struct Band
+	{
+		int type;
+		float cutoff, res, gain;
+
+		bool operator== (const Band& other) const noexcept
+		{
+			return type == other.type && cutoff == other.cutoff && res == other.res && gain == other.gain;
+		}
+	};
+
+	///
+	/// \brief The Snapshot struct
+	/// The filters each channel runs in series, left or mid first and right or side second,
+	/// none for a channel passed straight through
+	struct Snapshot
+	{
+		std::vector<Band> first;
+		std::vector<Band> second;
+		double sampleRate{ 0.0 };
+
+		bool operator== (const Snapshot& other) const noexcept
+		{
+			return first == other.first && second == other.second && sampleRate == other.sampleRate;
+		}
+		bool operator!= (const Snapshot& other) const noexcept { return !(*this == other); }
+	};
+
+	/// onNewCurve is called on the engine's thread each time a new curve is ready
+	ResponseCurveEngine (int numPoints, std::function<void ()> onNewCurve);
+	~ResponseCurveEngine ();
+
+	/// Asks for the curve of a snapshot, returns immediately
+	void request (const Snapshot& snapshot);
+
+	/// The most recent curve of the first channel, in normalised coordinates
+	Path getCurve () const;
+
+	/// The second channel's, empty when it runs the same filters as the first
+	Path getSecondCurve () const;
+
+private:
+	void run () override;
+
+	/// the curve of bands in series
+	Path trace (const std::vector<Band>& bands);
+
+	const int m_numPoints;
+	std::function<void ()> m_onNewCurve;
+
+	CriticalSection m_lock;
+	Snapshot m_requested;
+	Path m_curve;
+	Path m_secondCurve;
+
+	// only touched on the engine thread
+	Snapshot m_computed;
+	MultiFilter m_designer;
+	FrequencyResponse m_response;
+	double m_preparedSampleRate{ 0.0 };
+	std::vector<BiQuad::BiquadCoeffecients> m_stages;
+
+	JUCE_DECLARE_NON_COPYABLE (ResponseCurveEngine)
+};
+
+///
+/// \brief The ResponseCurve class
+/// Draws the magnitude response of what the processor runs, whichever mode it is in,
+/// the second channel's too when it differs. getSnapshot is polled on the message
+/// thread and the engine only asked for a new curve when the snapshot changes.
+class ResponseCurve : public Component, private Timer, private AsyncUpdater
+{
+public:
+	explicit ResponseCurve (std::function<ResponseCurveEngine::Snapshot ()> getSnapshot);
+	~ResponseCurve ();
+
+	void paint (Graphics& g) override;
+
+private:
+	void timerCallback () override;
+	void handleAsyncUpdate () override;
+
+	std::function<ResponseCurveEngine::Snapshot ()> m_getSnapshot;
+	ResponseCurveEngine m_engine;
+	ResponseCurveEngine::Snapshot m_lastRequested;
+	Path m_curve;
+	Path m_secondCurve;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ResponseCurve)
+};
@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include "SpectrumAnalyser.h"
+
+SpectrumAnalyser::SpectrumAnalyser () : Thread ("SSPO spectrum analyser")
+{
+}
+
+SpectrumAnalyser::~SpectrumAnalyser ()
+{
+	m_active.store (false);
+	stopThread (2000);
+}
+
+void SpectrumAnalyser::prepare (double sampleRate) noexcept
+{
+	if (sampleRate > 0.0) m_sampleRate.store (sampleRate);
+}
+
+void SpectrumAnalyser::setActive (bool shouldBeActive)
+{
+	m_active.store (shouldBeActive);
+	if (shouldBeActive) startThread (2);
+	else stopThread (2000);
+}
+
+void SpectrumAnalyser::push (Tap tap, const AudioBuffer<float>& buffer) noexcept
+{
+	if (!m_active.load (std::memory_order_relaxed)) return;
+
+	const auto numChannels = buffer.getNumChannels ();
+	if (numChannels == 0) return;
+
+	auto& state = m_taps[tap];
+	int start1, size1, start2, size2;
+	state.fifo.prepareToWrite (buffer.getNumSamples (), start1, size1, start2, size2);
+
+	// mix straight into the fifo's storage, no intermediate buffer
+	const auto gain = 1.0f / numChannels;
+	const auto mixInto = [&](int destStart, int sourceStart, int num)
+	{
+		if (num <= 0) return;
+		auto* dest = state.fifoData.data () + destStart;
+		FloatVectorOperations::copyWithMultiply (dest, buffer.getReadPointer (0, sourceStart), gain, num);
+		for (auto c = 1; c < numChannels; ++c)
+			FloatVectorOperations::addWithMultiply (dest, buffer.getReadPointer (c, sourceStart), gain, num);
+	};
+	mixInto (start1, 0, size1);
+	mixInto (start2, size1, size2);
+
+	state.fifo.finishedWrite (size1 + size2);
+}
+
+void SpectrumAnalyser::run ()
+{
+	while (!threadShouldExit ())
+	{
+		for (auto tap = 0; tap < numTaps; ++tap) analyse (tap);
+		wait (1000 / k_framesPerSecond);
+	}
+}
+
+void SpectrumAnalyser::analyse (int tap)
+{
+	auto& state = m_taps[tap];
+	auto& history = state.history;
+
+	// slide the new samples onto the end of the history, keeping the latest k_fftSize
+	int start1, size1, start2, size2;
+	state.fifo.prepareToRead (state.fifo.getNumReady (), start1, size1, start2, size2);
+	const auto appendSamples = [&](int start, int num)
+	{
+		const auto keep = jmin (num, k_fftSize);
+		const auto from = state.fifoData.data () + start + num - keep;
+		std::move (history.begin () + keep, history.end (), history.begin ());
+		std::copy (from, from + keep, history.end () - keep);
+	};
+	if (size1 > 0) appendSamples (start1, size1);
+	if (size2 > 0) appendSamples (start2, size2);
+	state.fifo.finishedRead (size1 + size2);
+	state.newSamples += size1 + size2;
+
+	// no point analysing the same window again
+	if (state.newSamples == 0) return;
+	state.newSamples = 0;
+
+	std::copy (history.begin (), history.end (), m_fftData.begin ());
+	std::fill (m_fftData.begin () + k_fftSize, m_fftData.end (), 0.0f);
+	m_window.multiplyWithWindowingTable (m_fftData.data (), static_cast<size_t>(k_fftSize));
+	m_fft.performFrequencyOnlyForwardTransform (m_fftData.data ());
+
+	// a full scale sine through a hann window peaks at k_fftSize / 4
+	constexpr auto scale = 4.0f / k_fftSize;
+	auto& frame = state.frames.getWriteBuffer ();
+	for (auto i = 0; i < k_numBins; ++i)
+		frame[i] = Decibels::gainToDecibels (m_fftData[i] * scale, SpectrumDisplay::k_minDb);
+	state.frames.publish ();
+}
+
+//==============================================================================
+SpectrumDisplay::SpectrumDisplay (SpectrumAnalyser& analyser) : m_analyser (analyser)
+{
+	setInterceptsMouseClicks (false, false);
+	setOpaque (false);
+	m_analyser.setActive (true);
+	startTimerHz (SpectrumAnalyser::k_framesPerSecond);
+}
+
+SpectrumDisplay::~SpectrumDisplay ()
+{
+	stopTimer ();
+	m_analyser.setActive (false);
+}
+
+void SpectrumDisplay::paint (Graphics& g)
+{
+	const auto area = getLocalBounds ().toFloat ().reduced (1.0f);
+	const auto transform = AffineTransform::scale (area.getWidth (), area.getHeight ()).translated (area.getX (), area.getY ());
+
+	g.setColour (Colours::whitesmoke.withAlpha (0.15f));
+	g.fillPath (m_prePath, transform);
+	g.setColour (Colours::red.withAlpha (0.6f));
+	g.strokePath (m_postPath, PathStrokeType (1.0f), transform);
+}
+
+void SpectrumDisplay::timerCallback ()
+{
+	auto changed = false;
+	if (m_analyser.update (SpectrumAnalyser::preFilter))
+	{
+		m_prePath = makePath (m_analyser.getFrame (SpectrumAnalyser::preFilter), true);
+		changed = true;
+	}
+	if (m_analyser.update (SpectrumAnalyser::postFilter))
+	{
+		m_postPath = makePath (m_analyser.getFrame (SpectrumAnalyser::postFilter), false);
+		changed = true;
+	}
+	if (changed) repaint ();
+}
+
+Path SpectrumDisplay::makePath (const SpectrumAnalyser::Frame& frame, bool closed) const
+{
+	// normalised, x across 20Hz - 20kHz on a log scale, y from 0dB down to k_minDb
+	constexpr auto minFreq = 20.0f;
+	constexpr auto maxFreq = 20000.0f;
+	const auto binWidth = static_cast<float>(m_analyser.getSampleRate ()) / SpectrumAnalyser::k_fftSize;
+	const auto logRange = std::log (maxFreq / minFreq);
+
+	Path p;
+	auto started = false;
+	for (auto i = 1; i < SpectrumAnalyser::k_numBins; ++i)
+	{
+		const auto freq = i * binWidth;
+		if (freq < minFreq) continue;
+		if (freq > maxFreq) break;
+
+		const auto x = std::log (freq / minFreq) / logRange;
+		const auto y = jlimit (0.0f, 1.0f, frame[i] / SpectrumDisplay::k_minDb);
+		if (!started)
+		{
+			if (closed) p.startNewSubPath (x, 1.0f);
+			else p.startNewSubPath (x, y);
+			started = true;
+		}
+		p.lineTo (x, y);
+	}
+
+	if (closed && started)
+	{
+		p.lineTo (p.getCurrentPosition ().x, 1.0f);
+		p.closeSubPath ();
+	}
+	return p;
+}
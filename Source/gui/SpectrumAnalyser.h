@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../dsp/TripleBuffer.h"
+
+///
+/// \brief The SpectrumAnalyser class
+/// Spectra of the signal before and after the filter. The audio thread push()es
+/// each block into a preallocated single producer / single consumer fifo, a
+/// background thread runs windowed FFTs at a throttled rate and publishes
+/// magnitude frames, in dB, through a TripleBuffer for the editor to pick up.
+/// When either side falls behind frames are dropped, push() never waits.
+/// Nothing runs, and push() returns straight away, unless the analyser is active.
+class SpectrumAnalyser : private Thread
+{
+public:
+	static constexpr int k_fftOrder = 11;
+	static constexpr int k_fftSize = 1 << k_fftOrder;
+	static constexpr int k_numBins = k_fftSize / 2;
+	static constexpr int k_fifoSize = 1 << 15;
+	static constexpr int k_framesPerSecond = 30;
+
+	enum Tap
+	{
+		preFilter = 0,
+		postFilter,
+		numTaps
+	};
+
+	using Frame = std::array<float, k_numBins>;
+
+	SpectrumAnalyser ();
+	~SpectrumAnalyser ();
+
+	void prepare (double sampleRate) noexcept;
+	double getSampleRate () const noexcept { return m_sampleRate.load (); }
+
+	/// Starts or stops the analysis thread, message thread only
+	void setActive (bool shouldBeActive);
+
+	/// Realtime safe, writes the mono sum of the buffer, dropping what doesn't fit
+	void push (Tap tap, const AudioBuffer<float>& buffer) noexcept;
+
+	/// Reader thread only, returns true if a newer frame for the tap is available in getFrame()
+	bool update (Tap tap) noexcept { return m_taps[tap].frames.update (); }
+	const Frame& getFrame (Tap tap) const noexcept { return m_taps[tap].frames.getReadBuffer (); }
+
+private:
+	void run () override;
+	void analyse (int tap);
+
+	struct TapState
+	{
+		AbstractFifo fifo{ k_fifoSize };
+		std::vector<float> fifoData = std::vector<float> (k_fifoSize, 0.0f);
+
+		// only touched on the analysis thread
+		std::vector<float> history = std::vector<float> (k_fftSize, 0.0f);
+		int newSamples{ 0 };
+
+		TripleBuffer<Frame> frames;
+	};
+
+	std::array<TapState, numTaps> m_taps;
+	std::atomic<bool> m_active{ false };
+	std::atomic<double> m_sampleRate{ 44100.0 };
+
+	dsp::FFT m_fft{ k_fftOrder };
+	dsp::WindowingFunction<float> m_window{ static_cast<size_t>(k_fftSize), dsp::WindowingFunction<float>::hann, false };
+	std::vector<float> m_fftData = std::vector<float> (2 * k_fftSize, 0.0f);
+
+	JUCE_DECLARE_NON_COPYABLE (SpectrumAnalyser)
+};
+
+///
+/// \brief The SpectrumDisplay class
+/// Draws the analyser's pre and post filter spectra, activating the analyser
+/// only for as long as the display exists.
+class SpectrumDisplay : public Component, private Timer
+{
+public:
+	static constexpr float k_minDb = -96.0f;
+
+	explicit SpectrumDisplay (SpectrumAnalyser& analyser);
+	~SpectrumDisplay ();
+
+	void paint (Graphics& g) override;
+
+private:
+	void timerCallback () override;
+	Path makePath (const SpectrumAnalyser::Frame& frame, bool closed) const;
+
+	SpectrumAnalyser& m_analyser;
+	Path m_prePath;
+	Path m_postPath;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SpectrumDisplay)
+};
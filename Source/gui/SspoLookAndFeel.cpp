@@ -31,50 +31,78 @@ void SspoLookAndFeel::drawRotarySlider (Graphics& g, int x, int y, int width, in
 	const auto radius = jmin (width / 2, height / 2) - 4.0f;
 	const auto centreX = x + width * 0.5f;
 	const auto centreY = y + height * 0.5f;
+	const auto angle = rotaryStartAngle + sliderPos * (rotaryEndAngle - rotaryStartAngle);
+
+	//the markings and knob don't move, so come from a cached image
+	const auto scale = g.getInternalContext ().getPhysicalPixelScaleFactor ();
+	const KnobKey key{ width, height, roundToInt (scale * 100.0f), slider.isEnabled (), rotaryStartAngle, rotaryEndAngle };
+	g.setOpacity (1.0f);
+	g.drawImage (getKnobImage (key, scale), Rectangle<float> (static_cast<float>(x), static_cast<float>(y), static_cast<float>(width), static_cast<float>(height)));
+
+	if (slider.isEnabled ())
+	{
+		//the pointer shapes only change with size, rotate them into place
+		if (radius != m_pointerRadius)
+		{
+			const auto pointerLength = radius * 0.3f;
+			constexpr auto pointerThickness = 2.0f;
+			m_pointerLine.clear ();
+			m_pointerTriangle.clear ();
+			m_pointerLine.addRectangle (-pointerThickness * 0.5f, -radius, pointerThickness, pointerLength);
+			m_pointerTriangle.addTriangle (0, -radius, pointerLength, -radius + pointerLength, -pointerLength, -radius + pointerLength);
+			m_pointerRadius = radius;
+		}
+
+		const auto rotation = AffineTransform::rotation (angle).translated (centreX, centreY);
+		g.setColour (Colours::black);
+		g.fillPath (m_pointerTriangle, rotation);
+		g.setColour (Colours::antiquewhite);
+		g.fillPath (m_pointerLine, rotation);
+	}
+}
+
+Image SspoLookAndFeel::getKnobImage (const KnobKey& key, float scale)
+{
+	const auto cached = m_knobImages.find (key);
+	if (cached != m_knobImages.end ()) return cached->second;
+
+	// sizes rarely change, this just stops the cache growing without bound
+	if (m_knobImages.size () >= 32) m_knobImages.clear ();
+
+	Image image (Image::ARGB, jmax (1, roundToInt (key.width * scale)), jmax (1, roundToInt (key.height * scale)), true);
+	Graphics g (image);
+	g.addTransform (AffineTransform::scale (scale));
+
+	const auto radius = jmin (key.width / 2, key.height / 2) - 4.0f;
+	const auto centreX = key.width * 0.5f;
+	const auto centreY = key.height * 0.5f;
 	const auto rx = centreX - radius * 0.7f;
 	const auto ry = centreY - radius * 0.7f;
 	const auto rw = radius * 1.4f;
-	const auto angle = rotaryStartAngle + sliderPos * (rotaryEndAngle - rotaryStartAngle);
 
 	//draw markings
 	const auto markLength = radius * 0.1f;
 	constexpr auto markThickness = 1.0f;
-	const auto divisionRotation = (rotaryEndAngle - rotaryStartAngle) * 0.1f;
+	const auto divisionRotation = (key.rotaryEndAngle - key.rotaryStartAngle) * 0.1f;
 	g.setColour (Colours::whitesmoke);
 	for (auto i = 0; i <= 10; ++i)
 	{
 		Path markPath;
 		markPath.addRectangle (-markThickness * 0.5f, -radius, markThickness, markLength);
-		markPath.applyTransform (AffineTransform::rotation (rotaryStartAngle + divisionRotation * i).translated (centreX, centreY));
+		markPath.applyTransform (AffineTransform::rotation (key.rotaryStartAngle + divisionRotation * i).translated (centreX, centreY));
 		g.fillPath (markPath);
 	}
 
-
 	//draw knob
-	g.setColour (slider.isEnabled () ? Colours::antiquewhite : Colours::grey);
+	g.setColour (key.enabled ? Colours::antiquewhite : Colours::grey);
 	g.fillEllipse (rx, ry, rw, rw);
 
 	//draw outline
 	g.setColour (Colours::black);
 	g.drawEllipse (rx, ry, rw, rw, rw * 0.1f);
 
-	if (slider.isEnabled ())
-	{
-		//create the pointer
-		Path linePath;
-		Path triPath;
-		const auto pointerLength = radius * 0.3f;
-		constexpr auto pointerThickness = 2.0f;
-		linePath.addRectangle (-pointerThickness * 0.5f, -radius, pointerThickness, pointerLength);
-		triPath.addTriangle (0, -radius, pointerLength, -radius + pointerLength, -pointerLength, -radius + pointerLength);
-		//rotate pointer
-		linePath.applyTransform (AffineTransform::rotation (angle).translated (centreX, centreY));
-		triPath.applyTransform (AffineTransform::rotation (angle).translated (centreX, centreY));
-		g.setColour (Colours::black);
-		g.fillPath (triPath);
-		g.setColour (Colours::antiquewhite);
-		g.fillPath (linePath);
-	}
+	m_knobImages[key] = image;
+	return image;
 }
 
 Label* SspoLookAndFeel::createSliderTextBox (Slider& slider)
@@ -21,6 +21,8 @@
 
 #pragma once
 #include "../JuceLibraryCode/JuceHeader.h"
+#include <map>
+#include <tuple>
 
 class SspoLookAndFeel : public LookAndFeel_V4
 {
@@ -31,5 +33,26 @@ public:
 
 	Label* createSliderTextBox(Slider&) override;
 
+private:
+	struct KnobKey
+	{
+		int width, height, scalePercent;
+		bool enabled;
+		float rotaryStartAngle, rotaryEndAngle;
+
+		bool operator< (const KnobKey& other) const noexcept
+		{
+			return std::tie (width, height, scalePercent, enabled, rotaryStartAngle, rotaryEndAngle)
+				< std::tie (other.width, other.height, other.scalePercent, other.enabled, other.rotaryStartAngle, other.rotaryEndAngle);
+		}
+	};
+
+	/// The static part of a knob, its markings, body and outline, rendered once per size and state
+	Image getKnobImage (const KnobKey& key, float scale);
+
+	std::map<KnobKey, Image> m_knobImages;
+	Path m_pointerLine;
+	Path m_pointerTriangle;
+	float m_pointerRadius{ -1.0f };
 
 };
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+// Drives the library only through its C interface, checking the type table against
+// MultiFilter, that every bad argument is refused with nothing processed, that processing,
+// offline rendering and reset give what a MultiFilter set up the same way gives, and that
+// a preset bank refuses the Ladder. Exits non zero on any failure.
+//
+// usage: sspo_filter_capi_test [--verbose]
+
+#include "TestSignals.h"
+#include "capi/sspo_filter.h"
+#include "dsp/Filter.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace
+{
+	constexpr int k_sampleRate = 48000;
+	constexpr int k_length = 1 << 14;
+
+	bool same (const std::vector<float>& a, const std::vector<float>& b)
+	{
+		return a.size () == b.size () && std::memcmp (a.data (), b.data (), a.size () * sizeof (float)) == 0;
+	}
+}
+
+int main (int argc, char* argv[])
+{
+	const auto verbose = argc > 1 && std::strcmp (argv[1], "--verbose") == 0;
+	auto failures = 0, checks = 0;
+	const auto check = [&] (bool pass, const std::string& what)
+	{
+		++checks;
+		if (!pass) ++failures;
+		if (!pass || verbose) std::printf ("%s %s\n", pass ? "ok  " : "FAIL", what.c_str ());
+	};
+
+	// the type table
+	{
+		const auto names = MultiFilter::typeStings ();
+		MultiFilter probe;
+		auto matches = sspo_filter_type_count () == static_cast<int> (names.size ());
+		for (auto i = 0; matches && i < static_cast<int> (names.size ()); ++i)
+		{
+			matches = sspo_filter_type_name (i) != nullptr && names[i] == sspo_filter_type_name (i)
+				&& sspo_filter_type_uses_q (i) == (probe.getUseQ (i) ? 1 : 0) && sspo_filter_type_uses_gain (i) == (probe.getUseGain (i) ? 1 : 0);
+		}
+		check (matches, "type names, Q and gain match MultiFilter");
+		const auto count = sspo_filter_type_count ();
+		check (sspo_filter_type_name (-1) == nullptr && sspo_filter_type_name (count) == nullptr
+			&& sspo_filter_type_uses_q (count) == 0 && sspo_filter_type_uses_gain (-1) == 0, "types out of range");
+	}
+
+	// bad arguments
+	{
+		check (sspo_filter_create (0, k_sampleRate) == nullptr && sspo_filter_create (2, 0) == nullptr, "create refuses no channels or rate");
+		sspo_filter_destroy (nullptr);
+		sspo_filter_reset (nullptr);
+
+		auto* filter = sspo_filter_create (2, k_sampleRate);
+		check (filter != nullptr, "create");
+		const auto nan = std::numeric_limits<float>::quiet_NaN ();
+		check (sspo_filter_set_type (filter, -1) == SSPO_ERROR_INVALID_ARGUMENT
+			&& sspo_filter_set_type (filter, sspo_filter_type_count ()) == SSPO_ERROR_INVALID_ARGUMENT
+			&& sspo_filter_set_type (nullptr, 0) == SSPO_ERROR_INVALID_ARGUMENT, "set_type refuses types out of range");
+		check (sspo_filter_set_type_name (filter, "LP13") == SSPO_ERROR_INVALID_ARGUMENT
+			&& sspo_filter_set_type_name (filter, nullptr) == SSPO_ERROR_INVALID_ARGUMENT
+			&& sspo_filter_set_type_name (filter, "HP12") == SSPO_OK, "set_type_name");
+		check (sspo_filter_set_params (filter, nan, 1.0f, 0.0f) == SSPO_ERROR_INVALID_ARGUMENT
+			&& sspo_filter_set_params (filter, 1000.0f, INFINITY, 0.0f) == SSPO_ERROR_INVALID_ARGUMENT
+			&& sspo_filter_set_sample_rate (filter, 0) == SSPO_ERROR_INVALID_ARGUMENT, "set_params and set_sample_rate refuse bad values");
+
+		std::vector<float> left (256, 0.5f), untouched = left;
+		float* withNull[] = { left.data (), nullptr };
+		check (sspo_filter_process (filter, withNull, 2, 256) == SSPO_ERROR_INVALID_ARGUMENT && same (left, untouched), "process refuses a NULL channel, processing nothing");
+		check (sspo_filter_process_offline (filter, withNull, 2, 256, 2) == SSPO_ERROR_INVALID_ARGUMENT && same (left, untouched), "process_offline refuses a NULL channel");
+		float* three[] = { left.data (), left.data (), left.data () };
+		check (sspo_filter_process (filter, three, 3, 256) == SSPO_ERROR_INVALID_ARGUMENT && sspo_filter_process (filter, nullptr, 1, 256) == SSPO_ERROR_INVALID_ARGUMENT
+			&& sspo_filter_process (filter, three, 1, -1) == SSPO_ERROR_INVALID_ARGUMENT && same (left, untouched), "process refuses more channels than created, no buffers or a negative length");
+		check (sspo_filter_process (filter, three, 0, 256) == SSPO_OK && sspo_filter_process (filter, three, 1, 0) == SSPO_OK && same (left, untouched), "nothing to process");
+		sspo_filter_destroy (filter);
+	}
+
+	// every type against a MultiFilter set up the same way, each channel its own, then
+	// reset, and offline rendering within rounding
+	const auto noise = testsignals::noise (k_length);
+	for (auto type = 0; type < sspo_filter_type_count (); ++type)
+	{
+		const auto name = std::string (sspo_filter_type_name (type));
+		auto* filter = sspo_filter_create (2, k_sampleRate);
+		sspo_filter_set_type (filter, type);
+		sspo_filter_set_params (filter, 1500.0f, 2.0f, 6.0f);
+
+		std::vector<float> expected = noise;
+		{
+			MultiFilter reference;
+			reference.setSampleRate (k_sampleRate);
+			reference.setTypeIndex (type, 1500.0f, 2.0f, 6.0f);
+			for (auto start = 0; start < k_length; start += 512) reference.processBlock (expected.data () + start, 512);
+		}
+
+		std::vector<float> left = noise, right (k_length, 0.0f);
+		float* channels[] = { left.data (), right.data () };
+		auto ok = true;
+		for (auto start = 0; start < k_length; start += 512)
+		{
+			float* block[] = { left.data () + start, right.data () + start };
+			ok = sspo_filter_process (filter, block, 2, 512) == SSPO_OK && ok;
+		}
+		check (ok && same (left, expected) && same (right, std::vector<float> (k_length, 0.0f)), name + " process matches MultiFilter, channels apart");
+
+		sspo_filter_reset (filter);
+		left = noise;
+		for (auto start = 0; start < k_length; start += 512)
+		{
+			float* block[] = { left.data () + start };
+			sspo_filter_process (filter, block, 1, 512);
+		}
+		check (same (left, expected), name + " reset starts afresh");
+
+		sspo_filter_reset (filter);
+		left = noise;
+		double signal = 0.0, error = 0.0;
+		ok = sspo_filter_process_offline (filter, channels, 1, k_length, 4) == SSPO_OK;
+		for (auto i = 0; i < k_length; ++i)
+		{
+			signal += static_cast<double> (expected[i]) * expected[i];
+			error += (static_cast<double> (expected[i]) - left[i]) * (static_cast<double> (expected[i]) - left[i]);
+		}
+		const auto snr = error > 0.0 ? 10.0 * std::log10 (signal / error) : 999.0;
+		check (ok && snr > 40.0, name + " process_offline within rounding, " + std::to_string (snr) + " dB");
+		sspo_filter_destroy (filter);
+	}
+
+	// preset banks
+	{
+		const auto* tmp = std::getenv ("TMPDIR");
+		const auto path = std::string (tmp != nullptr ? tmp : "/tmp") + "/sspo_capi_test_" + std::to_string (getpid ()) + ".bank";
+		const int rates[] = { 44100, 48000 };
+		const sspo_preset linear[] = { { "Air", 7, 10000.0f, 0.707f, 3.0f }, { "Rumble", 4, 40.0f, 0.707f, 0.0f } };
+		const sspo_preset ladder[] = { { "Acid", 11, 800.0f, 8.0f, 12.0f } };
+		check (sspo_preset_bank_write (path.c_str (), linear, 2, rates, 2) == SSPO_OK, "preset bank of linear types");
+		check (sspo_preset_bank_write (path.c_str (), ladder, 1, rates, 2) == SSPO_ERROR_INVALID_ARGUMENT, "preset bank refuses the Ladder");
+		check (sspo_preset_bank_write (nullptr, linear, 2, rates, 2) == SSPO_ERROR_INVALID_ARGUMENT
+			&& sspo_preset_bank_write (path.c_str (), linear, 0, rates, 2) == SSPO_ERROR_INVALID_ARGUMENT, "preset bank refuses no path or presets");
+		std::remove (path.c_str ());
+	}
+
+	std::printf ("%d of %d C interface checks failed\n", failures, checks);
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,328 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+// Starts sspo_filterd on a private socket and times blocks through it from this process,
+// the round trip from sspo_client_submit to sspo_client_wait returning, against the same
+// blocks filtered in process. The blocks are written straight into the shared slots and
+// read back in place. Reports the mean, median, p99 and worst round trip for each block
+// size, then the throughput with every slot in flight. Fails if the daemon can't be
+// started or reached, or its output differs from MultiFilter::processBlock in process.
+// First it checks that a client which connects and sends nothing doesn't hold up the
+// next, and that one which rewrites the geometry in its shared header can't take the
+// daemon down.
+//
+// usage: sspo_filter_daemon_latency --daemon <path to sspo_filterd> [--blocks <n>]
+
+#include "TestSignals.h"
+#include "daemon/SharedSession.h"
+#include "dsp/Filter.h"
+#include "sspo_filter_client.h"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	constexpr int k_channels = 2;
+	constexpr int k_sampleRate = 48000;
+	constexpr int k_maxBlockSize = 1024;
+	constexpr int k_slots = 4;
+
+	struct Percentiles
+	{
+		double mean, median, p99, worst;
+	};
+
+	Percentiles percentiles (std::vector<double>& us)
+	{
+		std::sort (us.begin (), us.end ());
+		double sum = 0.0;
+		for (auto v : us) sum += v;
+		const auto at = [&us] (double p) { return us[std::min (us.size () - 1, static_cast<size_t> (us.size () * p))]; };
+		return { sum / us.size (), at (0.5), at (0.99), us.back () };
+	}
+
+	struct Daemon
+	{
+		pid_t pid{ -1 };
+
+		~Daemon ()
+		{
+			if (pid <= 0) return;
+			kill (pid, SIGTERM);
+			waitpid (pid, nullptr, 0);
+		}
+	};
+
+	/// a bare connection to the daemon, without the client library
+	int connectRaw (const std::string& path)
+	{
+		sockaddr_un address{};
+		address.sun_family = AF_UNIX;
+		std::strcpy (address.sun_path, path.c_str ());
+		const auto s = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (s >= 0 && connect (s, reinterpret_cast<sockaddr*> (&address), sizeof (address)) == 0) return s;
+		if (s >= 0) close (s);
+		return -1;
+	}
+
+	///
+	/// \brief hostileSession
+	/// Opens a session by hand, then overwrites the geometry in its header with zero slots
+	/// and more channels and samples than were mapped, and submits a block. Returns the
+	/// socket, which is kept open so the session stays alive, or -1.
+	int hostileSession (const std::string& path)
+	{
+		const auto s = connectRaw (path);
+		if (s < 0) return -1;
+		const sharedSession::ConnectRequest request{ sharedSession::k_magic, sharedSession::k_version, 1, k_sampleRate, 64, 1 };
+		sharedSession::ConnectReply reply{};
+		iovec data{ &reply, sizeof (reply) };
+		msghdr message{};
+		message.msg_iov = &data;
+		message.msg_iovlen = 1;
+		alignas (cmsghdr) char control[CMSG_SPACE (sizeof (int))];
+		message.msg_control = control;
+		message.msg_controllen = sizeof (control);
+
+		int fd = -1;
+		if (send (s, &request, sizeof (request), MSG_NOSIGNAL) != static_cast<ssize_t> (sizeof (request))
+			|| recvmsg (s, &message, MSG_WAITALL) != static_cast<ssize_t> (sizeof (reply)) || reply.result != 0
+			|| CMSG_FIRSTHDR (&message) == nullptr)
+		{
+			close (s);
+			return -1;
+		}
+		std::memcpy (&fd, CMSG_DATA (CMSG_FIRSTHDR (&message)), sizeof (int));
+		auto* mapping = mmap (nullptr, reply.mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close (fd);
+		if (mapping == MAP_FAILED)
+		{
+			close (s);
+			return -1;
+		}
+
+		auto& h = *static_cast<sharedSession::Header*> (mapping);
+		h.numSlots = 0;
+		h.numChannels = sharedSession::k_maxChannels;
+		h.maxBlockSize = sharedSession::k_maxBlockSize;
+		sharedSession::slot (mapping, sharedSession::geometry (request), 0)->numSamples = sharedSession::k_maxBlockSize;
+		sharedSession::publish (h.submitted, 1, h.daemonWaiting);
+
+		// filtered as the one slot and channel of 64 samples it asked for
+		for (auto i = 0; i < 100 && h.completed.load () == 0; ++i) std::this_thread::sleep_for (std::chrono::milliseconds (10));
+		const auto completed = h.completed.load () == 1;
+		munmap (mapping, reply.mappingSize);
+		if (completed) return s;
+		close (s);
+		return -1;
+	}
+
+	std::vector<std::unique_ptr<MultiFilter>> makeFilters ()
+	{
+		std::vector<std::unique_ptr<MultiFilter>> filters;
+		for (auto c = 0; c < k_channels; ++c)
+		{
+			filters.push_back (std::make_unique<MultiFilter> ());
+			filters.back ()->setSampleRate (k_sampleRate);
+			filters.back ()->setTypeIndex (8, 1000.0f, 2.0f, 6.0f);
+		}
+		return filters;
+	}
+}
+
+int main (int argc, char* argv[])
+{
+	std::string daemonPath;
+	auto numBlocks = 5000;
+	for (auto i = 1; i < argc; ++i)
+	{
+		if (std::strcmp (argv[i], "--daemon") == 0 && i + 1 < argc) daemonPath = argv[++i];
+		else if (std::strcmp (argv[i], "--blocks") == 0 && i + 1 < argc) numBlocks = std::max (1, std::atoi (argv[++i]));
+	}
+	if (daemonPath.empty ())
+	{
+		std::printf ("usage: sspo_filter_daemon_latency --daemon <path to sspo_filterd> [--blocks <n>]\n");
+		return 1;
+	}
+
+	const auto socketPath = "/tmp/sspo_filterd_latency_" + std::to_string (getpid ()) + ".sock";
+	Daemon daemon;
+	daemon.pid = fork ();
+	if (daemon.pid == 0)
+	{
+		execl (daemonPath.c_str (), daemonPath.c_str (), "--socket", socketPath.c_str (), static_cast<char*> (nullptr));
+		_exit (127);
+	}
+
+	sspo_client* client = nullptr;
+	for (auto attempt = 0; attempt < 200 && client == nullptr; ++attempt)
+	{
+		client = sspo_client_connect (socketPath.c_str (), k_channels, k_sampleRate, k_maxBlockSize, k_slots);
+		if (client == nullptr) std::this_thread::sleep_for (std::chrono::milliseconds (10));
+	}
+	if (client == nullptr)
+	{
+		std::printf ("FAIL could not reach %s on %s\n", daemonPath.c_str (), socketPath.c_str ());
+		return 1;
+	}
+	sspo_client_set_params (client, 8, 1000.0f, 2.0f, 6.0f);
+
+	auto failures = 0;
+
+	// a client that never sends its request, the next one still connects straight away
+	const auto silent = connectRaw (socketPath);
+	const auto connectStart = Clock::now ();
+	auto* second = sspo_client_connect (socketPath.c_str (), 1, k_sampleRate, 64, 1);
+	const auto connectMs = std::chrono::duration<double, std::milli> (Clock::now () - connectStart).count ();
+	if (silent < 0 || second == nullptr || connectMs > 500.0)
+	{
+		std::printf ("FAIL a silent client held up the next connection, %.1f ms\n", connectMs);
+		++failures;
+	}
+	sspo_client_disconnect (second);
+	if (silent >= 0) close (silent);
+
+	const auto hostile = hostileSession (socketPath);
+	if (hostile < 0 || waitpid (daemon.pid, nullptr, WNOHANG) != 0)
+	{
+		std::printf ("FAIL a session that rewrote its shared geometry was not contained\n");
+		return 1;
+	}
+	close (hostile);
+
+	const auto noise = testsignals::noise (k_maxBlockSize);
+
+	std::printf ("%d channels, round trip in us\n", k_channels);
+	std::printf ("%6s %9s %9s %9s %9s %12s\n", "block", "mean", "median", "p99", "worst", "in process");
+	// the same filters in process, given the same blocks as the daemon's
+	auto local = makeFilters ();
+	for (auto blockSize : { 32, 64, 128, 256, 1024 })
+	{
+		std::vector<float> expected (blockSize);
+		std::vector<double> roundTrips, inProcess;
+		roundTrips.reserve (numBlocks);
+		inProcess.reserve (numBlocks);
+		auto matches = true;
+
+		for (auto b = 0; b < numBlocks; ++b)
+		{
+			auto* const* channels = sspo_client_acquire (client);
+			for (auto c = 0; c < k_channels; ++c) std::copy (noise.begin (), noise.begin () + blockSize, channels[c]);
+
+			const auto start = Clock::now ();
+			sspo_client_submit (client, blockSize);
+			int numSamples = 0;
+			auto* const* filtered = sspo_client_wait (client, &numSamples);
+			const auto end = Clock::now ();
+			if (filtered == nullptr)
+			{
+				std::printf ("FAIL the daemon went away\n");
+				return 1;
+			}
+			roundTrips.push_back (std::chrono::duration<double, std::micro> (end - start).count ());
+
+			const auto localStart = Clock::now ();
+			for (auto c = 0; c < k_channels; ++c)
+			{
+				std::copy (noise.begin (), noise.begin () + blockSize, expected.begin ());
+				local[c]->processBlock (expected.data (), blockSize);
+				matches = matches && numSamples == blockSize && std::equal (expected.begin (), expected.end (), filtered[c]);
+			}
+			inProcess.push_back (std::chrono::duration<double, std::micro> (Clock::now () - localStart).count ());
+			sspo_client_release (client);
+		}
+
+		const auto trip = percentiles (roundTrips);
+		const auto direct = percentiles (inProcess);
+		std::printf ("%6d %9.2f %9.2f %9.2f %9.2f %12.2f%s\n", blockSize, trip.mean, trip.median, trip.p99, trip.worst,
+			direct.mean, matches ? "" : "  FAIL output differs from in process");
+		if (!matches) ++failures;
+	}
+
+	// every slot kept in flight, the cost per sample once the round trips overlap
+	{
+		constexpr int blockSize = 256;
+		const auto start = Clock::now ();
+		auto submitted = 0, received = 0;
+		while (received < numBlocks)
+		{
+			float* const* channels = nullptr;
+			while (submitted < numBlocks && (channels = sspo_client_acquire (client)) != nullptr)
+			{
+				for (auto c = 0; c < k_channels; ++c) std::copy (noise.begin (), noise.begin () + blockSize, channels[c]);
+				sspo_client_submit (client, blockSize);
+				++submitted;
+			}
+			if (sspo_client_wait (client, nullptr) == nullptr)
+			{
+				std::printf ("FAIL the daemon went away\n");
+				return 1;
+			}
+			sspo_client_release (client);
+			++received;
+		}
+		const std::chrono::duration<double, std::nano> elapsed = Clock::now () - start;
+		std::printf ("%d slots in flight, block %d: %.3f ns/sample\n", k_slots, blockSize,
+			elapsed.count () / (static_cast<double> (numBlocks) * blockSize * k_channels));
+	}
+
+	// a missing buffer is refused before anything is sent, and once the daemon has gone
+	// every later block is told so, not that it was called wrongly
+	{
+		std::vector<float> left (64, 0.5f);
+		float* missing[] = { left.data (), nullptr };
+		const auto refused = sspo_client_process (client, missing, k_channels, 64);
+
+		kill (daemon.pid, SIGKILL);
+		waitpid (daemon.pid, nullptr, 0);
+		daemon.pid = -1;
+		float* channels[] = { left.data () };
+		const auto first = sspo_client_process (client, channels, 1, 64);
+		const auto second = sspo_client_process (client, channels, 1, 64);
+		if (refused != SSPO_ERROR_INVALID_ARGUMENT || first != SSPO_ERROR_DISCONNECTED || second != SSPO_ERROR_DISCONNECTED)
+		{
+			std::printf ("FAIL a null buffer gave %d, blocks after the daemon went gave %d then %d\n", refused, first, second);
+			++failures;
+		}
+	}
+
+	sspo_client_disconnect (client);
+	std::printf ("%d failures\n", failures);
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+// Checks that DynamicEq, its detector held below the threshold, runs the same band as the
+// static Peak, Low Shelf and High Shelf types at every sample rate, frequency, Q and gain,
+// that above the threshold its gain settles where the ratio and range put it, and that
+// EnvelopeFollower reaches a steady level, attacks and releases with the time constants
+// it was given and follows the same level however a signal is chunked. Exits non zero on
+// any failure.
+//
+// usage: sspo_filter_dynamic_eq_test [--verbose]
+
+#include "TestSignals.h"
+#include "dsp/DynamicEq.h"
+#include "dsp/EnvelopeFollower.h"
+#include "dsp/Filter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+	constexpr int k_length = 1 << 15;
+	constexpr int k_blockSize = 512;
+	constexpr int k_controlInterval = 32;
+
+	/// DynamicEq takes its gain from a table within 0.005 dB, the rest of the design is shared
+	constexpr double k_minSnrDb = 60.0;
+
+	double snrDb (const std::vector<float>& reference, const std::vector<float>& actual)
+	{
+		double signal = 0.0, error = 0.0;
+		for (size_t i = 0; i < reference.size (); ++i)
+		{
+			signal += static_cast<double> (reference[i]) * reference[i];
+			const auto e = static_cast<double> (reference[i]) - actual[i];
+			error += e * e;
+		}
+		if (error == 0.0) return 999.0;
+		return 10.0 * std::log10 (signal / error);
+	}
+
+	/// the gain, in dB, DynamicEq settles on for a sine of amplitude, from its static gain
+	float settledGain (float amplitude, float gainDb, float thresholdDb, float ratio, float rangeDb)
+	{
+		const auto over = 20.0f * log10f (amplitude / sqrtf (2.0f)) - thresholdDb;
+		const auto change = over > 0.0f ? std::min (over * (1.0f - 1.0f / ratio), fabsf (rangeDb)) : 0.0f;
+		return gainDb + (rangeDb < 0.0f ? -change : change);
+	}
+}
+
+int main (int argc, char* argv[])
+{
+	const auto verbose = argc > 1 && std::strcmp (argv[1], "--verbose") == 0;
+	auto failures = 0, checks = 0;
+	const auto check = [&] (bool pass, const std::string& what)
+	{
+		++checks;
+		if (!pass) ++failures;
+		if (!pass || verbose) std::printf ("%s %s\n", pass ? "ok  " : "FAIL", what.c_str ());
+	};
+
+	const int sampleRates[] = { 44100, 48000, 96000 };
+	const float freqs[] = { 100.0f, 1000.0f, 8000.0f };
+	const float qs[] = { 0.707f, 4.0f };
+	const float gains[] = { -12.0f, 4.3f, 12.0f };
+	const char* typeNames[] = { "Peak", "Low Shelf", "High Shelf" };
+
+	// held below the threshold, the noise is -11 dB RMS, the band is the static type
+	const auto noise = testsignals::noise (k_length);
+	auto worstSnr = 999.0;
+	for (auto typeName : typeNames)
+	{
+		const auto shape = DynamicEq::shapeForType (typeName);
+		const auto types = MultiFilter::typeStings ();
+		const auto type = static_cast<int> (std::find (types.begin (), types.end (), typeName) - types.begin ());
+		for (auto sr : sampleRates)
+			for (auto freq : freqs)
+				for (auto Q : qs)
+					for (auto gain : gains)
+					{
+						MultiFilter reference;
+						reference.setSampleRate (sr);
+						reference.setTypeIndex (type, freq, Q, gain);
+
+						DynamicEq band;
+						band.prepare (sr, k_controlInterval);
+						band.setShape (static_cast<DynamicEq::Shape> (shape));
+						band.setParameters (freq, Q, gain);
+						band.setDynamics (0.0f, 4.0f, -12.0f, 5.0f, 100.0f);
+
+						auto expected = noise, actual = noise;
+						for (auto start = 0; start < k_length; start += k_blockSize)
+						{
+							reference.processBlock (expected.data () + start, k_blockSize);
+							band.process (actual.data () + start, nullptr, k_blockSize);
+						}
+
+						const auto snr = snrDb (expected, actual);
+						worstSnr = std::min (worstSnr, snr);
+						char what[160];
+						std::snprintf (what, sizeof (what), "%s %d Hz %g Hz Q %g %+g dB below threshold, %.1f dB SNR, at %+.2f dB",
+							typeName, sr, freq, Q, gain, snr, band.getCurrentGain ());
+						check (snr >= k_minSnrDb && std::fabs (band.getCurrentGain () - gain) < 1.0e-6f, what);
+					}
+	}
+	std::printf ("below the threshold, worst %.1f dB SNR against the static types\n", worstSnr);
+
+	// above the threshold the gain settles where the ratio and the range put it
+	{
+		struct Dynamics { float gain, threshold, ratio, range; };
+		const Dynamics cases[] = { { 0.0f, -30.0f, 4.0f, -12.0f }, { 0.0f, -30.0f, 2.0f, -40.0f }, { 3.0f, -20.0f, 4.0f, 6.0f }, { -6.0f, 0.0f, 4.0f, -12.0f } };
+		constexpr auto amplitude = 0.9f;
+		constexpr auto sr = 48000;
+		for (const auto& d : cases)
+		{
+			DynamicEq band;
+			band.prepare (sr, k_controlInterval);
+			band.setShape (DynamicEq::peak);
+			band.setParameters (2000.0f, 1.0f, d.gain);
+			band.setDynamics (d.threshold, d.ratio, d.range, 5.0f, 100.0f);
+
+			// a second of a sine with a whole cycle per control interval, every chunk the same level
+			std::vector<float> block (k_blockSize), detector (k_blockSize);
+			for (auto start = 0; start < sr; start += k_blockSize)
+			{
+				for (auto i = 0; i < k_blockSize; ++i)
+					block[i] = detector[i] = amplitude * static_cast<float> (std::sin (2.0 * LD_PI * 1500.0 * (start + i) / sr));
+				band.process (block.data (), detector.data (), k_blockSize);
+			}
+
+			const auto expected = settledGain (amplitude, d.gain, d.threshold, d.ratio, d.range);
+			char what[160];
+			std::snprintf (what, sizeof (what), "%+g dB, threshold %g ratio %g range %+g settles at %+.2f dB, expected %+.2f",
+				d.gain, d.threshold, d.ratio, d.range, band.getCurrentGain (), expected);
+			check (std::fabs (band.getCurrentGain () - expected) < 0.1f, what);
+		}
+	}
+
+	// the follower
+	{
+		constexpr auto sr = 48000;
+		EnvelopeFollower follower;
+		follower.prepare (sr, k_controlInterval);
+		follower.setAttackRelease (10.0f, 100.0f);
+
+		std::vector<float> chunk (k_controlInterval, 1.0f);
+		check (follower.getLevel () == 0.0f, "starts silent");
+
+		// a time constant is a whole number of chunks, 10 ms is 15 and 100 ms is 150
+		auto level = 0.0f;
+		for (auto i = 0; i < 15; ++i) level = follower.process (chunk.data (), k_controlInterval);
+		check (std::fabs (level - std::sqrt (1.0f - std::exp (-1.0f))) < 1.0e-4f, "attacks by 1 - 1 / e in its attack time, " + std::to_string (level));
+
+		for (auto i = 0; i < 1000; ++i) level = follower.process (chunk.data (), k_controlInterval);
+		check (std::fabs (level - 1.0f) < 1.0e-5f, "settles on the RMS level, " + std::to_string (level));
+
+		std::fill (chunk.begin (), chunk.end (), 0.0f);
+		for (auto i = 0; i < 150; ++i) level = follower.process (chunk.data (), k_controlInterval);
+		check (std::fabs (level - std::exp (-0.5f)) < 1.0e-4f, "releases to 1 / e of the mean square in its release time, " + std::to_string (level));
+
+		follower.clear ();
+		check (follower.getLevel () == 0.0f, "clear silences it");
+
+		// a sine's RMS, over chunks of any length, which with the attack and release apart
+		// would lean towards the louder chunks
+		EnvelopeFollower whole, halves, odd;
+		for (auto* f : { &whole, &halves, &odd })
+		{
+			f->prepare (sr, k_controlInterval);
+			f->setAttackRelease (50.0f, 50.0f);
+		}
+		std::vector<float> sine (sr / 2);
+		for (size_t i = 0; i < sine.size (); ++i) sine[i] = 0.5f * static_cast<float> (std::sin (2.0 * LD_PI * 750.0 * i / sr));
+		for (size_t i = 0; i < sine.size (); i += k_controlInterval) whole.process (sine.data () + i, k_controlInterval);
+		for (size_t i = 0; i < sine.size (); i += k_controlInterval / 2) halves.process (sine.data () + i, k_controlInterval / 2);
+		for (size_t i = 0; i < sine.size (); i += 48) odd.process (sine.data () + i, 48);
+		const auto rms = 0.5f / std::sqrt (2.0f);
+		char what[160];
+		std::snprintf (what, sizeof (what), "a sine's RMS %.5f in chunks of 32 %.5f, 16 %.5f and 48 %.5f", rms, whole.getLevel (), halves.getLevel (), odd.getLevel ());
+		check (std::fabs (whole.getLevel () - rms) < 1.0e-3f && std::fabs (halves.getLevel () - rms) < 1.0e-3f && std::fabs (odd.getLevel () - rms) < 1.0e-3f, what);
+
+		EnvelopeFollower instant;
+		instant.prepare (sr, k_controlInterval);
+		instant.setAttackRelease (0.0f, 0.0f);
+		instant.process (sine.data (), k_controlInterval);
+		const auto settled = instant.process (chunk.data (), k_controlInterval);
+		check (settled == 0.0f, "no attack or release follows each chunk");
+	}
+
+	std::printf ("%d of %d dynamic eq checks failed\n", failures, checks);
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,885 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+// Renders impulse, sweep and noise stimuli through every MultiFilter type, across sample
+// rates, cutoffs and Q values, and checks the float output against the double precision
+// reference designs in ReferenceFilters.h, as well as a FixedBiquad of each type, and
+// checks that out of place processing matches in place, the parametric eq's cascade, the
+// batch designs and the fixed point path on 24 bit input, against the float path. The
+// Ladder, which saturates, is checked against its double precision transcription instead,
+// along with fastTanh and how far the oversampling keeps its harmonics from aliasing.
+// Exits non zero on any failure.
+//
+// usage: sspo_filter_accuracy_test [--verbose]
+
+#include "ReferenceFilters.h"
+#include "TestSignals.h"
+#include "dsp/DspArena.h"
+#include "dsp/Filter.h"
+#include "dsp/FixedBiquad.h"
+#include "dsp/FixedPointBiquad.h"
+#include "dsp/ParallelIir.h"
+#include "dsp/ParametricEq.h"
+#include "dsp/PresetBank.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+	constexpr int k_length = 1 << 15;
+	constexpr int k_blockSize = 512;
+
+	/// the error allowed, in dB below the reference signal
+	constexpr double k_minSnrDb = 60.0;
+
+	/// and for sections whose poles lie within this distance of the unit circle, low cutoffs
+	/// at high Q, where rounding the coefficients to float alone detunes the resonance a
+	/// little, which the error measure magnifies, -32 dB for LP24 60Hz Q 4 at 48kHz
+	constexpr double k_nearUnitCircle = 1.0e-2;
+	constexpr double k_minSnrDbNearUnitCircle = 26.0;
+
+	/// the Ladder's error against std::tanh in double precision, at these levels its stages
+	/// stay where fastTanh is within 3e-5 of tanh, the worst is 95 dB for a sweep at 60Hz Q 4
+	constexpr double k_minSnrDbLadder = 80.0;
+
+	/// offline rendering against the exact result of the same float coefficients, the worst
+	/// is 59 dB for HP24 60Hz Q 4 at 96kHz. processBlock rounds differently, it is as little as
+	/// 40 dB from the same result for LP24 there, so the two are only compared, not held together
+	constexpr double k_minSnrDbOffline = 55.0;
+
+	/// the largest alias of a full scale 5kHz sine at 48kHz driven +18dB into the Ladder,
+	/// below the fundamental, it is -16dB without the oversampling
+	constexpr double k_maxAliasDb = -50.0;
+
+	struct Stimulus
+	{
+		const char* name;
+		std::vector<float> samples;
+	};
+
+	double snrDb (const std::vector<double>& reference, const std::vector<float>& actual)
+	{
+		double signal = 0.0, error = 0.0;
+		for (size_t i = 0; i < reference.size (); ++i)
+		{
+			const auto e = actual[i] - reference[i];
+			signal += reference[i] * reference[i];
+			error += e * e;
+		}
+		if (error == 0.0) return 999.0;
+		if (signal == 0.0) return -999.0;
+		return 10.0 * std::log10 (signal / error);
+	}
+
+	/// the largest pole radius of the cascade, the poles of 1 + b1 z^-1 + b2 z^-2
+	double maxPoleRadius (const std::vector<reference::Biquad>& cascade)
+	{
+		double radius = 0.0;
+		for (const auto& s : cascade)
+		{
+			const auto disc = s.b1 * s.b1 - 4.0 * s.b2;
+			if (disc < 0.0) radius = std::max (radius, std::sqrt (s.b2));
+			else
+			{
+				const auto root = std::sqrt (disc);
+				radius = std::max ({ radius, std::fabs (-s.b1 + root) * 0.5, std::fabs (-s.b1 - root) * 0.5 });
+			}
+		}
+		return radius;
+	}
+
+	/// the level of the component at freq in signal[start, start + n), in dB, through a Blackman-Harris window
+	double componentDb (const std::vector<float>& signal, int start, int n, double freq, double sampleRate)
+	{
+		double re = 0.0, im = 0.0, windowSum = 0.0;
+		for (auto i = 0; i < n; ++i)
+		{
+			const auto phase = 2.0 * reference::k_pi * i / n;
+			const auto w = 0.35875 - 0.48829 * std::cos (phase) + 0.14128 * std::cos (2.0 * phase) - 0.01168 * std::cos (3.0 * phase);
+			const auto theta = 2.0 * reference::k_pi * freq * i / sampleRate;
+			re += signal[start + i] * w * std::cos (theta);
+			im += signal[start + i] * w * std::sin (theta);
+			windowSum += w;
+		}
+		return 20.0 * std::log10 (2.0 * std::sqrt (re * re + im * im) / windowSum + 1.0e-30);
+	}
+
+	///
+	/// \brief checkFixed
+	/// A FixedBiquad against the reference for the same runtime type name, returns the number of failures
+	template <typename Fixed>
+	int checkFixed (const char* name, double freq, double Q, double gain, const std::vector<float>& stimulus, bool verbose)
+	{
+		auto cascade = reference::design (name, { 48000.0, freq, Q, gain });
+		const auto minSnr = 1.0 - maxPoleRadius (cascade) < k_nearUnitCircle ? k_minSnrDbNearUnitCircle : k_minSnrDb;
+
+		Fixed filter;
+		auto actual = stimulus;
+		filter.processBlock (actual.data (), static_cast<int> (actual.size ()));
+		std::vector<double> expected;
+		reference::process (cascade, stimulus, expected);
+
+		const auto snr = snrDb (expected, actual);
+		const auto pass = snr >= minSnr;
+		if (!pass || verbose)
+			std::printf ("%s fixed %-10s f %6.0f Q %5.3f gain %5.1f  snr %6.1f dB (min %4.1f)\n",
+				pass ? "ok  " : "FAIL", name, freq, Q, gain, snr, minSnr);
+		return pass ? 0 : 1;
+	}
+}
+
+int main (int argc, char* argv[])
+{
+	const auto verbose = argc > 1 && std::strcmp (argv[1], "--verbose") == 0;
+
+	const double sampleRates[] = { 44100.0, 48000.0, 96000.0 };
+	const double cutoffs[] = { 60.0, 1000.0, 12000.0 };
+	const double qs[] = { 0.5, 0.707, 4.0 };
+	const double gains[] = { -12.0, 6.0 };
+
+	auto checks = 0, failures = 0;
+	MultiFilter probe;
+	for (auto sr : sampleRates)
+	{
+		const Stimulus stimuli[] = {
+			{ "impulse", testsignals::impulse (k_length) },
+			{ "sweep", testsignals::sweep (k_length, sr) },
+			{ "noise", testsignals::noise (k_length) } };
+
+		for (auto type = 0; type < static_cast<int> (MultiFilter::typeStings ().size ()); ++type)
+		{
+			// the Ladder's sections are only its small signal response, it has its own check below
+			if (!probe.isLinear (type)) continue;
+			const auto name = MultiFilter::typeStings ().at (type);
+			for (auto freq : cutoffs)
+				for (auto Q : qs)
+					for (auto gain : gains)
+					{
+						auto cascade = reference::design (name, { sr, freq, Q, gain });
+						if (cascade.empty ())
+						{
+							std::printf ("FAIL %s has no reference design\n", name.c_str ());
+							++failures;
+							continue;
+						}
+						const auto nearUnitCircle = 1.0 - maxPoleRadius (cascade) < k_nearUnitCircle;
+						const auto minSnr = nearUnitCircle ? k_minSnrDbNearUnitCircle : k_minSnrDb;
+
+						for (const auto& stimulus : stimuli)
+						{
+							MultiFilter filter;
+							filter.setSampleRate (static_cast<int> (sr));
+							filter.setTypeIndex (type, static_cast<float> (freq), static_cast<float> (Q), static_cast<float> (gain));
+
+							auto actual = stimulus.samples;
+							for (auto i = 0; i < k_length; i += k_blockSize) filter.processBlock (actual.data () + i, std::min (k_blockSize, k_length - i));
+
+							for (auto& s : cascade) s.z1 = s.z2 = 0.0;
+							std::vector<double> expected;
+							reference::process (cascade, stimulus.samples, expected);
+
+							const auto snr = snrDb (expected, actual);
+							const auto pass = snr >= minSnr;
+							++checks;
+							if (!pass) ++failures;
+							if (!pass || verbose)
+								std::printf ("%s %-10s %-7s sr %6.0f f %6.0f Q %5.3f gain %5.1f  snr %6.1f dB (min %4.1f)\n",
+									pass ? "ok  " : "FAIL", name.c_str (), stimulus.name, sr, freq, Q, gain, snr, minSnr);
+						}
+					}
+		}
+	}
+
+	// the Ladder against its double precision transcription, the same stimuli, driven and not
+	{
+		const auto ladder = static_cast<int> (MultiFilter::typeStings ().size ()) - 1;
+		for (auto sr : sampleRates)
+		{
+			const Stimulus stimuli[] = {
+				{ "impulse", testsignals::impulse (k_length) },
+				{ "sweep", testsignals::sweep (k_length, sr) },
+				{ "noise", testsignals::noise (k_length) } };
+
+			for (auto freq : cutoffs)
+				for (auto Q : qs)
+					for (auto gain : gains)
+						for (const auto& stimulus : stimuli)
+						{
+							MultiFilter filter;
+							filter.setSampleRate (static_cast<int> (sr));
+							filter.setTypeIndex (ladder, static_cast<float> (freq), static_cast<float> (Q), static_cast<float> (gain));
+
+							auto actual = stimulus.samples;
+							for (auto i = 0; i < k_length; i += k_blockSize) filter.processBlock (actual.data () + i, std::min (k_blockSize, k_length - i));
+
+							reference::Ladder expectedLadder ({ sr, freq, Q, gain });
+							std::vector<double> expected;
+							expectedLadder.process (stimulus.samples, expected);
+
+							const auto snr = snrDb (expected, actual);
+							const auto pass = snr >= k_minSnrDbLadder;
+							++checks;
+							if (!pass) ++failures;
+							if (!pass || verbose)
+								std::printf ("%s Ladder     %-7s sr %6.0f f %6.0f Q %5.3f gain %5.1f  snr %6.1f dB (min %4.1f)\n",
+									pass ? "ok  " : "FAIL", stimulus.name, sr, freq, Q, gain, snr, k_minSnrDbLadder);
+						}
+		}
+
+		// fastTanh against tanh, and the four at once against one at a time
+		auto worst = 0.0, worstToTwo = 0.0;
+		auto matches = true;
+		for (auto i = -40000; i <= 40000; i += 4)
+		{
+			float x[4], four[4];
+			for (auto l = 0; l < 4; ++l) x[l] = (i + l) * 2.5e-4f;
+			fastTanhXdX4 (x, four);
+			for (auto l = 0; l < 4; ++l)
+			{
+				const auto error = std::fabs (fastTanh (x[l]) - std::tanh (static_cast<double> (x[l])));
+				worst = std::max (worst, error);
+				if (std::fabs (x[l]) <= 2.0f) worstToTwo = std::max (worstToTwo, error);
+				matches = matches && four[l] == fastTanhXdX (x[l]);
+			}
+		}
+		const auto large = fastTanh (1.0e30f) == 1.0f && fastTanh (-1.0e30f) == -1.0f && fastTanhXdX (0.0f) == 1.0f;
+		const auto tanhPass = worst <= 1.5e-3 && worstToTwo <= 3.0e-5 && matches && large;
+		++checks;
+		if (!tanhPass) ++failures;
+		if (!tanhPass || verbose)
+			std::printf ("%s fastTanh error %.2e, %.2e to |x| 2, four at once %s\n", tanhPass ? "ok  " : "FAIL", worst, worstToTwo, matches ? "match" : "differ");
+
+		// a full scale 5kHz sine driven hard, its odd harmonics above 24kHz fold back to
+		// 3, 7, 13 and 17kHz unless the oversampler removes them first, 23kHz is left out as
+		// the 25kHz harmonic there lies in the halfband's transition
+		{
+			constexpr int k_sineLength = 1 << 16;
+			std::vector<float> sine (k_sineLength);
+			for (auto i = 0; i < k_sineLength; ++i) sine[i] = static_cast<float> (std::sin (2.0 * reference::k_pi * 5000.0 * i / 48000.0));
+
+			MultiFilter filter;
+			filter.setSampleRate (48000);
+			filter.setTypeIndex (ladder, 20000.0f, 0.5f, 18.0f);
+			filter.processBlock (sine.data (), k_sineLength);
+
+			const auto half = k_sineLength / 2;
+			const auto fundamental = componentDb (sine, half, half, 5000.0, 48000.0);
+			auto alias = -999.0;
+			for (auto freq : { 3000.0, 7000.0, 13000.0, 17000.0 })
+				alias = std::max (alias, componentDb (sine, half, half, freq, 48000.0) - fundamental);
+			const auto pass = alias <= k_maxAliasDb;
+			++checks;
+			if (!pass) ++failures;
+			if (!pass || verbose)
+				std::printf ("%s Ladder aliasing %6.1f dB (max %4.1f)\n", pass ? "ok  " : "FAIL", alias, k_maxAliasDb);
+		}
+
+		// offline rendering has to fall back to running it serially, long enough to be split
+		// into chunks were it linear, and the paths that store biquads have to refuse it
+		{
+			const auto noise = testsignals::noise (ParallelIirRenderer::k_minChunkSize * 4 + 123);
+			MultiFilter serial, offline;
+			for (auto* f : { &serial, &offline })
+			{
+				f->setSampleRate (48000);
+				f->setTypeIndex (ladder, 1000.0f, 4.0f, 12.0f);
+			}
+			auto serialOut = noise, offlineOut = noise;
+			serial.processBlock (serialOut.data (), static_cast<int> (serialOut.size ()));
+			ParallelIirRenderer (4).process (offline, offlineOut.data (), static_cast<int64_t> (offlineOut.size ()));
+
+			const auto dir = std::string (std::getenv ("TMPDIR") != nullptr ? std::getenv ("TMPDIR") : "/tmp");
+			PresetBankWriter writer;
+			writer.addSampleRate (48000);
+			writer.addPreset ({ "ladder", ladder, 1000.0f, 4.0f, 12.0f });
+
+			const int types[] = { 2, ladder };
+			const float freqs[] = { 1000.0f, 1000.0f }, Qs[] = { 1.0f, 1.0f }, batchGains[] = { 0.0f, 0.0f }, rates[] = { 48000.0f, 48000.0f };
+			CoefficientBank bank;
+			FixedPointFilter fixedFilter;
+
+			const auto pass = offlineOut == serialOut
+				&& !writer.write (dir + "/sspo_accuracy_ladder.bank")
+				&& designCoefficientBatch (types, freqs, Qs, batchGains, rates, 1, bank)
+				&& !designCoefficientBatch (types, freqs, Qs, batchGains, rates, 2, bank)
+				&& !fixedFilter.design (offline) && fixedFilter.getNumSections () == 0;
+			++checks;
+			if (!pass) ++failures;
+			if (!pass || verbose)
+				std::printf ("%s Ladder offline matches serial, refused by the bank, batch and fixed point paths\n", pass ? "ok  " : "FAIL");
+		}
+	}
+
+	// out of place processing, through processChannels, must match in place exactly and leave the input alone
+	{
+		const auto noise = testsignals::noise (k_length);
+		for (auto type = 0; type < static_cast<int> (MultiFilter::typeStings ().size ()); ++type)
+		{
+			for (auto controlRate : { 0, 32 })
+			{
+				std::vector<std::unique_ptr<MultiFilter>> inPlace, outOfPlace;
+				for (auto* filters : { &inPlace, &outOfPlace })
+				{
+					filters->push_back (std::make_unique<MultiFilter> ());
+					filters->back ()->setSampleRate (48000);
+					filters->back ()->setTypeIndex (type, 1000.0f, 0.707f, 6.0f);
+					filters->back ()->setControlRate (controlRate);
+				}
+
+				auto expected = noise;
+				auto input = noise;
+				std::vector<float> actual (noise.size ());
+				for (auto i = 0; i < k_length; i += k_blockSize)
+				{
+					const auto n = std::min (k_blockSize, k_length - i);
+					inPlace[0]->processBlock (expected.data () + i, n);
+
+					const float* inChannels[] = { input.data () + i };
+					float* outChannels[] = { actual.data () + i };
+					processChannels (outOfPlace, ConstAudioSpan{ inChannels, 1, n }, AudioSpan{ outChannels, 1, n });
+				}
+
+				const auto pass = actual == expected && input == noise;
+				++checks;
+				if (!pass) ++failures;
+				if (!pass || verbose)
+					std::printf ("%s out of place %-10s control rate %d\n", pass ? "ok  " : "FAIL", MultiFilter::typeStings ().at (type).c_str (), controlRate);
+			}
+		}
+	}
+
+	// the parametric eq's cascade against the bands' references in series, odd block sizes
+	// so chunks end part way through a kernel step
+	{
+		const ParametricEq::Band bands[] = {
+			{ true, 6, 80.0f, 0.707f, 4.0f }, { true, 8, 300.0f, 2.0f, -6.0f }, { false, 8, 700.0f, 1.0f, 9.0f },
+			{ true, 2, 16000.0f, 0.707f, 0.0f }, { true, 8, 3000.0f, 4.0f, 0.0f }, { true, 7, 9000.0f, 0.707f, -3.0f } };
+		const std::string typeNames[] = { "Low Shelf", "Peak", "", "LP24", "", "High Shelf" };
+		const auto noise = testsignals::noise (k_length);
+
+		ParametricEq eq;
+		eq.prepare (48000, 1);
+		std::vector<reference::Biquad> cascade;
+		for (auto band = 0; band < static_cast<int> (std::size (bands)); ++band)
+		{
+			eq.setBand (band, bands[band]);
+			if (typeNames[band].empty ()) continue;
+			for (const auto& s : reference::design (typeNames[band], { 48000.0, bands[band].freq, bands[band].Q, bands[band].gain }))
+				cascade.push_back (s);
+		}
+
+		auto actual = noise;
+		for (auto i = 0; i < k_length; i += 333)
+		{
+			float* channels[] = { actual.data () + i };
+			eq.process (AudioSpan{ channels, 1, std::min (333, k_length - i) });
+		}
+		std::vector<double> expected;
+		reference::process (cascade, noise, expected);
+
+		const auto snr = snrDb (expected, actual);
+		const auto pass = snr >= k_minSnrDb && eq.getNumActiveSections () == 5;
+		++checks;
+		if (!pass) ++failures;
+		if (!pass || verbose)
+			std::printf ("%s parametric eq %d sections  snr %6.1f dB (min %4.1f)\n", pass ? "ok  " : "FAIL", eq.getNumActiveSections (), snr, k_minSnrDb);
+	}
+
+	// a band at 0dB has no section running, when it leaves 0dB its section starts from
+	// silence at the next block rather than from where it stopped, while the bands around
+	// it carry on uninterrupted
+	{
+		const auto noise = testsignals::noise (k_length);
+		const int starts[] = { 0, k_length / 4, k_length / 2, k_length };
+		const float peakGains[] = { 6.0f, 0.0f, 6.0f };
+		ParametricEq eq;
+		eq.prepare (48000, 1);
+		eq.setBand (0, { true, 6, 200.0f, 0.707f, 4.0f });
+
+		auto actual = noise;
+		int sections[3];
+		for (auto i = 0; i < 3; ++i)
+		{
+			eq.setBand (1, { true, 8, 1000.0f, 2.0f, peakGains[i] });
+			float* channels[] = { actual.data () + starts[i] };
+			eq.process (AudioSpan{ channels, 1, starts[i + 1] - starts[i] });
+			sections[i] = eq.getNumActiveSections ();
+		}
+
+		auto shelf = reference::design ("Low Shelf", { 48000.0, 200.0, 0.707, 4.0 });
+		std::vector<double> shelved, expected;
+		reference::process (shelf, noise, shelved);
+		for (auto i = 0; i < 3; ++i)
+		{
+			std::vector<double> segment (shelved.begin () + starts[i], shelved.begin () + starts[i + 1]);
+			if (peakGains[i] != 0.0f)
+			{
+				auto peak = reference::design ("Peak", { 48000.0, 1000.0, 2.0, peakGains[i] });
+				reference::process (peak, std::vector<float> (segment.begin (), segment.end ()), segment);
+			}
+			expected.insert (expected.end (), segment.begin (), segment.end ());
+		}
+
+		const auto snr = snrDb (expected, actual);
+		const auto pass = snr >= k_minSnrDb && sections[0] == 2 && sections[1] == 1 && sections[2] == 2;
+		++checks;
+		if (!pass) ++failures;
+		if (!pass || verbose)
+			std::printf ("%s parametric eq band leaving 0dB  snr %6.1f dB (min %4.1f)\n", pass ? "ok  " : "FAIL", snr, k_minSnrDb);
+	}
+
+	// a chain takes any number of stages, past k_maxStages as well as up to it
+	{
+		const auto noise = testsignals::noise (k_length);
+		const auto numStages = FilterChain::k_maxStages + 2;
+		struct PeakChain : FilterChain
+		{
+			bool getUseGain () noexcept override { return true; }
+			bool getUseQ () noexcept override { return true; }
+		} chain;
+		std::vector<reference::Biquad> cascade;
+		for (auto i = 0; i < numStages; ++i)
+		{
+			const auto freq = 200.0f * (i + 1);
+			const auto gain = i % 2 == 0 ? 3.0f : -2.0f;
+			auto stage = std::make_unique<PeakFilter> ();
+			stage->setSampleRate (48000);
+			stage->setParameters (freq, 2.0f, gain);
+			chain.push_back (std::move (stage));
+			for (const auto& s : reference::design ("Peak", { 48000.0, freq, 2.0, gain }))
+				cascade.push_back (s);
+		}
+
+		auto actual = noise;
+		chain.process (noise.data (), actual.data (), k_length);
+		std::vector<double> expected;
+		reference::process (cascade, noise, expected);
+
+		const auto snr = snrDb (expected, actual);
+		const auto pass = snr >= k_minSnrDb;
+		++checks;
+		if (!pass) ++failures;
+		if (!pass || verbose)
+			std::printf ("%s filter chain of %d stages  snr %6.1f dB (min %4.1f)\n", pass ? "ok  " : "FAIL", numStages, snr, k_minSnrDb);
+	}
+
+	// the same eq with its state, and a filter per channel, laid out in an arena as the
+	// plugin does, each on its own cache line, must give the same samples
+	{
+		const auto noise = testsignals::noise (k_length);
+		constexpr int k_channels = 3;
+		DspArena arena;
+		arena.reserve (DspArena::footprint<MultiFilter> (k_channels) + DspArena::footprint<ParametricEq> () + ParametricEq::stateFootprint (k_channels));
+
+		auto pass = true;
+		MultiFilter* filters[k_channels];
+		for (auto& f : filters)
+		{
+			f = arena.create<MultiFilter> ();
+			pass = pass && f != nullptr && reinterpret_cast<uintptr_t> (f) % DspArena::k_alignment == 0;
+		}
+		auto* arenaEq = arena.create<ParametricEq> ();
+		arenaEq->prepare (48000, k_channels, arena);
+		pass = pass && arena.getUsed () == arena.getCapacity () && arena.create<MultiFilter> () == nullptr;
+
+		ParametricEq heapEq;
+		heapEq.prepare (48000, k_channels);
+		for (auto* eq : { arenaEq, &heapEq })
+		{
+			eq->setBand (0, { true, 8, 300.0f, 2.0f, -6.0f });
+			eq->setBand (1, { true, 2, 9000.0f, 0.707f, 0.0f });
+		}
+
+		std::vector<std::vector<float>> arenaOut (k_channels, noise), heapOut (k_channels, noise), filterOut (k_channels, noise), expected (k_channels, noise);
+		for (auto c = 0; c < k_channels; ++c)
+		{
+			filters[c]->setSampleRate (48000);
+			filters[c]->setTypeIndex (2 + c, 1000.0f, 0.707f, 6.0f);
+			MultiFilter reference;
+			reference.setSampleRate (48000);
+			reference.setTypeIndex (2 + c, 1000.0f, 0.707f, 6.0f);
+			reference.processBlock (expected[c].data (), k_length);
+			filters[c]->processBlock (filterOut[c].data (), k_length);
+		}
+		float* arenaChannels[k_channels];
+		float* heapChannels[k_channels];
+		for (auto c = 0; c < k_channels; ++c)
+		{
+			arenaChannels[c] = arenaOut[c].data ();
+			heapChannels[c] = heapOut[c].data ();
+		}
+		arenaEq->process (AudioSpan{ arenaChannels, k_channels, k_length });
+		heapEq.process (AudioSpan{ heapChannels, k_channels, k_length });
+
+		pass = pass && arenaOut == heapOut && filterOut == expected;
+		++checks;
+		if (!pass) ++failures;
+		if (!pass || verbose)
+			std::printf ("%s arena laid out %zu bytes\n", pass ? "ok  " : "FAIL", arena.getUsed ());
+	}
+
+	// the batch designs, every type, cutoff, Q and gain at once, each run in double
+	// precision so that only the designs are compared with the reference
+	{
+		std::vector<int> types;
+		std::vector<float> batchFreqs, batchQs, batchGains, batchRates;
+		for (auto sr : sampleRates)
+			for (auto type = 0; type < static_cast<int> (MultiFilter::typeStings ().size ()); ++type)
+			{
+				// the batch designs only the biquad types
+				if (!probe.isLinear (type)) continue;
+				for (auto freq : cutoffs)
+					for (auto Q : qs)
+						for (auto gain : gains)
+						{
+							types.push_back (type);
+							batchFreqs.push_back (static_cast<float> (freq));
+							batchQs.push_back (static_cast<float> (Q));
+							batchGains.push_back (static_cast<float> (gain));
+							batchRates.push_back (static_cast<float> (sr));
+						}
+			}
+
+		CoefficientBank bank;
+		if (!designCoefficientBatch (types.data (), batchFreqs.data (), batchQs.data (), batchGains.data (), batchRates.data (), static_cast<int> (types.size ()), bank))
+		{
+			std::printf ("FAIL batch refused a linear type\n");
+			++failures;
+		}
+
+		const auto noise = testsignals::noise (k_length);
+		for (auto i = 0; i < bank.size (); ++i)
+		{
+			const auto name = MultiFilter::typeStings ().at (types[i]);
+			auto expectedCascade = reference::design (name, { batchRates[i], batchFreqs[i], batchQs[i], batchGains[i] });
+			const auto c = bank.get (i);
+			std::vector<reference::Biquad> batchCascade (expectedCascade.size (), { c.m_a0, c.m_a1, c.m_a2, c.m_b1, c.m_b2, c.m_c0, c.m_d0 });
+
+			std::vector<double> expected, batch;
+			reference::process (expectedCascade, noise, expected);
+			reference::process (batchCascade, noise, batch);
+			const std::vector<float> actual (batch.begin (), batch.end ());
+
+			const auto minSnr = 1.0 - maxPoleRadius (expectedCascade) < k_nearUnitCircle ? k_minSnrDbNearUnitCircle : k_minSnrDb;
+			const auto snr = snrDb (expected, actual);
+			const auto pass = snr >= minSnr;
+			++checks;
+			if (!pass) ++failures;
+			if (!pass || verbose)
+				std::printf ("%s batch %-10s sr %6.0f f %6.0f Q %5.3f gain %5.1f  snr %6.1f dB (min %4.1f)\n",
+					pass ? "ok  " : "FAIL", name.c_str (), batchRates[i], batchFreqs[i], batchQs[i], batchGains[i], snr, minSnr);
+		}
+	}
+
+	// a sample rate that is 0, negative or NaN can't be designed for, the batch passes those
+	// filters straight through, as it does a type it has no design for
+	{
+		const int types[] = { 2, 8, 6, 8 };
+		const float freqs[] = { 1000.0f, 1000.0f, 200.0f, 1000.0f }, Qs[] = { 0.707f, 2.0f, 0.707f, 2.0f };
+		const float batchGains[] = { 0.0f, 6.0f, 6.0f, 6.0f }, rates[] = { 0.0f, -48000.0f, std::nanf (""), 48000.0f };
+		CoefficientBank bank;
+		auto pass = !designCoefficientBatch (types, freqs, Qs, batchGains, rates, 4, bank);
+		for (auto i = 0; i < 3; ++i)
+		{
+			const auto c = bank.get (i);
+			pass = pass && c.m_a0 == 1.0f && c.m_a1 == 0.0f && c.m_a2 == 0.0f && c.m_b1 == 0.0f && c.m_b2 == 0.0f
+				&& c.m_c0 == 1.0f && c.m_d0 == 0.0f;
+		}
+		pass = pass && bank.get (3).m_d0 == 1.0f && std::isfinite (bank.get (3).m_c0);
+		++checks;
+		if (!pass) ++failures;
+		if (!pass || verbose)
+			std::printf ("%s batch passes through filters at a rate of 0, below 0 and NaN\n", pass ? "ok  " : "FAIL");
+	}
+
+	// the bank processing straight from its arrays, every filter at once over interleaved
+	// frames, against the exact result of the same float coefficients, the 24dB types
+	// taking their second section from a second pass
+	{
+		std::vector<int> types;
+		std::vector<float> bankFreqs, bankQs, bankGains, bankRates;
+		for (auto type = 0; type < static_cast<int> (MultiFilter::typeStings ().size ()); ++type)
+		{
+			if (!probe.isLinear (type)) continue;
+			for (auto freq : cutoffs)
+			{
+				types.push_back (type);
+				bankFreqs.push_back (static_cast<float> (freq));
+				bankQs.push_back (2.0f);
+				bankGains.push_back (6.0f);
+				bankRates.push_back (48000.0f);
+			}
+		}
+
+		CoefficientBank bank;
+		designCoefficientBatch (types.data (), bankFreqs.data (), bankQs.data (), bankGains.data (), bankRates.data (), static_cast<int> (types.size ()), bank);
+		const auto n = bank.size ();
+		const auto length = k_length / 4;
+		const auto noise = testsignals::noise (length);
+
+		std::vector<float> frames (static_cast<size_t> (length) * n);
+		for (auto f = 0; f < length; ++f)
+			for (auto i = 0; i < n; ++i) frames[static_cast<size_t> (f) * n + i] = noise[f];
+
+		CoefficientBank::SectionState first, second;
+		first.resize (n);
+		second.resize (n);
+		auto once = frames;
+		bank.process (first, once.data (), length);
+		auto twice = once;
+		bank.process (second, twice.data (), length);
+
+		for (auto i = 0; i < n; ++i)
+		{
+			const auto name = MultiFilter::typeStings ().at (types[i]);
+			const auto c = bank.get (i);
+			const auto sections = types[i] == batchDesign::lp24 || types[i] == batchDesign::hp24 ? 2u : 1u;
+			std::vector<reference::Biquad> cascade (sections, { c.m_a0, c.m_a1, c.m_a2, c.m_b1, c.m_b2, c.m_c0, c.m_d0 });
+
+			std::vector<double> expected;
+			reference::process (cascade, noise, expected);
+			const auto& out = sections == 2 ? twice : once;
+			std::vector<float> actual (length);
+			for (auto f = 0; f < length; ++f) actual[f] = out[static_cast<size_t> (f) * n + i];
+
+			const auto minSnr = 1.0 - maxPoleRadius (cascade) < k_nearUnitCircle ? k_minSnrDbNearUnitCircle : k_minSnrDb;
+			const auto snr = snrDb (expected, actual);
+			const auto pass = snr >= minSnr;
+			++checks;
+			if (!pass) ++failures;
+			if (!pass || verbose)
+				std::printf ("%s bank process %-10s f %6.0f  snr %6.1f dB (min %4.1f)\n",
+					pass ? "ok  " : "FAIL", name.c_str (), bankFreqs[i], snr, minSnr);
+		}
+	}
+
+	// offline rendering split across threads, against processBlock and against the exact result
+	// of the same float coefficients in double precision, carrying on from and into serial
+	// processing either side, with chunk boundaries part way through the odd length
+	{
+		const auto length = static_cast<int> (ParallelIirRenderer::k_minChunkSize * 4 + 321);
+		const auto noise = testsignals::noise (length);
+		const auto lead = 1000, tail = 1000;
+		for (auto sr : sampleRates)
+			for (auto type = 0; type < static_cast<int> (MultiFilter::typeStings ().size ()); ++type)
+			{
+				if (!probe.isLinear (type)) continue;
+				const auto name = MultiFilter::typeStings ().at (type);
+				for (auto freq : cutoffs)
+					for (auto Q : qs)
+					{
+						MultiFilter serial, offline;
+						for (auto* f : { &serial, &offline })
+						{
+							f->setSampleRate (static_cast<int> (sr));
+							f->setTypeIndex (type, static_cast<float> (freq), static_cast<float> (Q), 6.0f);
+						}
+						std::vector<BiQuad::BiquadCoeffecients> stages;
+						serial.appendStages (stages);
+						std::vector<reference::Biquad> exactCascade;
+						for (const auto& c : stages) exactCascade.push_back ({ c.m_a0, c.m_a1, c.m_a2, c.m_b1, c.m_b2, c.m_c0, c.m_d0 });
+
+						auto serialOut = noise, offlineOut = noise;
+						for (auto i = 0; i < length; i += k_blockSize)
+							serial.processBlock (serialOut.data () + i, std::min (k_blockSize, length - i));
+						offline.processBlock (offlineOut.data (), lead);
+						ParallelIirRenderer (4).process (offline, offlineOut.data () + lead, length - lead - tail);
+						offline.processBlock (offlineOut.data () + length - tail, tail);
+
+						std::vector<double> exact;
+						reference::process (exactCascade, noise, exact);
+						std::vector<double> serialAsReference (serialOut.begin (), serialOut.end ());
+						const auto serialSnr = snrDb (exact, serialOut);
+						const auto offlineSnr = snrDb (exact, offlineOut);
+						const auto pass = offlineSnr >= k_minSnrDbOffline;
+						++checks;
+						if (!pass) ++failures;
+						if (!pass || verbose)
+							std::printf ("%s offline %-10s sr %6.0f f %6.0f Q %5.3f  snr %6.1f dB (min %4.1f), processBlock %6.1f dB, between them %6.1f dB\n",
+								pass ? "ok  " : "FAIL", name.c_str (), sr, freq, Q, offlineSnr, k_minSnrDbOffline, serialSnr, snrDb (serialAsReference, offlineOut));
+					}
+			}
+	}
+
+	// the fixed point path, 24 bit noise as Q31 through the sections of every design, against
+	// the reference on the same input, with the float path's result alongside. The noise is
+	// at -24dB, as the fixed point output saturates at full scale where the float one does not
+	// and a resonance or boost needs the headroom. The interleaved lanes must match a
+	// FixedPointBiquad per channel exactly
+	{
+		constexpr int k_lanes = 5;
+		std::vector<int32_t> pcm (k_length);
+		std::vector<float> quantised (k_length);
+		const auto noise = testsignals::noise (k_length);
+		for (auto i = 0; i < k_length; ++i)
+		{
+			pcm[i] = fixedPoint::fromPcm24 (static_cast<int32_t> (std::lround (noise[i] * 0.125f * 8388607.0f)));
+			quantised[i] = fixedPoint::toFloat (pcm[i]);
+		}
+
+		for (auto sr : sampleRates)
+			for (auto type = 0; type < static_cast<int> (MultiFilter::typeStings ().size ()); ++type)
+			{
+				// the fixed point path refuses the Ladder, checked above
+				if (!probe.isLinear (type)) continue;
+				const auto name = MultiFilter::typeStings ().at (type);
+				for (auto freq : cutoffs)
+					for (auto Q : qs)
+						for (auto gain : gains)
+						{
+							MultiFilter filter;
+							filter.setSampleRate (static_cast<int> (sr));
+							filter.setTypeIndex (type, static_cast<float> (freq), static_cast<float> (Q), static_cast<float> (gain));
+							FixedPointFilter fixedFilter;
+							fixedFilter.design (filter);
+
+							auto floatOut = quantised;
+							auto fixedOut = pcm;
+							for (auto i = 0; i < k_length; i += k_blockSize)
+							{
+								const auto n = std::min (k_blockSize, k_length - i);
+								filter.processBlock (floatOut.data () + i, n);
+								fixedFilter.processBlock (fixedOut.data () + i, n);
+							}
+							std::vector<float> actual (k_length);
+							std::transform (fixedOut.begin (), fixedOut.end (), actual.begin (), fixedPoint::toFloat);
+
+							auto cascade = reference::design (name, { sr, freq, Q, gain });
+							std::vector<double> expected;
+							reference::process (cascade, quantised, expected);
+
+							const auto minSnr = 1.0 - maxPoleRadius (cascade) < k_nearUnitCircle ? k_minSnrDbNearUnitCircle : k_minSnrDb;
+							const auto floatSnr = snrDb (expected, floatOut);
+							const auto fixedSnr = snrDb (expected, actual);
+							const auto pass = fixedSnr >= minSnr;
+							++checks;
+							if (!pass) ++failures;
+							if (!pass || verbose)
+								std::printf ("%s fixed point %-10s sr %6.0f f %6.0f Q %5.3f gain %5.1f  snr %6.1f dB (min %4.1f, float %6.1f)\n",
+									pass ? "ok  " : "FAIL", name.c_str (), sr, freq, Q, gain, fixedSnr, minSnr, floatSnr);
+						}
+			}
+
+		for (auto type = 0; type < static_cast<int> (MultiFilter::typeStings ().size ()); ++type)
+		{
+			MultiFilter filter;
+			filter.setSampleRate (48000);
+			filter.setTypeIndex (type, 1000.0f, 0.707f, 6.0f);
+			std::vector<BiQuad::BiquadCoeffecients> stages;
+			filter.appendStages (stages);
+
+			FixedPointBiquadLanes<k_lanes> lanes;
+			FixedPointBiquad single[k_lanes];
+			lanes.setCoeffs (stages[0]);
+			std::vector<int32_t> interleaved (k_length * k_lanes);
+			std::vector<int32_t> planar[k_lanes];
+			for (auto l = 0; l < k_lanes; ++l)
+			{
+				single[l].setCoeffs (stages[0]);
+				planar[l].resize (k_length);
+				for (auto i = 0; i < k_length; ++i) planar[l][i] = interleaved[i * k_lanes + l] = pcm[(i + l * 1000) % k_length];
+			}
+
+			for (auto i = 0; i < k_length; i += k_blockSize)
+			{
+				const auto n = std::min (k_blockSize, k_length - i);
+				lanes.processBlock (interleaved.data () + i * k_lanes, n);
+				for (auto l = 0; l < k_lanes; ++l) single[l].processBlock (planar[l].data () + i, n);
+			}
+
+			auto pass = true;
+			for (auto l = 0; l < k_lanes; ++l)
+				for (auto i = 0; i < k_length; ++i) pass = pass && planar[l][i] == interleaved[i * k_lanes + l];
+			++checks;
+			if (!pass) ++failures;
+			if (!pass || verbose)
+				std::printf ("%s fixed point lanes %-10s\n", pass ? "ok  " : "FAIL", MultiFilter::typeStings ().at (type).c_str ());
+		}
+	}
+
+	// the analytic tail, the impulse response of the reference must have died away below
+	// -120 dB by the time getTailLengthSamples gives, cascades and the Ladder included
+	{
+		for (auto type = 0; type < static_cast<int> (MultiFilter::typeStings ().size ()); ++type)
+		{
+			const auto name = MultiFilter::typeStings ().at (type);
+			for (auto freq : { 20.0, 60.0, 1000.0, 12000.0 })
+				for (auto Q : qs)
+					for (auto gain : gains)
+					{
+						MultiFilter filter;
+						filter.setSampleRate (48000);
+						filter.setTypeIndex (type, static_cast<float> (freq), static_cast<float> (Q), static_cast<float> (gain));
+						const auto tail = filter.getTailLengthSamples ();
+
+						std::vector<double> response;
+						const auto impulse = testsignals::impulse (static_cast<int> (tail) + 1024);
+						if (filter.isLinear ())
+						{
+							auto cascade = reference::design (name, { 48000.0, freq, Q, gain });
+							reference::process (cascade, impulse, response);
+						}
+						else reference::Ladder ({ 48000.0, freq, Q, gain }).process (impulse, response);
+						auto last = 0;
+						for (auto i = 0; i < static_cast<int> (response.size ()); ++i)
+							if (std::fabs (response[i]) > 1.0e-6) last = i;
+
+						const auto pass = last <= tail;
+						++checks;
+						if (!pass) ++failures;
+						if (!pass || verbose)
+							std::printf ("%s tail %-10s f %6.0f Q %5.3f gain %5.1f  %8d samples, bound %10.1f\n",
+								pass ? "ok  " : "FAIL", name.c_str (), freq, Q, gain, last, tail);
+					}
+		}
+	}
+
+	// the compile time designs, at 48kHz, the utility filters they are meant for first
+	{
+		using Q4 = std::ratio<4>;
+		using Plus6 = std::ratio<6>;
+		const auto noise = testsignals::noise (k_length);
+		failures += checkFixed<FixedBiquad<FixedType::hp12, 20>> ("HP12", 20.0, 0.7071, 0.0, noise, verbose);
+		failures += checkFixed<FixedBiquad<FixedType::lp12, 80>> ("LP12", 80.0, 0.7071, 0.0, noise, verbose);
+		failures += checkFixed<FixedBiquad<FixedType::hp12, 80>> ("HP12", 80.0, 0.7071, 0.0, noise, verbose);
+		failures += checkFixed<FixedBiquad<FixedType::lp6, 1000>> ("LP6", 1000.0, 0.7071, 0.0, noise, verbose);
+		failures += checkFixed<FixedBiquad<FixedType::hp6, 1000>> ("HP6", 1000.0, 0.7071, 0.0, noise, verbose);
+		failures += checkFixed<FixedBiquad<FixedType::bp12, 1000, Q4>> ("BP12", 1000.0, 4.0, 0.0, noise, verbose);
+		failures += checkFixed<FixedBiquad<FixedType::bs12, 1000, Q4>> ("BS12", 1000.0, 4.0, 0.0, noise, verbose);
+		failures += checkFixed<FixedBiquad<FixedType::peak, 1000, Q4, 48000, Plus6>> ("Peak", 1000.0, 4.0, 6.0, noise, verbose);
+		failures += checkFixed<FixedBiquad<FixedType::lowShelf, 200, ButterworthQ, 48000, std::ratio<-12>>> ("Low Shelf", 200.0, 0.7071, -12.0, noise, verbose);
+		failures += checkFixed<FixedBiquad<FixedType::highShelf, 8000, ButterworthQ, 48000, Plus6>> ("High Shelf", 8000.0, 0.7071, 6.0, noise, verbose);
+		checks += 10;
+	}
+
+	std::printf ("%d of %d accuracy checks failed\n", failures, checks);
+	return failures == 0 ? 0 : 1;
+}
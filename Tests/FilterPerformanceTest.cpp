@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+// Times MultiFilter::processBlock for every type and fails if any has become slower than
+// the stored baseline by more than the tolerance. Timings are stored relative to a plain
+// double precision biquad loop timed on the same machine, so that a baseline taken on one
+// machine remains a fair guide on another. The Ladder's cost is also given as a multiple of
+// LP24's, the linear 4 pole low pass it is the saturating, oversampled alternative to.
+//
+// usage: sspo_filter_perf_test --baseline <file> [--update] [--tolerance <fraction>]
+//   --baseline <file>  the stored baseline, one "<type>\t<relative cost>" line per type
+//   --update           writes the timings as the new baseline instead of comparing
+//   --tolerance        the slow down allowed before failing, 0.5 (50%) by default
+
+#include "ReferenceFilters.h"
+#include "TestSignals.h"
+#include "dsp/Filter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace
+{
+	constexpr int k_blockSize = 512;
+	constexpr int k_samplesPerRun = 1 << 20;
+	constexpr int k_runs = 11;
+
+	/// ctest reports this as skipped
+	constexpr int k_skipped = 77;
+
+	volatile double g_sink = 0.0;
+
+	/// the best of k_runs, in ns/sample, each run refilling the signal so the filters never settle
+	template <typename ProcessFn>
+	double timeBest (const std::vector<float>& signal, ProcessFn&& process)
+	{
+		std::vector<float> block (k_blockSize);
+		auto best = 1.0e30;
+		for (auto run = 0; run < k_runs; ++run)
+		{
+			const auto start = std::chrono::steady_clock::now ();
+			for (auto done = 0; done < k_samplesPerRun; done += k_blockSize)
+			{
+				std::copy (signal.begin (), signal.begin () + k_blockSize, block.begin ());
+				process (block.data (), k_blockSize);
+				g_sink = g_sink + block[k_blockSize - 1];
+			}
+			const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now () - start;
+			best = std::min (best, elapsed.count () / k_samplesPerRun);
+		}
+		return best;
+	}
+
+	std::map<std::string, double> readBaseline (const std::string& path)
+	{
+		std::map<std::string, double> baseline;
+		std::ifstream in (path);
+		std::string line;
+		while (std::getline (in, line))
+		{
+			const auto tab = line.rfind ('\t');
+			if (line.empty () || line[0] == '#' || tab == std::string::npos) continue;
+			baseline[line.substr (0, tab)] = std::atof (line.c_str () + tab + 1);
+		}
+		return baseline;
+	}
+}
+
+int main (int argc, char* argv[])
+{
+	std::string baselinePath;
+	auto update = false;
+	auto tolerance = 0.5;
+	for (auto i = 1; i < argc; ++i)
+	{
+		if (std::strcmp (argv[i], "--baseline") == 0 && i + 1 < argc) baselinePath = argv[++i];
+		else if (std::strcmp (argv[i], "--update") == 0) update = true;
+		else if (std::strcmp (argv[i], "--tolerance") == 0 && i + 1 < argc) tolerance = std::atof (argv[++i]);
+	}
+	if (baselinePath.empty ())
+	{
+		std::printf ("usage: sspo_filter_perf_test --baseline <file> [--update] [--tolerance <fraction>]\n");
+		return 1;
+	}
+
+#ifndef NDEBUG
+	if (!update)
+	{
+		std::printf ("skipped, timings are only meaningful in an optimised build\n");
+		return k_skipped;
+	}
+#endif
+
+	constexpr auto sampleRate = 48000;
+	const auto signal = testsignals::noise (k_blockSize);
+
+	// timed again next to every type, so a change in clock speed affects both alike
+	auto calibration = reference::design ("LP12", { sampleRate, 1000.0, 0.707, 0.0 });
+	auto timeReference = [&calibration, &signal]
+	{
+		return timeBest (signal, [&calibration] (float* block, int n)
+			{
+				for (auto i = 0; i < n; ++i) block[i] = static_cast<float> (calibration[0].tick (block[i]));
+			});
+	};
+
+	const auto baseline = update ? std::map<std::string, double> () : readBaseline (baselinePath);
+	std::ofstream out;
+	if (update)
+	{
+		out.open (baselinePath);
+		out << "# MultiFilter::processBlock cost relative to a double precision biquad loop, block " << k_blockSize << "\n";
+		out << "# written by sspo_filter_perf_test --update\n";
+	}
+
+	auto failures = 0;
+	std::map<std::string, double> measured;
+	for (auto type = 0; type < static_cast<int> (MultiFilter::typeStings ().size ()); ++type)
+	{
+		const auto name = MultiFilter::typeStings ().at (type);
+		MultiFilter filter;
+		filter.setSampleRate (sampleRate);
+		filter.setTypeIndex (type, 1000.0f, 0.707f, 6.0f);
+		const auto unit = timeReference ();
+		const auto ns = timeBest (signal, [&filter] (float* block, int n) { filter.processBlock (block, n); });
+		const auto relative = ns / unit;
+		measured[name] = relative;
+
+		if (update)
+		{
+			out << name << "\t" << relative << "\n";
+			std::printf ("%-10s %7.3f ns/sample  %.3f\n", name.c_str (), ns, relative);
+			continue;
+		}
+
+		const auto found = baseline.find (name);
+		if (found == baseline.end ())
+		{
+			std::printf ("%-10s %7.3f ns/sample  %.3f, not in the baseline\n", name.c_str (), ns, relative);
+			continue;
+		}
+		const auto pass = relative <= found->second * (1.0 + tolerance);
+		if (!pass) ++failures;
+		std::printf ("%s %-10s %7.3f ns/sample  %.3f against %.3f\n", pass ? "ok  " : "FAIL", name.c_str (), ns, relative, found->second);
+	}
+
+	if (measured.count ("Ladder") != 0 && measured.count ("LP24") != 0)
+		std::printf ("Ladder costs %.1f times LP24\n", measured["Ladder"] / measured["LP24"]);
+
+	if (update) std::printf ("baseline written to %s\n", baselinePath.c_str ());
+	else std::printf ("%d types slower than the baseline allows\n", failures);
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+// A simulated audio thread runs MultiFilter::processBlock on a stereo pair, as fast as it
+// can, while writer threads change the type, cutoff, Q and gain at random, as host
+// automation does through Sspo_filterAudioProcessor::parameterChanged. Reports the worst
+// and p99.9 block time, how long writers spend in each change, which includes any spin
+// in NonRealtimeMutatable::nonRealtimeRelease, and counts allocations on each side.
+// Fails if the audio thread allocates.
+//
+// Both ways the plugin has applied parameters are run, "immediate" designs on the writer
+// thread through NonRealtimeMutatable, "control" only sets targets that the audio thread
+// designs from at control rate, as the plugin does after prepareToPlay.
+//
+// usage: sspo_filter_parameter_storm [--seconds <s>] [--writers <n>] [--block <samples>]
+
+#include "dsp/Filter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	// every allocation, counted against the thread that made it
+	thread_local bool t_isAudioThread = false;
+	std::atomic<uint64_t> g_audioAllocations{ 0 };
+	std::atomic<uint64_t> g_writerAllocations{ 0 };
+
+	struct Percentiles
+	{
+		double mean, p999, worst;
+	};
+
+	Percentiles percentiles (std::vector<double>& us)
+	{
+		if (us.empty ()) return { 0.0, 0.0, 0.0 };
+		std::sort (us.begin (), us.end ());
+		double sum = 0.0;
+		for (auto v : us) sum += v;
+		const auto index = std::min (us.size () - 1, static_cast<size_t> (us.size () * 0.999));
+		return { sum / us.size (), us[index], us.back () };
+	}
+
+	struct Settings
+	{
+		double seconds{ 2.0 };
+		int writers{ 4 };
+		int blockSize{ 256 };
+		int sampleRate{ 48000 };
+	};
+
+	///
+	/// \brief storm
+	/// Runs one storm, returning false if the audio thread allocated
+	bool storm (const Settings& settings, bool controlRate)
+	{
+		constexpr auto numChannels = 2;
+		std::vector<std::unique_ptr<MultiFilter>> filters;
+		for (auto c = 0; c < numChannels; ++c)
+		{
+			filters.push_back (std::make_unique<MultiFilter> ());
+			filters.back ()->setSampleRate (settings.sampleRate);
+			filters.back ()->setTypeIndex (1, 1000.0f, 0.707f, 0.0f);
+			if (controlRate) filters.back ()->setControlRate (32);
+		}
+
+		// preallocated, so recording a block time never allocates
+		const auto expectedBlocks = static_cast<size_t> (settings.seconds * 2.0e7 / settings.blockSize) + 1024;
+		std::vector<double> blockUs;
+		blockUs.reserve (expectedBlocks);
+
+		std::atomic<bool> running{ true };
+		const auto audioAllocationsBefore = g_audioAllocations.load ();
+		const auto writerAllocationsBefore = g_writerAllocations.load ();
+
+		std::thread audio ([&]
+			{
+				std::vector<std::vector<float>> buffers (numChannels, std::vector<float> (static_cast<size_t> (settings.blockSize)));
+				std::minstd_rand random (1);
+				std::uniform_real_distribution<float> noise (-0.5f, 0.5f);
+				t_isAudioThread = true;
+				while (running.load (std::memory_order_relaxed) && blockUs.size () < blockUs.capacity ())
+				{
+					for (auto& b : buffers)
+						for (auto& s : b) s = noise (random);
+
+					const auto start = Clock::now ();
+					for (auto c = 0; c < numChannels; ++c) filters[c]->processBlock (buffers[c].data (), settings.blockSize);
+					blockUs.push_back (std::chrono::duration<double, std::micro> (Clock::now () - start).count ());
+				}
+				t_isAudioThread = false;
+			});
+
+		// a host serialises the changes to one parameter, but not across threads, the filter
+		// setters are not themselves safe to call from several threads at once
+		std::mutex writerLock;
+		std::vector<std::vector<double>> writerUs (static_cast<size_t> (settings.writers));
+		std::vector<std::thread> writers;
+		for (auto w = 0; w < settings.writers; ++w)
+		{
+			writerUs[w].reserve (1 << 20);
+			writers.emplace_back ([&, w]
+				{
+					std::minstd_rand random (100 + w);
+					std::uniform_real_distribution<float> unit (0.0f, 1.0f);
+					const auto numTypes = static_cast<int> (MultiFilter::typeStings ().size ());
+					while (running.load (std::memory_order_relaxed))
+					{
+						const auto which = random () % 4;
+						const auto value = unit (random);
+						const auto start = Clock::now ();
+						{
+							std::lock_guard<std::mutex> lock (writerLock);
+							for (auto& f : filters)
+							{
+								switch (which)
+								{
+								case 0: f->setFrequency (20.0f * powf (1000.0f, value)); break;
+								case 1: f->setQ (0.1f + value * 10.0f); break;
+								case 2: f->setGain (value * 60.0f - 30.0f); break;
+								default: f->setTypeIndex (static_cast<int> (value * numTypes) % numTypes); break;
+								}
+							}
+						}
+						if (writerUs[w].size () < writerUs[w].capacity ())
+							writerUs[w].push_back (std::chrono::duration<double, std::micro> (Clock::now () - start).count ());
+					}
+				});
+		}
+
+		std::this_thread::sleep_for (std::chrono::duration<double> (settings.seconds));
+		running.store (false);
+		audio.join ();
+		for (auto& t : writers) t.join ();
+
+		std::vector<double> allWriterUs;
+		for (auto& w : writerUs) allWriterUs.insert (allWriterUs.end (), w.begin (), w.end ());
+
+		const auto audioAllocations = g_audioAllocations.load () - audioAllocationsBefore;
+		const auto writerAllocations = g_writerAllocations.load () - writerAllocationsBefore;
+		const auto numBlocks = blockUs.size ();
+		const auto numChanges = allWriterUs.size ();
+		const auto block = percentiles (blockUs);
+		const auto writer = percentiles (allWriterUs);
+		const auto budgetUs = 1.0e6 * settings.blockSize / settings.sampleRate;
+
+		std::printf ("%s: %zu blocks of %d, %zu parameter changes from %d threads\n",
+			controlRate ? "control" : "immediate", numBlocks, settings.blockSize, numChanges, settings.writers);
+		std::printf ("  block   mean %8.2f us  p99.9 %8.2f us  worst %8.2f us  (deadline %.0f us)\n", block.mean, block.p999, block.worst, budgetUs);
+		std::printf ("  writer  mean %8.2f us  p99.9 %8.2f us  worst %8.2f us\n", writer.mean, writer.p999, writer.worst);
+		std::printf ("  allocations  audio thread %llu  writers %llu\n",
+			static_cast<unsigned long long> (audioAllocations), static_cast<unsigned long long> (writerAllocations));
+
+		return audioAllocations == 0;
+	}
+
+	///
+	/// \brief ownership
+	/// At control rate the audio thread owns the coefficients, and appendStages() from it
+	/// sees what it designed, carried over as the rate is switched on and back off
+	bool ownership ()
+	{
+		auto pass = true;
+		const auto numTypes = static_cast<int> (MultiFilter::typeStings ().size ());
+		for (auto type = 0; type < numTypes; ++type)
+		{
+			MultiFilter reference, filter;
+			for (auto* f : { &reference, &filter })
+			{
+				f->setSampleRate (48000);
+				f->setTypeIndex (type, 2500.0f, 2.0f, 6.0f);
+			}
+			std::vector<BiQuad::BiquadCoeffecients> expected;
+			reference.appendStages (expected);
+
+			for (auto interval : { 32, 0 })
+			{
+				filter.setControlRate (interval);
+				std::vector<BiQuad::BiquadCoeffecients> stages;
+				filter.appendStages (stages);
+				if (stages.size () != expected.size () || std::memcmp (stages.data (), expected.data (), stages.size () * sizeof (stages[0])) != 0)
+				{
+					std::printf ("FAIL %s at a control interval of %d runs other coefficients\n", MultiFilter::typeStings ()[type].c_str (), interval);
+					pass = false;
+				}
+			}
+		}
+		return pass;
+	}
+}
+
+// replaced rather than wrapped, gcc cannot see that the pair stays matched
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new (std::size_t size)
+{
+	(t_isAudioThread ? g_audioAllocations : g_writerAllocations).fetch_add (1, std::memory_order_relaxed);
+	if (auto* p = std::malloc (size == 0 ? 1 : size)) return p;
+	throw std::bad_alloc ();
+}
+
+void operator delete (void* p) noexcept { std::free (p); }
+void operator delete (void* p, std::size_t) noexcept { std::free (p); }
+
+int main (int argc, char* argv[])
+{
+	Settings settings;
+	for (auto i = 1; i + 1 < argc; i += 2)
+	{
+		if (std::strcmp (argv[i], "--seconds") == 0) settings.seconds = std::atof (argv[i + 1]);
+		else if (std::strcmp (argv[i], "--writers") == 0) settings.writers = std::max (1, std::atoi (argv[i + 1]));
+		else if (std::strcmp (argv[i], "--block") == 0) settings.blockSize = std::max (1, std::atoi (argv[i + 1]));
+	}
+
+	auto quiet = storm (settings, false);
+	quiet = storm (settings, true) && quiet;
+	if (!quiet) std::printf ("FAIL the audio thread allocated\n");
+	return ownership () && quiet ? 0 : 1;
+}
@@ -0,0 +1,292 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#pragma once
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+///
+/// Double precision transcriptions of each calcCoefficents () in Source/dsp/Filter.h,
+/// the golden reference the float filters are tested against. Keep these in step with
+/// the designs there, a change to a design should show up here as a deliberate edit.
+namespace reference
+{
+	constexpr double k_pi = 3.14159265358979323846;
+
+	///
+	/// \brief The Biquad struct
+	/// The same transposed canonical form as BiQuad::tick, without the denormal check,
+	///   H(z) = c0 * (a0 + a1 z^-1 + a2 z^-2) / (1 + b1 z^-1 + b2 z^-2) + d0
+	struct Biquad
+	{
+		double a0, a1, a2, b1, b2, c0, d0;
+		double z1{ 0.0 }, z2{ 0.0 };
+
+		double tick (double in) noexcept
+		{
+			const auto out = z1 + a0 * in;
+			z1 = a1 * in + z2 - b1 * out;
+			z2 = a2 * in - b2 * out;
+			return out * c0 + in * d0;
+		}
+	};
+
+	struct Params
+	{
+		double sampleRate, freq, Q, gain;
+	};
+
+	inline Biquad onePole (const Params& p, bool highPass)
+	{
+		const auto theta = 2.0 * k_pi * p.freq / p.sampleRate;
+		const auto gamma = std::cos (theta) / (1.0 + std::sin (theta));
+		const auto a0 = (1.0 + (highPass ? gamma : -gamma)) * 0.5;
+		return { a0, highPass ? -a0 : a0, 0.0, -gamma, 0.0, 1.0, 0.0 };
+	}
+
+	inline Biquad twoPole (const Params& p, bool highPass)
+	{
+		const auto theta = 2.0 * k_pi * p.freq / p.sampleRate;
+		const auto s = std::sin (theta);
+		const auto d = 1.0 / p.Q;
+		const auto beta = 0.5 * ((1.0 - 0.5 * d * s) / (1.0 + 0.5 * d * s));
+		const auto gamma = (0.5 + beta) * std::cos (theta);
+		const auto a0 = (0.5 + beta + (highPass ? gamma : -gamma)) * 0.5;
+		return { a0, highPass ? -2.0 * a0 : 2.0 * a0, a0, -2.0 * gamma, 2.0 * beta, 1.0, 0.0 };
+	}
+
+	inline Biquad bandPass (const Params& p)
+	{
+		const auto K = std::tan (k_pi * p.freq / p.sampleRate);
+		const auto delta = K * K * p.Q + K + p.Q;
+		return { K / delta, 0.0, -K / delta, 2.0 * p.Q * (K * K - 1.0) / delta, (K * K * p.Q - K + p.Q) / delta, 1.0, 0.0 };
+	}
+
+	inline Biquad bandStop (const Params& p)
+	{
+		const auto K = std::tan (k_pi * p.freq / p.sampleRate);
+		const auto delta = K * K * p.Q + K + p.Q;
+		const auto a0 = p.Q * (K * K + 1.0) / delta;
+		const auto a1 = 2.0 * p.Q * (K * K - 1.0) / delta;
+		return { a0, a1, a0, a1, (K * K * p.Q - K + p.Q) / delta, 1.0, 0.0 };
+	}
+
+	inline Biquad peak (const Params& p)
+	{
+		const auto Q = std::fmax (1.0, p.Q);
+		const auto theta = 2.0 * k_pi * p.freq / p.sampleRate;
+		const auto mu = std::pow (10.0, p.gain / 20.0);
+		const auto zeta = 4.0 / (1.0 + mu);
+		const auto t = std::tan (theta / (2.0 * Q));
+		const auto beta = 0.5 * ((1.0 - zeta * t) / (1.0 + zeta * t));
+		const auto gamma = (0.5 + beta) * std::cos (theta);
+		return { 0.5 - beta, 0.0, -(0.5 - beta), -2.0 * gamma, 2.0 * beta, mu - 1.0, 1.0 };
+	}
+
+	inline Biquad shelf (const Params& p, bool high)
+	{
+		const auto theta = 2.0 * k_pi * p.freq / p.sampleRate;
+		const auto mu = std::pow (10.0, p.gain / 20.0);
+		const auto beta = high ? (1.0 + mu) / 4.0 : 4.0 / (1.0 + mu);
+		const auto delta = beta * std::tan (theta * 0.5);
+		const auto gamma = (1.0 - delta) / (1.0 + delta);
+		const auto a0 = (1.0 + (high ? gamma : -gamma)) * 0.5;
+		return { a0, high ? -a0 : a0, 0.0, -gamma, 0.0, mu - 1.0, 1.0 };
+	}
+
+	/// the feedback of Ladder::design
+	inline double ladderFeedback (const Params& p)
+	{
+		return 4.0 * std::fmin (std::fmax (1.0 - 0.5 / std::fmax (0.1, p.Q), 0.0), 0.975);
+	}
+
+	/// Ladder::appendStages, the bilinear transform of (1 + r) / ((1 + s)^4 + r), a pair of poles a section
+	inline std::vector<Biquad> ladderSmallSignal (const Params& p)
+	{
+		const auto K = std::tan (k_pi * std::fmin (p.freq, 0.45 * p.sampleRate) / p.sampleRate);
+		const auto spread = std::pow (ladderFeedback (p), 0.25) * std::sqrt (0.5);
+		std::vector<Biquad> sections;
+		for (auto side : { 1.0, -1.0 })
+		{
+			const auto re = -1.0 + side * spread;
+			const auto a = -2.0 * re;
+			const auto P = re * re + spread * spread;
+			const auto den = 1.0 + a * K + P * K * K;
+			const auto a0 = P * K * K / den;
+			sections.push_back ({ a0, 2.0 * a0, a0, (2.0 * P * K * K - 2.0) / den, (1.0 - a * K + P * K * K) / den, 1.0, 0.0 });
+		}
+		return sections;
+	}
+
+	///
+	/// \brief The Ladder struct
+	/// Ladder's processing with std::tanh for fastTanhXdX, the halfband coefficients
+	/// designed as Oversampler2x::design designs them
+	struct Ladder
+	{
+		static constexpr int k_numCoeffs = 8;
+
+		explicit Ladder (Params p)
+		{
+			p.freq = std::fmin (std::fmax (p.freq, 20.0), 20000.0);
+			p.Q = std::fmin (std::fmax (p.Q, 0.1), 20.0);
+			f = std::tan (k_pi * std::fmin (p.freq, 0.45 * p.sampleRate) / (2.0 * p.sampleRate));
+			r = ladderFeedback (p);
+			drive = std::pow (10.0, p.gain / 20.0);
+			makeUp = (1.0 + r) / drive;
+			designHalfband (0.04);
+		}
+
+		double tick (double in) noexcept
+		{
+			auto even = in * drive, odd = in * drive;
+			allpasses (even, odd, up);
+			double oversampled[2] = { step (even), step (odd) };
+			even = oversampled[1];
+			odd = oversampled[0];
+			allpasses (even, odd, down);
+			return 0.5 * (even + odd) * makeUp;
+		}
+
+		void process (const std::vector<float>& in, std::vector<double>& out)
+		{
+			out.resize (in.size ());
+			for (size_t i = 0; i < in.size (); ++i) out[i] = tick (in[i]);
+		}
+
+	private:
+		struct Allpasses
+		{
+			double x[k_numCoeffs]{}, y[k_numCoeffs]{};
+		};
+
+		static double tanhXdX (double x) noexcept
+		{
+			return x == 0.0 ? 1.0 : std::tanh (x) / x;
+		}
+
+		double step (double in) noexcept
+		{
+			double t[4];
+			for (auto i = 0; i < 4; ++i) t[i] = tanhXdX (s[i]);
+			const auto t0 = tanhXdX (0.5 * (in + previousIn) - r * s[3]);
+			previousIn = in;
+
+			double g[4];
+			for (auto i = 0; i < 4; ++i) g[i] = 1.0 / (1.0 + f * t[i]);
+			const auto f3 = f * t[2] * g[3];
+			const auto f2 = f * t[1] * g[2] * f3;
+			const auto f1 = f * t[0] * g[1] * f2;
+			const auto f0 = f * t0 * g[0] * f1;
+			const auto y3 = (g[3] * s[3] + f3 * g[2] * s[2] + f2 * g[1] * s[1] + f1 * g[0] * s[0] + f0 * in) / (1.0 + r * f0);
+
+			const auto x = t0 * (in - r * y3);
+			const auto y0 = t[0] * g[0] * (s[0] + f * x);
+			const auto y1 = t[1] * g[1] * (s[1] + f * y0);
+			const auto y2 = t[2] * g[2] * (s[2] + f * y1);
+
+			s[0] += 2.0 * f * (x - y0);
+			s[1] += 2.0 * f * (y0 - y1);
+			s[2] += 2.0 * f * (y1 - y2);
+			s[3] += 2.0 * f * (y2 - t[3] * y3);
+			return y3;
+		}
+
+		void allpasses (double& even, double& odd, Allpasses& state) const noexcept
+		{
+			for (auto i = 0; i < k_numCoeffs; ++i)
+			{
+				auto& v = i % 2 == 0 ? even : odd;
+				const auto next = (v - state.y[i]) * coeffs[i] + state.x[i];
+				state.x[i] = v;
+				state.y[i] = next;
+				v = next;
+			}
+		}
+
+		void designHalfband (double transition)
+		{
+			auto k = std::tan ((1.0 - transition * 2.0) * k_pi / 4.0);
+			k *= k;
+			const auto kksqrt = std::pow (1.0 - k * k, 0.25);
+			const auto e = 0.5 * (1.0 - kksqrt) / (1.0 + kksqrt);
+			const auto e4 = std::pow (e, 4.0);
+			const auto q = e * (1.0 + e4 * (2.0 + e4 * (15.0 + 150.0 * e4)));
+			const auto order = k_numCoeffs * 2 + 1;
+			for (auto c = 1; c <= k_numCoeffs; ++c)
+			{
+				auto num = 0.0, den = 0.5;
+				for (auto i = 0; i < 20; ++i)
+					num += std::pow (q, i * (i + 1)) * std::sin ((i * 2 + 1) * c * k_pi / order) * (i % 2 == 0 ? 1.0 : -1.0);
+				for (auto i = 1; i < 20; ++i)
+					den += std::pow (q, i * i) * std::cos (i * 2 * c * k_pi / order) * (i % 2 == 0 ? 1.0 : -1.0);
+				const auto ww = num * std::pow (q, 0.25) / den;
+				const auto x = std::sqrt ((1.0 - ww * ww * k) * (1.0 - ww * ww / k)) / (1.0 + ww * ww);
+				coeffs[c - 1] = (1.0 - x) / (1.0 + x);
+			}
+		}
+
+		double f, r, drive, makeUp;
+		double coeffs[k_numCoeffs];
+		double s[4]{};
+		double previousIn{ 0.0 };
+		Allpasses up, down;
+	};
+
+	///
+	/// \brief design
+	/// The sections MultiFilter runs for a type name, empty for an unknown type, for the
+	/// Ladder, which saturates, those of its small signal response.
+	/// The parameters are clamped as Filter::setParameters clamps them.
+	inline std::vector<Biquad> design (const std::string& type, Params p)
+	{
+		p.freq = std::fmin (std::fmax (p.freq, 20.0), 20000.0);
+		p.Q = std::fmin (std::fmax (p.Q, 0.1), 20.0);
+
+		if (type == "LP6") return { onePole (p, false) };
+		if (type == "LP12") return { twoPole (p, false) };
+		if (type == "LP24") return { twoPole (p, false), twoPole (p, false) };
+		if (type == "HP6") return { onePole (p, true) };
+		if (type == "HP12") return { twoPole (p, true) };
+		if (type == "HP24") return { twoPole (p, true), twoPole (p, true) };
+		if (type == "Low Shelf") return { shelf (p, false) };
+		if (type == "High Shelf") return { shelf (p, true) };
+		if (type == "Peak") return { peak (p) };
+		if (type == "BP12") return { bandPass (p) };
+		if (type == "BS12") return { bandStop (p) };
+		if (type == "Ladder") return ladderSmallSignal (p);
+		return {};
+	}
+
+	inline void process (std::vector<Biquad>& cascade, const std::vector<float>& in, std::vector<double>& out)
+	{
+		out.resize (in.size ());
+		for (size_t i = 0; i < in.size (); ++i)
+		{
+			double v = in[i];
+			for (auto& s : cascade) v = s.tick (v);
+			out[i] = v;
+		}
+	}
+}
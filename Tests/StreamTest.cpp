@@ -0,0 +1,354 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+// Runs sspo_filter_stream as it would be in a pipeline, feeding its stdin and reading its
+// stdout, and checks the output against the same filter in process: raw float, where it
+// should agree to within float rounding, 16 bit WAV, to within a step, and a type change
+// written to the control fifo part way through. WAV chunks around the audio are skipped
+// rather than filtered, and one claiming gigabytes is refused without allocating them.
+//
+// usage: sspo_filter_stream_test --stream <path to sspo_filter_stream>
+
+#include "TestSignals.h"
+#include "dsp/Filter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+	constexpr int k_sampleRate = 48000;
+	constexpr int k_length = 48000;
+
+	std::string g_streamPath;
+
+	///
+	/// \brief run
+	/// Starts the stream with args, then calls feed with its stdin, reading all of its
+	/// stdout meanwhile, and returns it, with the stream's wait status in status if given
+	template <typename Feed>
+	std::vector<unsigned char> run (std::vector<std::string> args, Feed&& feed, int* status = nullptr)
+	{
+		int in[2], out[2];
+		if (pipe (in) != 0 || pipe (out) != 0) return {};
+
+		const auto pid = fork ();
+		if (pid == 0)
+		{
+			dup2 (in[0], STDIN_FILENO);
+			dup2 (out[1], STDOUT_FILENO);
+			close (in[0]); close (in[1]); close (out[0]); close (out[1]);
+			std::vector<char*> argv{ const_cast<char*> (g_streamPath.c_str ()) };
+			for (auto& a : args) argv.push_back (const_cast<char*> (a.c_str ()));
+			argv.push_back (nullptr);
+			execv (g_streamPath.c_str (), argv.data ());
+			_exit (127);
+		}
+		close (in[0]);
+		close (out[1]);
+
+		std::vector<unsigned char> output;
+		std::thread reader ([&output, fd = out[0]]
+			{
+				unsigned char buffer[4096];
+				ssize_t n;
+				while ((n = read (fd, buffer, sizeof (buffer))) > 0) output.insert (output.end (), buffer, buffer + n);
+			});
+
+		feed (in[1]);
+		close (in[1]);
+		reader.join ();
+		close (out[0]);
+		waitpid (pid, status, 0);
+		return output;
+	}
+
+	/// the stream's exit status with args, reading inFd and writing outFd, -1 if it did not exit
+	int exitStatus (std::vector<std::string> args, int inFd, int outFd)
+	{
+		const auto pid = fork ();
+		if (pid == 0)
+		{
+			dup2 (inFd, STDIN_FILENO);
+			dup2 (outFd, STDOUT_FILENO);
+			std::vector<char*> argv{ const_cast<char*> (g_streamPath.c_str ()) };
+			for (auto& a : args) argv.push_back (const_cast<char*> (a.c_str ()));
+			argv.push_back (nullptr);
+			execv (g_streamPath.c_str (), argv.data ());
+			_exit (127);
+		}
+		int status = 0;
+		waitpid (pid, &status, 0);
+		return WIFEXITED (status) ? WEXITSTATUS (status) : -1;
+	}
+
+	void writeAll (int fd, const void* data, size_t size)
+	{
+		const auto* bytes = static_cast<const char*> (data);
+		while (size > 0)
+		{
+			const auto n = write (fd, bytes, size);
+			if (n <= 0) return;
+			bytes += n;
+			size -= static_cast<size_t> (n);
+		}
+	}
+
+	/// the reference, a MultiFilter per channel over planar copies of the input
+	std::vector<std::vector<float>> filterInProcess (const std::vector<std::vector<float>>& input, int type, float freq, float q, float gain)
+	{
+		auto output = input;
+		for (auto& channel : output)
+		{
+			MultiFilter filter;
+			filter.setSampleRate (k_sampleRate);
+			filter.setTypeIndex (type, freq, q, gain);
+			filter.setControlRate (32);
+			for (auto i = 0; i < k_length; i += 256) filter.processBlock (channel.data () + i, std::min (256, k_length - i));
+		}
+		return output;
+	}
+
+	int report (bool pass, const char* what, double measure)
+	{
+		std::printf ("%s %s  %g\n", pass ? "ok  " : "FAIL", what, measure);
+		return pass ? 0 : 1;
+	}
+}
+
+int main (int argc, char* argv[])
+{
+	for (auto i = 1; i < argc; ++i)
+		if (std::strcmp (argv[i], "--stream") == 0 && i + 1 < argc) g_streamPath = argv[++i];
+	if (g_streamPath.empty ())
+	{
+		std::printf ("usage: sspo_filter_stream_test --stream <path to sspo_filter_stream>\n");
+		return 1;
+	}
+	signal (SIGPIPE, SIG_IGN);
+
+	const std::vector<std::vector<float>> stereo{ testsignals::noise (k_length, 1), testsignals::noise (k_length, 2) };
+	auto failures = 0;
+
+	// raw interleaved float, written in uneven pieces so blocks end wherever the reads do
+	{
+		std::vector<float> interleaved (k_length * 2);
+		for (auto i = 0; i < k_length; ++i)
+			for (auto c = 0; c < 2; ++c) interleaved[i * 2 + c] = stereo[c][i];
+
+		const auto output = run ({ "--raw", "--rate", "48000", "--channels", "2", "--format", "f32", "--type", "Peak", "--freq", "2000", "--q", "2", "--gain", "6" },
+			[&interleaved] (int fd)
+			{
+				const auto* bytes = reinterpret_cast<const char*> (interleaved.data ());
+				const auto size = interleaved.size () * sizeof (float);
+				for (size_t done = 0, piece = 1000; done < size; done += piece, piece = piece * 7 % 5003 + 1)
+					writeAll (fd, bytes + done, std::min (piece, size - done));
+			});
+
+		const auto expected = filterInProcess (stereo, 8, 2000.0f, 2.0f, 6.0f);
+		auto worst = output.size () == interleaved.size () * sizeof (float) ? 0.0 : 1.0e9;
+		for (auto i = 0; worst < 1.0e9 && i < k_length; ++i)
+			for (auto c = 0; c < 2; ++c)
+			{
+				float s;
+				std::memcpy (&s, output.data () + (i * 2 + c) * sizeof (float), sizeof (float));
+				worst = std::max (worst, static_cast<double> (std::fabs (s - expected[c][i])));
+			}
+		failures += report (worst < 1.0e-5, "raw f32 stereo, largest difference", worst);
+	}
+
+	// 16 bit WAV mono, the header written back, the samples within a step after rounding
+	{
+		std::vector<int16_t> pcm (k_length);
+		std::vector<std::vector<float>> mono{ std::vector<float> (k_length) };
+		for (auto i = 0; i < k_length; ++i)
+		{
+			pcm[i] = static_cast<int16_t> (std::lround (stereo[0][i] * 32767.0f));
+			mono[0][i] = pcm[i] / 32768.0f;
+		}
+		unsigned char header[44] = { 'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ', 16, 0, 0, 0,
+			1, 0, 1, 0, 0x80, 0xbb, 0, 0, 0, 0x77, 1, 0, 2, 0, 16, 0, 'd', 'a', 't', 'a', 0xff, 0xff, 0xff, 0xff };
+
+		const auto output = run ({ "--type", "HP12", "--freq", "300", "--block", "64" }, [&header, &pcm] (int fd)
+			{
+				writeAll (fd, header, sizeof (header));
+				writeAll (fd, pcm.data (), pcm.size () * sizeof (int16_t));
+			});
+
+		const auto expected = filterInProcess (mono, 4, 300.0f, 0.707f, 0.0f);
+		auto worst = output.size () == sizeof (header) + pcm.size () * sizeof (int16_t)
+			&& std::memcmp (output.data (), "RIFF", 4) == 0 && std::memcmp (output.data () + 36, "data", 4) == 0 ? 0.0 : 1.0e9;
+		for (auto i = 0; worst < 1.0e9 && i < k_length; ++i)
+		{
+			int16_t s;
+			std::memcpy (&s, output.data () + sizeof (header) + i * sizeof (int16_t), sizeof (int16_t));
+			worst = std::max (worst, std::fabs (s - expected[0][i] * 32768.0));
+		}
+		failures += report (worst <= 1.0, "wav s16 mono, largest difference in steps", worst);
+	}
+
+	// the same audio between an odd length chunk before the fmt and one after the data, which
+	// stops the stream at its length, the output is the same as without them
+	{
+		std::vector<int16_t> pcm (k_length);
+		std::vector<std::vector<float>> mono{ std::vector<float> (k_length) };
+		for (auto i = 0; i < k_length; ++i)
+		{
+			pcm[i] = static_cast<int16_t> (std::lround (stereo[1][i] * 32767.0f));
+			mono[0][i] = pcm[i] / 32768.0f;
+		}
+		const auto dataBytes = static_cast<uint32_t> (pcm.size () * sizeof (int16_t));
+		const unsigned char riff[12] = { 'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E' };
+		const unsigned char before[8 + 32] = { 'L', 'I', 'S', 'T', 31, 0, 0, 0 };
+		const unsigned char fmt[24] = { 'f', 'm', 't', ' ', 16, 0, 0, 0, 1, 0, 1, 0, 0x80, 0xbb, 0, 0, 0, 0x77, 1, 0, 2, 0, 16, 0 };
+		const unsigned char data[8] = { 'd', 'a', 't', 'a', static_cast<unsigned char> (dataBytes & 0xff), static_cast<unsigned char> ((dataBytes >> 8) & 0xff),
+			static_cast<unsigned char> ((dataBytes >> 16) & 0xff), static_cast<unsigned char> (dataBytes >> 24) };
+		std::vector<unsigned char> after (8 + 4096, 0x7f);
+		std::memcpy (after.data (), "LIST\x00\x10\x00\x00", 8);
+
+		const auto output = run ({ "--type", "LP12", "--freq", "3000" }, [&] (int fd)
+			{
+				writeAll (fd, riff, sizeof (riff));
+				writeAll (fd, before, sizeof (before));
+				writeAll (fd, fmt, sizeof (fmt));
+				writeAll (fd, data, sizeof (data));
+				writeAll (fd, pcm.data (), dataBytes);
+				writeAll (fd, after.data (), after.size ());
+			});
+
+		const auto expected = filterInProcess (mono, 1, 3000.0f, 0.707f, 0.0f);
+		auto worst = output.size () == 44 + dataBytes ? 0.0 : 1.0e9;
+		for (auto i = 0; worst < 1.0e9 && i < k_length; ++i)
+		{
+			int16_t s;
+			std::memcpy (&s, output.data () + 44 + i * sizeof (int16_t), sizeof (int16_t));
+			worst = std::max (worst, std::fabs (s - expected[0][i] * 32768.0));
+		}
+		failures += report (worst <= 1.0, "wav chunks around the data skipped, largest difference in steps", worst);
+	}
+
+	// a chunk claiming nearly 4GB, of which only a little follows
+	{
+		int status = 0;
+		const auto output = run ({}, [] (int fd)
+			{
+				const unsigned char header[20] = { 'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E', 'L', 'I', 'S', 'T', 0xf0, 0xff, 0xff, 0xff };
+				const std::vector<unsigned char> some (1000, 0);
+				writeAll (fd, header, sizeof (header));
+				writeAll (fd, some.data (), some.size ());
+			}, &status);
+		const auto refused = WIFEXITED (status) && WEXITSTATUS (status) == 1 && output.empty ();
+		failures += report (refused, "wav chunk larger than the stream refused, exit status", WIFEXITED (status) ? WEXITSTATUS (status) : -WTERMSIG (status));
+	}
+
+	// starts as a low pass at 20Hz, all but silent for noise, and is opened up through the
+	// fifo half way, so the first quarter should be quiet and the last much as the input
+	{
+		const auto fifo = "/tmp/sspo_filter_stream_test_" + std::to_string (getpid ());
+		mkfifo (fifo.c_str (), 0600);
+		// held open for writing, so the stream never sees the fifo's end
+		const auto control = open (fifo.c_str (), O_RDWR | O_NONBLOCK);
+
+		const auto& input = stereo[0];
+		const auto output = run ({ "--raw", "--rate", "48000", "--channels", "1", "--format", "f32", "--type", "LP12", "--freq", "20", "--control", fifo },
+			[&input, control] (int fd)
+			{
+				const auto half = input.size () / 2;
+				writeAll (fd, input.data (), half * sizeof (float));
+				std::this_thread::sleep_for (std::chrono::milliseconds (100));
+				const char command[] = "type LP12 freq 20000 q 0.707\n";
+				writeAll (control, command, sizeof (command) - 1);
+				writeAll (fd, input.data () + half, (input.size () - half) * sizeof (float));
+			});
+		close (control);
+		unlink (fifo.c_str ());
+
+		auto first = 0.0, last = 0.0, inputLast = 0.0;
+		const auto quarter = k_length / 4;
+		for (auto i = 0; output.size () == input.size () * sizeof (float) && i < quarter; ++i)
+		{
+			float a, b;
+			std::memcpy (&a, output.data () + i * sizeof (float), sizeof (float));
+			std::memcpy (&b, output.data () + (k_length - quarter + i) * sizeof (float), sizeof (float));
+			first += a * a;
+			last += b * b;
+			inputLast += input[k_length - quarter + i] * input[k_length - quarter + i];
+		}
+		const auto changeDb = 10.0 * std::log10 ((last + 1.0e-30) / (first + 1.0e-30));
+		const auto pass = last > 0.5 * inputLast && changeDb > 20.0;
+		failures += report (pass, "control fifo type change, dB louder after", changeDb);
+	}
+
+	// a reader that goes away ends the stream as success, a full disk or an unreadable
+	// stdin is a failure the pipeline must see
+	{
+		const std::vector<std::string> args{ "--raw", "--rate", "48000", "--channels", "1", "--format", "f32" };
+		const auto path = "/tmp/sspo_filter_stream_test_input_" + std::to_string (getpid ());
+		const auto file = open (path.c_str (), O_RDWR | O_CREAT | O_TRUNC, 0600);
+		writeAll (file, stereo[0].data (), stereo[0].size () * sizeof (float));
+		unlink (path.c_str ());
+
+		int closedPipe[2];
+		auto closed = -1;
+		if (pipe (closedPipe) == 0)
+		{
+			close (closedPipe[0]);
+			lseek (file, 0, SEEK_SET);
+			closed = exitStatus (args, file, closedPipe[1]);
+			close (closedPipe[1]);
+		}
+		failures += report (closed == 0, "stdout closed by its reader, exit status", closed);
+
+		const auto full = open ("/dev/full", O_WRONLY);
+		auto fullStatus = -1;
+		if (full >= 0)
+		{
+			lseek (file, 0, SEEK_SET);
+			fullStatus = exitStatus (args, file, full);
+			close (full);
+		}
+		failures += report (full < 0 || fullStatus == 1, "stdout full, exit status", fullStatus);
+		close (file);
+
+		const auto directory = open ("/tmp", O_RDONLY | O_DIRECTORY);
+		const auto devNull = open ("/dev/null", O_WRONLY);
+		const auto unreadable = exitStatus (args, directory, devNull);
+		close (directory);
+		close (devNull);
+		failures += report (unreadable == 1, "stdin unreadable, exit status", unreadable);
+	}
+
+	std::printf ("%d stream checks failed\n", failures);
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2019 Dave French <contact/dot/dave/dot/french3/at/googlemail/dot/com>
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program (see COPYING); if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+///
+/// The stimuli the tests run through the filters
+namespace testsignals
+{
+	inline std::vector<float> impulse (int length)
+	{
+		std::vector<float> s (static_cast<size_t> (length), 0.0f);
+		if (length > 0) s[0] = 1.0f;
+		return s;
+	}
+
+	/// an exponential sine sweep from 20Hz to just below Nyquist, at half scale
+	inline std::vector<float> sweep (int length, double sampleRate)
+	{
+		std::vector<float> s (static_cast<size_t> (length));
+		const auto f0 = 20.0;
+		const auto f1 = sampleRate * 0.45;
+		const auto seconds = length / sampleRate;
+		const auto k = std::log (f1 / f0);
+		for (auto i = 0; i < length; ++i)
+		{
+			const auto t = i / sampleRate;
+			const auto phase = 2.0 * 3.14159265358979323846 * f0 * seconds / k * (std::exp (t / seconds * k) - 1.0);
+			s[static_cast<size_t> (i)] = static_cast<float> (0.5 * std::sin (phase));
+		}
+		return s;
+	}
+
+	/// uniform white noise at half scale, the same every run
+	inline std::vector<float> noise (int length, uint32_t seed = 0x55b0)
+	{
+		std::vector<float> s (static_cast<size_t> (length));
+		for (auto& v : s)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			v = static_cast<float> ((seed >> 8) / 16777216.0 - 0.5);
+		}
+		return s;
+	}
+}